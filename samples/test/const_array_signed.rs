@@ -0,0 +1,28 @@
+// Signed integer arrays in constants (stored packed during constant evaluation)
+
+const T: [i32; 3] = [-1, 2, -300];
+const X: i64 = T[0] as i64;
+const B: [i8; 2] = [-128, 127];
+static S: [i16; 2] = [-2, 3];
+
+#[test]
+fn negative_entries()
+{
+    assert_eq!(X, -1);
+    assert!(T[0] == -1);
+    assert_eq!(T[2] as i64, -300);
+    assert_eq!(B[0] as i32, -128);
+    assert_eq!(B[1], 127);
+    assert_eq!(S[0] as i64 + S[1] as i64, 1);
+}
+
+#[test]
+fn negative_pattern()
+{
+    let a = [-1, 2, -300];
+    match a
+    {
+    T => {},
+    _ => panic!("{:?} didn't match {:?}", a, T),
+    }
+}
@@ -0,0 +1,29 @@
+// Calls made inside a generic `const fn` depend on its type parameters (results are cached per instantiation)
+
+trait Tr { fn v() -> u32; }
+impl Tr for u8 { fn v() -> u32 { 1 } }
+impl Tr for u16 { fn v() -> u32 { 2 } }
+
+const fn get<T: Tr>() -> u32 { <T as Tr>::v() }
+const fn get_nested<T: Tr>() -> u32 { get::<T>() }
+
+const A: u32 = get::<u8>();
+const B: u32 = get::<u16>();
+const C: u32 = get_nested::<u16>();
+const D: u32 = get_nested::<u8>();
+
+#[test]
+fn per_instantiation()
+{
+    assert_eq!(A, 1);
+    assert_eq!(B, 2);
+    assert_eq!(C, 2);
+    assert_eq!(D, 1);
+}
+
+#[test]
+fn array_length()
+{
+    let a = [0u8; get::<u16>() as usize];
+    assert_eq!(a.len(), 2);
+}
@@ -0,0 +1,24 @@
+use std::cmp::Ordering;
+
+#[derive(PartialEq,Eq,PartialOrd,Ord,Debug)]
+enum Signed { A = -1, B = 0, C = 5 }
+
+#[derive(PartialEq,Eq,PartialOrd,Ord,Debug)]
+enum Data { X(u8), Y, Z }
+
+#[test]
+fn negative_discriminants()
+{
+    assert_eq!(Signed::A.cmp(&Signed::B), Ordering::Less);
+    assert_eq!(Signed::C.partial_cmp(&Signed::A), Some(Ordering::Greater));
+    assert!(Signed::A < Signed::C);
+    assert_eq!(Signed::B.cmp(&Signed::B), Ordering::Equal);
+}
+
+#[test]
+fn data_variants()
+{
+    assert_eq!(Data::Z.cmp(&Data::X(1)), Ordering::Greater);
+    assert!(Data::Y < Data::Z);
+    assert!(Data::X(1) < Data::X(2));
+}
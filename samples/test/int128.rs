@@ -0,0 +1,82 @@
+#![feature(i128_type)]
+
+fn mk(hi: u64, lo: u64) -> u128 {
+    ((hi as u128) << 64) | (lo as u128)
+}
+
+#[test]
+fn u128_arith()
+{
+    let a = mk(0x0123_4567_89AB_CDEF, 0xFEDC_BA98_7654_3210);
+    let b = mk(0, 0xFFFF_FFFF_FFFF_FFFF);
+    assert_eq!(a + b, mk(0x0123_4567_89AB_CDF0, 0xFEDC_BA98_7654_320F));
+    assert_eq!(a - b, mk(0x0123_4567_89AB_CDEE, 0xFEDC_BA98_7654_3211));
+    assert_eq!(b * b, mk(0xFFFF_FFFF_FFFF_FFFE, 1));
+    assert_eq!(a * 3, mk(0x0369_D036_9D03_69CF, 0xFC96_2FC9_62FC_9630));
+    assert_eq!(a / b, 0x0123_4567_89AB_CDF0);
+    assert_eq!((a + 5) % b, 5);
+    assert_eq!(a / a, 1);
+    assert_eq!(b / a, 0);
+    assert_eq!(b % a, b);
+    assert_eq!(a / mk(1, 0), 0x0123_4567_89AB_CDEF);
+}
+
+#[test]
+fn u128_shifts()
+{
+    let a = mk(0x8000_0000_0000_0001, 0x8000_0000_0000_0001);
+    assert_eq!(a << 0, a);
+    assert_eq!(a >> 0, a);
+    assert_eq!(a << 1, mk(3, 2));
+    assert_eq!(a >> 1, mk(0x4000_0000_0000_0000, 0xC000_0000_0000_0000));
+    assert_eq!(a << 64, mk(0x8000_0000_0000_0001, 0));
+    assert_eq!(a >> 64, mk(0, 0x8000_0000_0000_0001));
+    assert_eq!(a >> 127, 1);
+}
+
+#[test]
+fn i128_arith()
+{
+    let a: i128 = -(mk(5, 7) as i128);
+    assert_eq!(-a, mk(5, 7) as i128);
+    assert_eq!(a / 2, -(mk(2, 0x8000_0000_0000_0003) as i128));
+    assert_eq!(a % 2, -1);
+    assert_eq!(a / -(mk(1, 0) as i128), 5);
+    assert_eq!((-7i128) * 6, -42);
+    assert_eq!((-42i128) >> 1, -21);
+    assert_eq!(a >> 100, -1);
+    assert!(a < 0);
+    assert!(a < -1);
+    assert!(-1 < 1i128);
+    assert_eq!(-1i64 as i128, -1);
+    assert_eq!(-1i32 as u128, !0);
+    assert_eq!(::std::i128::MIN / -2, 1i128 << 126);
+}
+
+#[test]
+fn i128_overflow()
+{
+    assert_eq!(::std::u128::MAX.checked_add(1), None);
+    assert_eq!(0u128.checked_sub(1), None);
+    assert_eq!(mk(1, 0).checked_mul(mk(1, 0)), None);
+    assert_eq!(mk(0, 1 << 63).checked_mul(2), Some(mk(1, 0)));
+    assert_eq!(::std::i128::MAX.overflowing_add(1), (::std::i128::MIN, true));
+    assert_eq!(::std::i128::MIN.overflowing_sub(1), (::std::i128::MAX, true));
+    assert_eq!((-1i128).overflowing_mul(::std::i128::MIN), (::std::i128::MIN, true));
+    assert_eq!((-3i128).overflowing_mul(5), (-15, false));
+}
+
+#[test]
+fn u128_bit_intrinsics()
+{
+    let a = mk(0x0000_0000_0000_F000, 0x0000_0000_0000_0100);
+    assert_eq!(a.count_ones(), 5);
+    assert_eq!(a.leading_zeros(), 48);
+    assert_eq!(a.trailing_zeros(), 8);
+    assert_eq!(0u128.leading_zeros(), 128);
+    assert_eq!(0u128.trailing_zeros(), 128);
+    assert_eq!(a.swap_bytes(), mk(0x0001_0000_0000_0000, 0x00F0_0000_0000_0000));
+    assert_eq!((-1i128).count_ones(), 128);
+    assert_eq!((-1i128).leading_zeros(), 0);
+    assert_eq!((1i128 << 70).trailing_zeros(), 70);
+}
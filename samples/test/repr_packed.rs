@@ -0,0 +1,27 @@
+// `repr(packed)` structs have no padding, and the emitted C struct must agree
+use std::mem::{size_of, align_of};
+
+#[repr(packed)]
+struct P { a: u8, b: u32, c: u16 }
+
+struct Q { _x: u8, p: P, _y: u8 }
+
+#[test]
+fn layout()
+{
+    assert_eq!(size_of::<P>(), 7);
+    assert_eq!(align_of::<P>(), 1);
+    assert_eq!(size_of::<Q>(), 9);
+    assert_eq!(size_of::<[P; 3]>(), 21);
+}
+
+#[test]
+fn field_values()
+{
+    let q = Q { _x: 1, p: P { a: 3, b: 100000, c: 7 }, _y: 2 };
+    let b = q.p.b;
+    let c = q.p.c;
+    assert_eq!(q.p.a, 3);
+    assert_eq!(b, 100000);
+    assert_eq!(c, 7);
+}
@@ -0,0 +1,42 @@
+use std::mem::size_of;
+
+trait Tr { type A: ?Sized; }
+impl Tr for u8 { type A = [u16]; }
+impl Tr for u16 { type A = u16; }
+
+struct Dst<T: ?Sized> { _a: u8, _t: T }
+
+// Pointer sizes within generic code must only be folded once the pointee is known
+fn size_of_ref<T: ?Sized>() -> usize { size_of::<&T>() }
+fn size_of_ptr<T: ?Sized>() -> usize { size_of::<*const T>() }
+fn size_of_opt_ref<T: ?Sized>() -> usize { size_of::<Option<&T>>() }
+fn size_of_assoc_ref<T: Tr>() -> usize { size_of::<&T::A>() }
+fn size_of_dst_ref<T: ?Sized>() -> usize { size_of::<&Dst<T>>() }
+
+#[test]
+fn generic_pointee()
+{
+    let w = size_of::<usize>();
+    assert_eq!(size_of_ref::<[u8]>(), 2*w);
+    assert_eq!(size_of_ref::<u32>(), w);
+    assert_eq!(size_of_ptr::<str>(), 2*w);
+    assert_eq!(size_of_ptr::<u32>(), w);
+    assert_eq!(size_of_opt_ref::<[u8]>(), 2*w);
+    assert_eq!(size_of_opt_ref::<u8>(), w);
+}
+
+#[test]
+fn assoc_pointee()
+{
+    let w = size_of::<usize>();
+    assert_eq!(size_of_assoc_ref::<u8>(), 2*w);
+    assert_eq!(size_of_assoc_ref::<u16>(), w);
+}
+
+#[test]
+fn dst_pointee()
+{
+    let w = size_of::<usize>();
+    assert_eq!(size_of_dst_ref::<[u8]>(), 2*w);
+    assert_eq!(size_of_dst_ref::<u64>(), w);
+}
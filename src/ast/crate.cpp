@@ -6,7 +6,12 @@
 #include "../expand/cfg.hpp"
 #include <hir/hir.hpp>  // HIR::Crate
 #include <hir/main_bindings.hpp>    // HIR_Deserialise
+#include <hir/serialise_lowlevel.hpp>   // worker budget
 #include <fstream>
+#include <set>
+#include <thread>
+#include <atomic>
+#include <exception>
 
 ::std::vector<::std::string>    AST::g_crate_load_dirs = { };
 ::std::map<::std::string, ::std::string>    AST::g_crate_overrides;
@@ -51,19 +56,6 @@ Crate::Crate():
 
 void Crate::load_externs()
 {
-    auto cb = [this](Module& mod) {
-        for( /*const*/ auto& it : mod.items() )
-        {
-            TU_IFLET(AST::Item, it.data, Crate, c,
-                if( check_item_cfg(it.data.attrs) )
-                {
-                    c.name = load_extern_crate( it.data.span, c.name );
-                }
-            )
-        }
-        };
-    iterate_module(m_root_module, cb);
-
     // Check for no_std or no_core, and load libstd/libcore
     // - Duplicates some of the logic in "Expand", but also helps keep crate loading separate to most of expand
     // NOTE: Not all crates are loaded here, any crates loaded by macro invocations will be done during expand.
@@ -88,95 +80,204 @@ void Crate::load_externs()
         }
     }
 
+    // Collect every `extern crate` (and the implicit std/core) so they're all loaded in one batch
+    ::std::vector<ExternCrateRequest>   reqs;
+    ::std::vector< ::std::string*>  req_names;
+    auto cb = [&](Module& mod) {
+        for( /*const*/ auto& it : mod.items() )
+        {
+            TU_IFLET(AST::Item, it.data, Crate, c,
+                if( check_item_cfg(it.data.attrs) )
+                {
+                    reqs.push_back(ExternCrateRequest { it.data.span, c.name, "" });
+                    req_names.push_back(&c.name);
+                }
+            )
+        }
+        };
+    iterate_module(m_root_module, cb);
+
     if( no_core ) {
         // Don't load anything
     }
     else if( no_std ) {
-        auto n = this->load_extern_crate(Span(), "core");
+        reqs.push_back(ExternCrateRequest { Span(), "core", "" });
+    }
+    else {
+        reqs.push_back(ExternCrateRequest { Span(), "std", "" });
+    }
+
+    auto names = this->load_extern_crates(reqs);
+    for(size_t i = 0; i < req_names.size(); i ++)
+    {
+        *req_names[i] = mv$(names[i]);
+    }
+
+    if( no_core ) {
+    }
+    else if( no_std ) {
+        const auto& n = names.back();
         ASSERT_BUG(Span(), n == "core", "libcore wasn't loaded as `core`, instead `" << n << "`");
     }
     else {
-        auto n = this->load_extern_crate(Span(), "std");
+        const auto& n = names.back();
         ASSERT_BUG(Span(), n == "std", "libstd wasn't loaded as `std`, instead `" << n << "`");
     }
 }
-// TODO: Handle disambiguating crates with the same name (e.g. libc in std and crates.io libc)
-// - Crates recorded in rlibs should specify a hash/tag that's passed in to this function.
 ::std::string Crate::load_extern_crate(Span sp, const ::std::string& name, const ::std::string& basename/*=""*/)
 {
-    DEBUG("Loading crate '" << name << "'");
-
-    ::std::string   path;
-    auto it = g_crate_overrides.find(name);
-    if(basename == "" && it != g_crate_overrides.end())
-    {
-        path = it->second;
-    }
-    else
+    return this->load_extern_crates({ ExternCrateRequest { mv$(sp), name, basename } }).front();
+}
+namespace {
+    // TODO: Handle disambiguating crates with the same name (e.g. libc in std and crates.io libc)
+    // - Crates recorded in rlibs should specify a hash/tag that's passed in to this function.
+    ::std::string find_crate_file(const Span& sp, const ::std::string& name, const ::std::string& basename)
     {
-        // Search a list of load paths for the crate
-        for(const auto& p : g_crate_load_dirs)
+        ::std::string   path;
+        auto it = AST::g_crate_overrides.find(name);
+        if(basename == "" && it != AST::g_crate_overrides.end())
+        {
+            path = it->second;
+        }
+        else
         {
-            if( basename == "" )
+            // Search a list of load paths for the crate
+            for(const auto& p : AST::g_crate_load_dirs)
             {
-                path = p + "/lib" + name + ".hir";
+                if( basename == "" )
+                {
+                    path = p + "/lib" + name + ".hir";
+                    // TODO: Search for `p+"/lib"+name+"-*.hir" (which would match e.g. libnum-0.11.hir)
+                }
+                else
+                {
+                    path = p + "/" + basename;
+                }
+
+                if( ::std::ifstream(path).good() ) {
+                    break ;
+                }
                 // TODO: Search for `p+"/lib"+name+"-*.hir" (which would match e.g. libnum-0.11.hir)
             }
+        }
+        if( !::std::ifstream(path).good() ) {
+            if( basename.empty() )
+                ERROR(sp, E0000, "Unable to locate crate '" << name << "'");
             else
-            {
-                path = p + "/" + basename;
-            }
-
-            if( ::std::ifstream(path).good() ) {
-                break ;
-            }
-            // TODO: Search for `p+"/lib"+name+"-*.hir" (which would match e.g. libnum-0.11.hir)
+                ERROR(sp, E0000, "Unable to locate crate '" << name << "' with filename " << basename);
         }
+        return path;
     }
-    if( !::std::ifstream(path).good() ) {
-        if( basename.empty() )
-            ERROR(sp, E0000, "Unable to locate crate '" << name << "'");
-        else
-            ERROR(sp, E0000, "Unable to locate crate '" << name << "' with filename " << basename);
-    }
+}
+::std::vector< ::std::string> Crate::load_extern_crates(const ::std::vector<ExternCrateRequest>& reqs)
+{
+    struct ToLoad {
+        Span    sp;
+        ::std::string   name;
+        ::std::string   path;
+        ::std::vector< ::std::pair< ::std::string, ::std::string> > ext_crates;
+        ::HIR::CratePtr hir;
+        // Failure while loading (re-thrown on the calling thread)
+        ::std::exception_ptr    error;
+    };
+    ::std::vector<ToLoad>   to_load;
+    ::std::set< ::std::string>  queued;
+    // Locate a crate file and read its header, returns the crate's unique name
+    auto queue = [&](const Span& sp, const ::std::string& name, const ::std::string& basename)->::std::string {
+        DEBUG("Loading crate '" << name << "'");
+        auto path = find_crate_file(sp, name, basename);
+        ::std::vector< ::std::pair< ::std::string, ::std::string> >  ext_crates;
+        auto real_name = HIR_Deserialise_Header(path, ext_crates);
+        assert(!real_name.empty());
+        if( m_extern_crates.count(real_name) == 0 && queued.insert(real_name).second )
+        {
+            to_load.push_back(ToLoad { sp, name, mv$(path), mv$(ext_crates), ::HIR::CratePtr(), nullptr });
+        }
+        // else: Crate already loaded
+        DEBUG("Loaded '" << name << "' from '" << basename << "' (actual name is '" << real_name << "')");
+        return real_name;
+        };
 
-    // NOTE: Creating `ExternCrate` loads the crate from the specified path
-    auto ec = ExternCrate { name, path };
-    auto real_name = ec.m_hir->m_crate_name;
-    assert(!real_name.empty());
-    auto res = m_extern_crates.insert(::std::make_pair( real_name, mv$(ec) ));
-    if( !res.second ) {
-        // Crate already loaded?
+    // 1. Find the full set of crates to load (from the requests, and from the headers of those crates)
+    ::std::vector< ::std::string>   rv;
+    for(const auto& r : reqs)
+    {
+        rv.push_back( queue(r.sp, r.name, r.basename) );
     }
-    auto& ext_crate = res.first->second;
-    // Move the external list out (doesn't need to be kept in the nested crate)
-    auto crate_ext_list = mv$( ext_crate.m_hir->m_ext_crates );
-
-    // Load referenced crates
-    for( const auto& ext : crate_ext_list )
+    for(size_t i = 0; i < to_load.size(); i ++)
     {
-        if( m_extern_crates.count(ext.first) == 0 )
+        // NOTE: `queue` may reallocate `to_load`
+        auto sp = to_load[i].sp;
+        auto ext_crates = mv$(to_load[i].ext_crates);
+        for(const auto& ext : ext_crates)
         {
-            const auto load_name = this->load_extern_crate(sp, ext.first, ext.second.m_basename);
-            if( load_name != ext.first )
+            if( m_extern_crates.count(ext.first) == 0 && queued.count(ext.first) == 0 )
             {
-                // ERROR - The crate loaded wasn't the one that was used when compiling this crate.
-                ERROR(sp, E0000, "The crate file `" << ext.second.m_basename << "` didn't load the expected crate - have " << load_name << " != exp " << ext.first);
+                const auto load_name = queue(sp, ext.first, ext.second);
+                if( load_name != ext.first )
+                {
+                    // ERROR - The crate loaded wasn't the one that was used when compiling this crate.
+                    ERROR(sp, E0000, "The crate file `" << ext.second << "` didn't load the expected crate - have " << load_name << " != exp " << ext.first);
+                }
             }
         }
     }
 
-    DEBUG("Loaded '" << name << "' from '" << basename << "' (actual name is '" << real_name << "')");
-    return real_name;
+    // 2. Deserialise them all in parallel (each result goes in its own slot, so the outcome doesn't depend on scheduling)
+    // - Threads come from the metadata worker budget, which chunk decompression within each load also uses
+    // - Debug output isn't thread-safe, so load serially when it's enabled
+    ::std::atomic<size_t>   next_idx { 0 };
+    auto worker = [&]() {
+        for(;;)
+        {
+            size_t i = next_idx ++;
+            if( i >= to_load.size() )
+                break;
+            // An exception can't leave a worker thread (that would terminate), so it's kept until all workers are joined
+            try
+            {
+                to_load[i].hir = HIR_Deserialise(to_load[i].path, to_load[i].name);
+            }
+            catch(...)
+            {
+                to_load[i].error = ::std::current_exception();
+            }
+        }
+        };
+    ::std::vector< ::std::thread>   threads;
+    while( !debug_enabled() && threads.size() + 1 < to_load.size() && ::HIR::serialise::try_acquire_worker() )
+    {
+        threads.push_back( ::std::thread([&](){ worker(); ::HIR::serialise::release_worker(); }) );
+    }
+    worker();
+    for(auto& t : threads)
+        t.join();
+    // Report the first failure in discovery order (same as a serial load would)
+    for(auto& e : to_load)
+    {
+        if( e.error )
+            ::std::rethrow_exception(e.error);
+    }
+
+    // 3. Add to the crate, in discovery order
+    for(auto& e : to_load)
+    {
+        auto ec = ExternCrate { e.name, e.path, mv$(e.hir) };
+        // The external list isn't needed in the nested crate (everything it references was loaded above)
+        ec.m_hir->m_ext_crates.clear();
+        auto real_name = ec.m_name;
+        m_extern_crates.insert(::std::make_pair( mv$(real_name), mv$(ec) ));
+    }
+
+    return rv;
 }
 
-ExternCrate::ExternCrate(const ::std::string& name, const ::std::string& path):
+ExternCrate::ExternCrate(const ::std::string& name, const ::std::string& path, ::HIR::CratePtr hir):
     m_name(name),
-    m_filename(path)
+    m_filename(path),
+    m_hir(mv$(hir))
 {
     TRACE_FUNCTION_F("name=" << name << ", path='" << path << "'");
-    m_hir = HIR_Deserialise(path, name);
-
     m_hir->post_load_update(name);
     m_name = m_hir->m_crate_name;
 }
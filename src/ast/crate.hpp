@@ -10,6 +10,15 @@ namespace AST {
 
 class ExternCrate;
 
+/// A crate to be loaded by `Crate::load_extern_crates`
+struct ExternCrateRequest
+{
+    Span    sp;
+    ::std::string   name;
+    /// If non-empty, only this filename will be loaded (from any of the search paths)
+    ::std::string   basename;
+};
+
 class TestDesc
 {
 public:
@@ -71,6 +80,9 @@ public:
     /// Load the named crate and returns the crate's unique name
     /// If the parameter `file` is non-empty, only that particular filename will be loaded (from any of the search paths)
     ::std::string load_extern_crate(Span sp, const ::std::string& name, const ::std::string& file="");
+    /// Load a set of crates (and all crates they reference) as a batch, returns the unique name of each requested crate
+    /// - The full set is found by reading metadata headers, then all crates are deserialised in parallel
+    ::std::vector< ::std::string> load_extern_crates(const ::std::vector<ExternCrateRequest>& reqs);
 };
 
 /// Representation of an imported crate
@@ -81,7 +93,7 @@ public:
     ::std::string   m_filename;
     ::HIR::CratePtr m_hir;
 
-    ExternCrate(const ::std::string& name, const ::std::string& path);
+    ExternCrate(const ::std::string& name, const ::std::string& path, ::HIR::CratePtr hir);
 
     ExternCrate(ExternCrate&&) = default;
     ExternCrate& operator=(ExternCrate&&) = default;
@@ -62,6 +62,23 @@ Expr Expr::clone() const
 ExprNode::~ExprNode() {
 }
 
+namespace {
+    NodePool& expr_node_pool() {
+        // NOTE: Leaked to avoid issues with destruction order at exit
+        static NodePool* s_pool = new NodePool("AST::ExprNode");
+        return *s_pool;
+    }
+}
+void* ExprNode::operator new(size_t size) {
+    return expr_node_pool().allocate(size);
+}
+void ExprNode::operator delete(void* ptr, size_t size) {
+    expr_node_pool().deallocate(ptr, size);
+}
+const NodePool& ExprNode::pool() {
+    return expr_node_pool();
+}
+
 #define NODE(class, _print, _clone)\
     void class::visit(NodeVisitor& nv) { nv.visit(*this); } \
     void class::print(::std::ostream& os) const _print \
@@ -16,6 +16,7 @@
 #include "types.hpp"
 #include "pattern.hpp"
 #include "attrs.hpp"
+#include <node_pool.hpp>
 
 namespace AST {
 
@@ -30,6 +31,11 @@ class ExprNode
 public:
     virtual ~ExprNode() = 0;
 
+    // Nodes are allocated from a pool (see node_pool.hpp)
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+    static const NodePool& pool();
+
     virtual void visit(NodeVisitor& nv) = 0;
     virtual void print(::std::ostream& os) const = 0;
     virtual ::std::unique_ptr<ExprNode> clone() const = 0;
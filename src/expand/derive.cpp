@@ -11,6 +11,7 @@
 #include "../ast/expr.hpp"
 #include "../ast/crate.hpp"
 #include <hir/hir.hpp>  // ABI_RUST
+#include <algorithm>
 
 template<typename T>
 static inline ::std::vector<T> vec$(T v1) {
@@ -72,6 +73,34 @@ struct Deriver
     }
 
 
+    /// Returns true if none of the enum's variants carry data (C-like enum)
+    static bool is_fieldless(const AST::Enum& enm)
+    {
+        if( enm.variants().empty() )
+            return false;
+        for(const auto& v : enm.variants())
+        {
+            if( !v.m_data.is_Value() )
+                return false;
+        }
+        return true;
+    }
+    /// `unsafe { ::core::intrinsics::discriminant_value(val) }` - `val` must be a reference
+    AST::ExprNodeP get_discriminant(const ::std::string& core_name, AST::ExprNodeP val) const
+    {
+        return NEWNODE(Block, true, true, vec$(
+            NEWNODE(CallPath, AST::Path(core_name, { AST::PathNode("intrinsics", {}), AST::PathNode("discriminant_value", {}) }),
+                vec$( mv$(val) )
+                )
+            ), {});
+    }
+    /// `get_discriminant(val) as isize` - Discriminants are signed, so must be ordered as `isize`
+    AST::ExprNodeP get_discriminant_ord(const Span& sp, const ::std::string& core_name, AST::ExprNodeP val) const
+    {
+        return NEWNODE(Cast, this->get_discriminant(core_name, mv$(val)), TypeRef(sp, CORETYPE_INT));
+    }
+
+
     AST::GenericParams get_params_with_bounds(const Span& sp, const AST::GenericParams& p, const AST::Path& trait_path, ::std::vector<TypeRef> additional_bounded_types) const
     {
         AST::GenericParams  params = p.clone();
@@ -535,6 +564,15 @@ public:
 
     AST::Impl handle_item(Span sp, const ::std::string& core_name, const AST::GenericParams& p, const TypeRef& type, const AST::Enum& enm) const override
     {
+        // C-like enums only need their discriminants compared, instead of a match arm per variant
+        if( is_fieldless(enm) )
+        {
+            return this->make_ret(sp, core_name, p, type, this->get_field_bounds(enm), NEWNODE(BinOp, AST::ExprNode_BinOp::CMPEQU,
+                this->get_discriminant(core_name, NEWNODE(NamedValue, AST::Path("self"))),
+                this->get_discriminant(core_name, NEWNODE(NamedValue, AST::Path("v")))
+                ));
+        }
+
         AST::Path base_path = type.m_data.as_Path().path;
         base_path.nodes().back().args() = ::AST::PathParams();
         ::std::vector<AST::ExprNode_Match_Arm>   arms;
@@ -706,6 +744,15 @@ class Deriver_PartialOrd:
             ::make_vec1( NEWNODE(NamedValue, this->get_path(core_name, "cmp", "Ordering", "Equal")) )
             );
     }
+    AST::ExprNodeP compare_discriminants(const Span& sp, const ::std::string& core_name) const
+    {
+        return NEWNODE(CallPath, this->get_path(core_name, "cmp", "PartialOrd", "partial_cmp"),
+            ::make_vec2(
+                NEWNODE(UniOp, AST::ExprNode_UniOp::REF, this->get_discriminant_ord(sp, core_name, NEWNODE(NamedValue, AST::Path("self")))),
+                NEWNODE(UniOp, AST::ExprNode_UniOp::REF, this->get_discriminant_ord(sp, core_name, NEWNODE(NamedValue, AST::Path("v"))))
+                )
+            );
+    }
 public:
     const char* trait_name() const override { return "PartialOrd"; }
 
@@ -743,6 +790,12 @@ public:
 
     AST::Impl handle_item(Span sp, const ::std::string& core_name, const AST::GenericParams& p, const TypeRef& type, const AST::Enum& enm) const override
     {
+        // C-like enums only need their discriminants compared
+        if( is_fieldless(enm) )
+        {
+            return this->make_ret(sp, core_name, p, type, this->get_field_bounds(enm), this->compare_discriminants(sp, core_name));
+        }
+
         AST::Path base_path = type.m_data.as_Path().path;
         base_path.nodes().back().args() = ::AST::PathParams();
         ::std::vector<AST::ExprNode_Match_Arm>   arms;
@@ -822,57 +875,12 @@ public:
                 ));
         }
 
-        // TODO: Compare the discriminants using the `discriminant_value` intrinsic
-        // - Requires a way of emitting said intrinsic into the AST
-        for(unsigned int a = 0; a < enm.variants().size(); a ++ )
-        {
-            for(unsigned int b = 0; b < enm.variants().size(); b ++ )
-            {
-                if( a == b )
-                    continue ;
-
-                struct H {
-                    static ::AST::Pattern get_pat_nc(const AST::Path& base_path, const AST::EnumVariant& v) {
-                        AST::Path   var_path = base_path + v.m_name;
-
-                        TU_MATCH(::AST::EnumVariantData, (v.m_data), (e),
-                        (Value,
-                            return AST::Pattern(AST::Pattern::TagValue(), AST::Pattern::Value::make_Named(var_path));
-                            ),
-                        (Tuple,
-                            return AST::Pattern(AST::Pattern::TagNamedTuple(), var_path, AST::Pattern::TuplePat { {}, true, {} });
-                            ),
-                        (Struct,
-                            return AST::Pattern(AST::Pattern::TagStruct(), var_path, {}, false);
-                            )
-                        )
-                        throw "";
-                    }
-                };
-                ::AST::Pattern  pat_a = H::get_pat_nc(base_path, enm.variants()[a]);
-                ::AST::Pattern  pat_b = H::get_pat_nc(base_path, enm.variants()[b]);
-
-                ::std::vector< AST::Pattern>    pats;
-                {
-                    ::std::vector< AST::Pattern>    tuple_pats;
-                    tuple_pats.push_back( AST::Pattern(AST::Pattern::TagReference(), false, mv$(pat_a)) );
-                    tuple_pats.push_back( AST::Pattern(AST::Pattern::TagReference(), false, mv$(pat_b)) );
-                    pats.push_back( AST::Pattern(AST::Pattern::TagTuple(), mv$(tuple_pats)) );
-                }
-
-                auto code = NEWNODE(CallPath, this->get_path(core_name, "option", "Option", "Some"),
-                    ::make_vec1(
-                        NEWNODE(NamedValue, this->get_path(core_name, "cmp", "Ordering", (a < b ? "Less" : "Greater")))
-                        )
-                    );
-
-                arms.push_back(AST::ExprNode_Match_Arm(
-                    mv$(pats),
-                    nullptr,
-                    mv$(code)
-                    ));
-            }
-        }
+        // Differing variants are ordered by their discriminants
+        arms.push_back(AST::ExprNode_Match_Arm(
+            ::make_vec1( AST::Pattern() ),
+            nullptr,
+            this->compare_discriminants(sp, core_name)
+            ));
 
         ::std::vector<AST::ExprNodeP>   vals;
         vals.push_back( NEWNODE(NamedValue, AST::Path("self")) );
@@ -1093,6 +1101,15 @@ class Deriver_Ord:
     {
         return NEWNODE(NamedValue, this->get_path(core_name, "cmp", "Ordering", "Equal"));
     }
+    AST::ExprNodeP compare_discriminants(const Span& sp, const ::std::string& core_name) const
+    {
+        return NEWNODE(CallPath, this->get_path(core_name, "cmp", "Ord", "cmp"),
+            ::make_vec2(
+                NEWNODE(UniOp, AST::ExprNode_UniOp::REF, this->get_discriminant_ord(sp, core_name, NEWNODE(NamedValue, AST::Path("self")))),
+                NEWNODE(UniOp, AST::ExprNode_UniOp::REF, this->get_discriminant_ord(sp, core_name, NEWNODE(NamedValue, AST::Path("v"))))
+                )
+            );
+    }
 public:
     const char* trait_name() const override { return "Ord"; }
 
@@ -1130,6 +1147,12 @@ public:
 
     AST::Impl handle_item(Span sp, const ::std::string& core_name, const AST::GenericParams& p, const TypeRef& type, const AST::Enum& enm) const override
     {
+        // C-like enums only need their discriminants compared
+        if( is_fieldless(enm) )
+        {
+            return this->make_ret(sp, core_name, p, type, this->get_field_bounds(enm), this->compare_discriminants(sp, core_name));
+        }
+
         AST::Path base_path = type.m_data.as_Path().path;
         base_path.nodes().back().args() = ::AST::PathParams();
         ::std::vector<AST::ExprNode_Match_Arm>   arms;
@@ -1209,51 +1232,12 @@ public:
                 ));
         }
 
-        for(unsigned int a = 0; a < enm.variants().size(); a ++ )
-        {
-            for(unsigned int b = 0; b < enm.variants().size(); b ++ )
-            {
-                if( a == b )
-                    continue ;
-
-                struct H {
-                    static ::AST::Pattern get_pat_nc(const AST::Path& base_path, const AST::EnumVariant& v) {
-                        AST::Path   var_path = base_path + v.m_name;
-
-                        TU_MATCH(::AST::EnumVariantData, (v.m_data), (e),
-                        (Value,
-                            return AST::Pattern(AST::Pattern::TagValue(), AST::Pattern::Value::make_Named(var_path));
-                            ),
-                        (Tuple,
-                            return AST::Pattern(AST::Pattern::TagNamedTuple(), var_path, AST::Pattern::TuplePat { {}, true, {} });
-                            ),
-                        (Struct,
-                            return AST::Pattern(AST::Pattern::TagStruct(), var_path, {}, false);
-                            )
-                        )
-                        throw "";
-                    }
-                };
-                ::AST::Pattern  pat_a = H::get_pat_nc(base_path, enm.variants()[a]);
-                ::AST::Pattern  pat_b = H::get_pat_nc(base_path, enm.variants()[b]);
-
-                ::std::vector< AST::Pattern>    pats;
-                {
-                    ::std::vector< AST::Pattern>    tuple_pats;
-                    tuple_pats.push_back( AST::Pattern(AST::Pattern::TagReference(), false, mv$(pat_a)) );
-                    tuple_pats.push_back( AST::Pattern(AST::Pattern::TagReference(), false, mv$(pat_b)) );
-                    pats.push_back( AST::Pattern(AST::Pattern::TagTuple(), mv$(tuple_pats)) );
-                }
-
-                auto code = NEWNODE(NamedValue, this->get_path(core_name, "cmp", "Ordering", (a < b ? "Less" : "Greater")));
-
-                arms.push_back(AST::ExprNode_Match_Arm(
-                    mv$(pats),
-                    nullptr,
-                    mv$(code)
-                    ));
-            }
-        }
+        // Differing variants are ordered by their discriminants
+        arms.push_back(AST::ExprNode_Match_Arm(
+            ::make_vec1( AST::Pattern() ),
+            nullptr,
+            this->compare_discriminants(sp, core_name)
+            ));
 
         ::std::vector<AST::ExprNodeP>   vals;
         vals.push_back( NEWNODE(NamedValue, AST::Path("self")) );
@@ -1315,6 +1299,14 @@ class Deriver_Clone:
 public:
     const char* trait_name() const override { return "Clone"; }
 
+    /// Clone for a type that also derives Copy (and has no type parameters) is a plain copy
+    AST::Impl handle_item_copy(Span sp, const ::std::string& core_name, const AST::GenericParams& p, const TypeRef& type) const
+    {
+        return this->make_ret(sp, core_name, p, type, {}, NEWNODE(Deref,
+            NEWNODE(NamedValue, AST::Path("self"))
+            ));
+    }
+
     AST::Impl handle_item(Span sp, const ::std::string& core_name, const AST::GenericParams& p, const TypeRef& type, const AST::Struct& str) const override
     {
         const AST::Path& ty_path = type.m_data.as_Path().path;
@@ -2200,6 +2192,9 @@ static void derive_item(const Span& sp, const AST::Crate& crate, AST::Module& mo
         types_args.m_types.push_back( TypeRef(TypeRef::TagArg(), sp, param.name()) );
     }
 
+    bool derives_copy = ::std::any_of(attr.items().begin(), attr.items().end(), [](const auto& t){ return t.name() == "Copy"; });
+    const auto core_name = (crate.m_load_std == ::AST::Crate::LOAD_NONE ? "" : "core");
+
     ::std::vector< ::std::string>   missing_handlers;
     for( const auto& trait : attr.items() )
     {
@@ -2212,7 +2207,15 @@ static void derive_item(const Span& sp, const AST::Crate& crate, AST::Module& mo
             continue ;
         }
 
-        mod.add_item(false, "", dp->handle_item(sp, (crate.m_load_std == ::AST::Crate::LOAD_NONE ? "" : "core"), params, type, item), {} );
+        // `#[derive(Clone, Copy)]` on a non-generic type: emit `*self` instead of a field-wise clone, saves
+        // typecheck/MIR/optimise work for every field.
+        if( dp == &g_derive_clone && derives_copy && params.ty_params().empty() )
+        {
+            mod.add_item(false, "", g_derive_clone.handle_item_copy(sp, core_name, params, type), {} );
+            continue ;
+        }
+
+        mod.add_item(false, "", dp->handle_item(sp, core_name, params, type, item), {} );
     }
 
     if( fail ) {
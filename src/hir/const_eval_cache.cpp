@@ -0,0 +1,100 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * hir/const_eval_cache.cpp
+ * - Memoisation and resource limits for constant evaluation
+ */
+#include "const_eval_cache.hpp"
+#include <functional>   // std::hash
+
+namespace HIR {
+
+    namespace {
+        void hash_combine(size_t& h, size_t v)
+        {
+            h ^= v + 0x9e3779b9 + (h << 6) + (h >> 2);
+        }
+    }
+
+    size_t hash_literal(const Literal& v)
+    {
+        size_t  rv = static_cast<size_t>(v.tag());
+        TU_MATCH(::HIR::Literal, (v), (e),
+        (Invalid,
+            ),
+        (List,
+            for(const auto& val : e)
+                hash_combine(rv, hash_literal(val));
+            ),
+        (Packed,
+            hash_combine(rv, e.elem_size);
+            hash_combine(rv, e.is_signed);
+            hash_combine(rv, ::std::hash< ::std::string>()( ::std::string(e.data.begin(), e.data.end()) ));
+            ),
+        (Variant,
+            hash_combine(rv, e.idx);
+            for(const auto& val : e.vals)
+                hash_combine(rv, hash_literal(val));
+            ),
+        (Integer,
+            hash_combine(rv, ::std::hash<uint64_t>()(e));
+            ),
+        (Float,
+            hash_combine(rv, ::std::hash<double>()(e));
+            ),
+        (BorrowPath,
+            hash_combine(rv, ::std::hash< ::std::string>()( FMT(e) ));
+            ),
+        (BorrowData,
+            hash_combine(rv, hash_literal(*e));
+            ),
+        (String,
+            hash_combine(rv, ::std::hash< ::std::string>()(e));
+            )
+        )
+        return rv;
+    }
+
+    namespace {
+        size_t hash_args(const ::std::vector<Literal>& args)
+        {
+            size_t  rv = args.size();
+            for(const auto& a : args)
+                hash_combine(rv, hash_literal(a));
+            return rv;
+        }
+    }
+
+    const unsigned int ConstEvalCache::MAX_DEPTH;
+    const size_t ConstEvalCache::MAX_STEPS;
+    const size_t ConstEvalCache::MAX_ARRAY_LEN;
+
+    void ConstEvalCache::clear()
+    {
+        m_entries.clear();
+        m_depth = 0;
+        m_steps = 0;
+    }
+
+    const Literal* ConstEvalCache::get(const ::std::string& path, const ::std::vector<Literal>& args) const
+    {
+        auto it = m_entries.find( ::std::make_pair(path, hash_args(args)) );
+        if( it == m_entries.end() )
+            return nullptr;
+        for(const auto& ent : it->second)
+        {
+            if( ent.args == args )
+                return &ent.value;
+        }
+        return nullptr;
+    }
+
+    void ConstEvalCache::insert(::std::string path, ::std::vector<Literal> args, Literal value)
+    {
+        auto key = ::std::make_pair( mv$(path), hash_args(args) );
+        m_entries[mv$(key)].push_back( Entry { mv$(args), mv$(value) } );
+    }
+
+}   // namespace HIR
+
@@ -0,0 +1,81 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * hir/const_eval_cache.hpp
+ * - Memoisation and resource limits for constant evaluation
+ */
+#pragma once
+#include "hir.hpp"
+#include <map>
+
+namespace HIR {
+
+extern size_t hash_literal(const Literal& v);
+
+/// Results of `const fn` calls and `const` items, shared by every evaluation in a pass
+///
+/// Entries are keyed on the (monomorphised) path and the argument literals, the argument
+/// hash narrows the search and `operator==` confirms the match.
+class ConstEvalCache
+{
+public:
+    /// Maximum nesting of `const fn` calls and constant references
+    static const unsigned int MAX_DEPTH = 256;
+    /// Maximum number of MIR statements executed while evaluating a single top-level item
+    static const size_t MAX_STEPS = 10*1000*1000;
+    /// Maximum number of elements in one array value
+    static const size_t MAX_ARRAY_LEN = 16*1024*1024;
+
+private:
+    struct Entry {
+        ::std::vector<Literal>  args;
+        Literal value;
+    };
+    ::std::map< ::std::pair< ::std::string, size_t>, ::std::vector<Entry> >  m_entries;
+
+    unsigned int    m_depth = 0;
+    size_t  m_steps = 0;
+
+public:
+    void clear();
+
+    /// Find a previously computed value (the caller clones it)
+    const Literal* get(const ::std::string& path, const ::std::vector<Literal>& args) const;
+    /// Record a computed value, `args` and `value` must be owned copies
+    void insert(::std::string path, ::std::vector<Literal> args, Literal value);
+
+    /// Account for one executed statement/terminator
+    void step(const Span& sp) {
+        if( ++ m_steps > MAX_STEPS )
+            ERROR(sp, E0000, "Constant evaluation exceeded the step limit (" << MAX_STEPS << " steps), possible infinite loop");
+    }
+    /// Check that an array of `count` elements is within the limit
+    void check_array_len(const Span& sp, size_t count) const {
+        if( count > MAX_ARRAY_LEN )
+            ERROR(sp, E0000, "Constant evaluation exceeded the memory limit - array of " << count << " elements (max " << MAX_ARRAY_LEN << ")");
+    }
+
+    /// Marks one level of nested evaluation, the step count restarts with each top-level item
+    class Frame
+    {
+        ConstEvalCache& m_cache;
+    public:
+        Frame(ConstEvalCache& cache, const Span& sp, const FmtLambda& name):
+            m_cache(cache)
+        {
+            if( m_cache.m_depth == 0 )
+                m_cache.m_steps = 0;
+            if( m_cache.m_depth >= MAX_DEPTH )
+                ERROR(sp, E0000, "Constant evaluation exceeded the recursion limit (" << MAX_DEPTH << ") evaluating " << name);
+            m_cache.m_depth ++;
+        }
+        Frame(const Frame&) = delete;
+        ~Frame() {
+            m_cache.m_depth --;
+        }
+    };
+};
+
+}   // namespace HIR
+
@@ -13,9 +13,29 @@
 #include <macro_rules/macro_rules.hpp>
 #include "serialise_lowlevel.hpp"
 #include <typeinfo>
+#include <mutex>
 
 namespace {
 
+    /// Fills the MIR placeholders of one crate from its MIR section (`<crate>.hir.mir`)
+    class MirSectionLoader:
+        public ::MIR::LazyLoader
+    {
+        ::std::mutex    m_lock;
+        ::std::string   m_filename;
+        ::std::string   m_crate_name;
+    public:
+        // Placeholders in section order (one for every function in the section)
+        ::std::vector< ::MIR::Function*>    m_placeholders;
+
+        MirSectionLoader(::std::string filename):
+            m_filename( mv$(filename) )
+        {}
+        void set_crate_name(::std::string name) { m_crate_name = mv$(name); }
+
+        void load() override;
+    };
+
     template<typename T>
     struct D
     {
@@ -25,14 +45,30 @@ namespace {
     {
         ::std::string m_crate_name;
         ::HIR::serialise::Reader&   m_in;
+
+        // Deduplication tables (see HirSerialiser), entries are cloned out on each back-reference
+        // - Paths and types are values (owning their inner types), so the loaded HIR holds a full copy for each use.
+        //   This saves re-reading and re-parsing, not memory - the tables are an extra copy until the load finishes.
+        ::std::vector< ::HIR::SimplePath>   m_simplepaths;
+        ::std::vector< ::HIR::GenericPath>  m_genericpaths;
+        ::std::vector< ::HIR::TypeRef>  m_types;
+
+        // Source of deferred MIR, created on the first deferred body
+        ::std::string   m_mir_filename;
+        ::std::shared_ptr<MirSectionLoader> m_mir_loader;
     public:
         HirDeserialiser(::HIR::serialise::Reader& in):
             m_in(in)
         {}
 
+        const ::std::string& crate_name() const { return m_crate_name; }
+        void set_crate_name(::std::string name) { m_crate_name = mv$(name); }
+        void set_mir_filename(::std::string filename) { m_mir_filename = mv$(filename); }
+
         ::std::string read_string() { return m_in.read_string(); }
         bool read_bool() { return m_in.read_bool(); }
         size_t deserialise_count() { return m_in.read_count(); }
+        uint64_t read_u64c() { return m_in.read_u64c(); }
 
         template<typename V>
         ::std::map< ::std::string,V> deserialise_strmap()
@@ -114,6 +150,7 @@ namespace {
 
 
         ::HIR::TypeRef deserialise_type();
+        ::HIR::TypeRef deserialise_type_inner();
         ::HIR::SimplePath deserialise_simplepath();
         ::HIR::PathParams deserialise_pathparams();
         ::HIR::GenericPath deserialise_genericpath();
@@ -125,6 +162,7 @@ namespace {
         ::HIR::GenericBound deserialise_genericbound();
 
         ::HIR::Crate deserialise_crate();
+        ::std::vector< ::std::pair< ::std::string, ::std::string> > deserialise_crate_header();
         ::HIR::ExternLibrary deserialise_extlib();
         ::HIR::Module deserialise_module();
 
@@ -314,9 +352,26 @@ namespace {
         ::HIR::ExprPtr deserialise_exprptr()
         {
             ::HIR::ExprPtr  rv;
-            if( m_in.read_bool() )
+            switch( m_in.read_tag() )
             {
+            case 0:
+                break;
+            case 1:
                 rv.m_mir = deserialise_mir();
+                break;
+            case 2: {
+                if( !m_mir_loader )
+                {
+                    assert(!m_mir_filename.empty() && "Deferred MIR without a MIR section");
+                    m_mir_loader = ::std::make_shared<MirSectionLoader>(m_mir_filename);
+                    m_mir_loader->set_crate_name(m_crate_name);
+                }
+                ::MIR::Function*    ph = nullptr;
+                rv.m_mir = ::MIR::FunctionPointer::new_pending(m_mir_loader, ph);
+                m_mir_loader->m_placeholders.push_back(ph);
+                break; }
+            default:
+                throw ::std::runtime_error("Unknown MIR tag");
             }
             rv.m_erased_types = deserialise_vec< ::HIR::TypeRef>();
             return rv;
@@ -542,7 +597,9 @@ namespace {
                 deserialise_fcnargs(),
                 m_in.read_bool(),
                 deserialise_type(),
-                deserialise_exprptr()
+                deserialise_exprptr(),
+                static_cast< ::HIR::Function::Inline>( m_in.read_tag() ),
+                m_in.read_bool()
                 };
             return rv;
         }
@@ -606,6 +663,7 @@ namespace {
             uint8_t bitflag_1 = m_in.read_u8();
             #define BIT(i,fld)  fld = (bitflag_1 & (1 << (i))) != 0;
             BIT(0, m.can_unsize)
+            BIT(1, m.is_vtable)
             #undef BIT
             m.dst_type = static_cast< ::HIR::StructMarkings::DstType>( m_in.read_tag() );
             m.coerce_unsized = static_cast<::HIR::StructMarkings::Coerce>( m_in.read_tag() );
@@ -703,6 +761,18 @@ namespace {
     template<> DEF_D( ::HIR::ExternLibrary, return d.deserialise_extlib(); )
 
     ::HIR::TypeRef HirDeserialiser::deserialise_type()
+    {
+        auto idx = m_in.read_u64c();
+        if( idx > 0 ) {
+            if( idx > m_types.size() )
+                throw ::std::runtime_error(FMT("Bad TypeRef index - " << idx-1 << " >= " << m_types.size()));
+            return m_types[idx-1].clone();
+        }
+        auto rv = deserialise_type_inner();
+        m_types.push_back( rv.clone() );
+        return rv;
+    }
+    ::HIR::TypeRef HirDeserialiser::deserialise_type_inner()
     {
         ::HIR::TypeRef  rv;
         TRACE_FUNCTION_FR("", rv);
@@ -768,6 +838,12 @@ namespace {
     ::HIR::SimplePath HirDeserialiser::deserialise_simplepath()
     {
         TRACE_FUNCTION;
+        auto idx = m_in.read_u64c();
+        if( idx > 0 ) {
+            if( idx > m_simplepaths.size() )
+                throw ::std::runtime_error(FMT("Bad SimplePath index - " << idx-1 << " >= " << m_simplepaths.size()));
+            return m_simplepaths[idx-1];
+        }
         // HACK! If the read crate name is empty, replace it with the name we're loaded with
         auto crate_name = m_in.read_string();
         auto components = deserialise_vec< ::std::string>();
@@ -776,10 +852,8 @@ namespace {
             assert(!m_crate_name.empty());
             crate_name = m_crate_name;
         }
-        return ::HIR::SimplePath {
-            mv$(crate_name),
-            mv$(components)
-            };
+        m_simplepaths.push_back( ::HIR::SimplePath { mv$(crate_name), mv$(components) } );
+        return m_simplepaths.back();
     }
     ::HIR::PathParams HirDeserialiser::deserialise_pathparams()
     {
@@ -791,9 +865,16 @@ namespace {
     ::HIR::GenericPath HirDeserialiser::deserialise_genericpath()
     {
         TRACE_FUNCTION;
+        auto idx = m_in.read_u64c();
+        if( idx > 0 ) {
+            if( idx > m_genericpaths.size() )
+                throw ::std::runtime_error(FMT("Bad GenericPath index - " << idx-1 << " >= " << m_genericpaths.size()));
+            return m_genericpaths[idx-1].clone();
+        }
         auto spath = deserialise_simplepath();
         auto params = deserialise_pathparams();
-        return ::HIR::GenericPath { mv$(spath), mv$(params) };
+        m_genericpaths.push_back( ::HIR::GenericPath { mv$(spath), mv$(params) } );
+        return m_genericpaths.back().clone();
     }
 
     ::HIR::TraitPath HirDeserialiser::deserialise_traitpath()
@@ -973,6 +1054,14 @@ namespace {
         #define _(x, ...)    case ::HIR::Literal::TAG_##x:   return ::HIR::Literal::make_##x(__VA_ARGS__);
         _(Invalid, {})
         _(List,   deserialise_vec< ::HIR::Literal>() )
+        case ::HIR::Literal::TAG_Packed: {
+            unsigned int elem_size = m_in.read_u8();
+            bool is_signed = (elem_size & 0x80) != 0;
+            elem_size &= 0x7F;
+            ::std::vector<uint8_t>  data( static_cast<size_t>(m_in.read_u64c()) );
+            m_in.read(data.data(), data.size());
+            return ::HIR::Literal::make_Packed({ elem_size, is_signed, mv$(data) });
+            }
         _(Variant, {
             static_cast<unsigned int>(m_in.read_count()),
             deserialise_vec< ::HIR::Literal>()
@@ -1120,12 +1209,31 @@ namespace {
             m_in.read_string()
             };
     }
+    ::std::vector< ::std::pair< ::std::string, ::std::string> > HirDeserialiser::deserialise_crate_header()
+    {
+        this->m_crate_name = m_in.read_string();
+        assert(!this->m_crate_name.empty() && "Empty crate name loaded from metadata");
+
+        ::std::vector< ::std::pair< ::std::string, ::std::string> >  rv;
+        size_t n = m_in.read_count();
+        for(size_t i = 0; i < n; i ++)
+        {
+            auto ext_crate_name = m_in.read_string();
+            auto ext_crate_file = m_in.read_string();
+            rv.push_back( ::std::make_pair( mv$(ext_crate_name), mv$(ext_crate_file) ) );
+        }
+        return rv;
+    }
     ::HIR::Crate HirDeserialiser::deserialise_crate()
     {
         ::HIR::Crate    rv;
 
-        this->m_crate_name = m_in.read_string();
-        assert(!this->m_crate_name.empty() && "Empty crate name loaded from metadata");
+        for(auto& ext : deserialise_crate_header())
+        {
+            auto ext_crate = ::HIR::ExternCrate {};
+            ext_crate.m_basename = mv$(ext.second);
+            rv.m_ext_crates.insert( ::std::make_pair( mv$(ext.first), mv$(ext_crate) ) );
+        }
         rv.m_crate_name = this->m_crate_name;
         rv.m_root_module = deserialise_module();
 
@@ -1151,31 +1259,54 @@ namespace {
         rv.m_exported_macros = deserialise_strumap< ::MacroRulesPtr>();
         rv.m_lang_items = deserialise_strumap< ::HIR::SimplePath>();
 
-        {
-            size_t n = m_in.read_count();
-            for(size_t i = 0; i < n; i ++)
-            {
-                auto ext_crate_name = m_in.read_string();
-                auto ext_crate_file = m_in.read_string();
-                auto ext_crate = ::HIR::ExternCrate {};
-                ext_crate.m_basename = ext_crate_file;
-                rv.m_ext_crates.insert( ::std::make_pair( mv$(ext_crate_name), mv$(ext_crate) ) );
-            }
-        }
-
         rv.m_ext_libs = deserialise_vec< ::HIR::ExternLibrary>();
         rv.m_link_paths = deserialise_vec< ::std::string>();
+        rv.m_exported_glue = deserialise_vec< ::std::string>();
+        rv.m_exported_instances = deserialise_vec< ::std::string>();
 
         return rv;
     }
 }
 
+void MirSectionLoader::load()
+{
+    ::std::lock_guard< ::std::mutex>    lh { m_lock };
+    if( m_placeholders.empty() )
+        return ;
+    DEBUG("Loading MIR section " << m_filename << " (" << m_placeholders.size() << " functions)");
+    try
+    {
+        ::HIR::serialise::Reader    in{ m_filename };
+        HirDeserialiser  s { in };
+        s.set_crate_name(m_crate_name);
+
+        auto n = s.read_u64c();
+        if( n != m_placeholders.size() )
+            throw ::std::runtime_error(FMT("Function count mismatch, " << n << " != " << m_placeholders.size()));
+        for(auto* ph : m_placeholders)
+        {
+            auto fcn = s.deserialise_mir();
+            // Placeholders of functions that have since been dropped are skipped
+            ::MIR::FunctionPointer::fill_pending(ph, this, mv$(*fcn));
+        }
+        m_placeholders.clear();
+    }
+    catch(int)
+    { ::std::abort(); }
+    catch(const ::std::runtime_error& e)
+    {
+        ::std::cerr << "Unable to deserialise MIR from " << m_filename << ": " << e.what() << ::std::endl;
+        ::std::abort();
+    }
+}
+
 ::HIR::CratePtr HIR_Deserialise(const ::std::string& filename, const ::std::string& loaded_name)
 {
     try
     {
         ::HIR::serialise::Reader    in{ filename };
         HirDeserialiser  s { in };
+        s.set_mir_filename(filename + ".mir");
 
         ::HIR::Crate    rv = s.deserialise_crate();
 
@@ -1197,4 +1328,34 @@ namespace {
     }
     #endif
 }
+::std::string HIR_Deserialise_Header(const ::std::string& filename, ::std::vector< ::std::pair< ::std::string, ::std::string> >& out_ext_crates)
+{
+    try
+    {
+        ::HIR::serialise::Reader    in{ filename };
+        HirDeserialiser  s { in };
 
+        out_ext_crates = s.deserialise_crate_header();
+        return s.crate_name();
+    }
+    catch(int)
+    { ::std::abort(); }
+    catch(const ::std::runtime_error& e)
+    {
+        ::std::cerr << "Unable to read crate metadata header from " << filename << ": " << e.what() << ::std::endl;
+        ::std::abort();
+    }
+}
+
+void HIR_Deserialise_PathsTypes(::HIR::serialise::Reader& in, ::std::vector< ::HIR::Path>& out_paths, ::std::vector< ::HIR::TypeRef>& out_types)
+{
+    HirDeserialiser  s { in };
+    size_t n_paths = in.read_u64c();
+    out_paths.reserve(n_paths);
+    for(size_t i = 0; i < n_paths; i ++)
+        out_paths.push_back( s.deserialise_path() );
+    size_t n_types = in.read_u64c();
+    out_types.reserve(n_types);
+    for(size_t i = 0; i < n_types; i ++)
+        out_types.push_back( s.deserialise_type() );
+}
@@ -11,6 +11,26 @@
 {
 }
 
+namespace {
+    NodePool& expr_node_pool() {
+        // NOTE: Leaked to avoid issues with destruction order at exit
+        static NodePool* s_pool = new NodePool("HIR::ExprNode");
+        return *s_pool;
+    }
+}
+void* ::HIR::ExprNode::operator new(size_t size)
+{
+    return expr_node_pool().allocate(size);
+}
+void ::HIR::ExprNode::operator delete(void* ptr, size_t size)
+{
+    expr_node_pool().deallocate(ptr, size);
+}
+const NodePool& ::HIR::ExprNode::pool()
+{
+    return expr_node_pool();
+}
+
 #define DEF_VISIT(nt, n, code)   void ::HIR::nt::visit(ExprVisitor& nv) { nv.visit_node(*this); nv.visit(*this); } void ::HIR::ExprVisitorDef::visit(::HIR::nt& n) { code }
 
 void ::HIR::ExprVisitor::visit_node_ptr(::std::unique_ptr< ::HIR::ExprNode>& node_ptr) {
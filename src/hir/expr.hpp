@@ -6,6 +6,7 @@
 #include <hir/pattern.hpp>
 #include <hir/type.hpp>
 #include <span.hpp>
+#include <node_pool.hpp>
 #include <hir/visitor.hpp>
 
 namespace HIR {
@@ -56,6 +57,11 @@ public:
         m_res_type( mv$(ty) )
     {}
     virtual ~ExprNode();
+
+    // Nodes are allocated from a pool (see node_pool.hpp)
+    static void* operator new(size_t size);
+    static void operator delete(void* ptr, size_t size);
+    static const NodePool& pool();
 };
 
 typedef ::std::unique_ptr<ExprNode> ExprNodeP;
@@ -123,7 +123,7 @@
 
 ::HIR::Pattern LowerHIR_Pattern(const ::AST::Pattern& pat)
 {
-    TRACE_FUNCTION_F("@" << pat.span().filename << ":" << pat.span().start_line << " pat = " << pat);
+    TRACE_FUNCTION_F("@" << pat.span() << " pat = " << pat);
 
     ::HIR::PatternBinding   binding;
     if( pat.binding().is_valid() )
@@ -829,7 +829,7 @@ namespace {
     }
 }
 
-::HIR::Struct LowerHIR_Struct(::HIR::ItemPath path, const ::AST::Struct& ent)
+::HIR::Struct LowerHIR_Struct(::HIR::ItemPath path, const ::AST::Struct& ent, const ::AST::MetaItems& attrs)
 {
     TRACE_FUNCTION_F(path);
     ::HIR::Struct::Data data;
@@ -854,10 +854,30 @@ namespace {
         )
     )
 
+    auto repr = ::HIR::Struct::Repr::Rust;
+    if( const auto* attr_repr = attrs.get("repr") )
+    {
+        ASSERT_BUG(Span(), attr_repr->has_sub_items(), "#[repr] attribute malformed, " << *attr_repr);
+        for(const auto& a : attr_repr->items())
+        {
+            if( a.name() == "C" ) {
+                repr = ::HIR::Struct::Repr::C;
+            }
+            else if( a.name() == "packed" ) {
+                repr = ::HIR::Struct::Repr::Packed;
+            }
+            else if( a.name() == "simd" ) {
+                repr = ::HIR::Struct::Repr::Simd;
+            }
+            else {
+                // TODO: Error?
+            }
+        }
+    }
+
     return ::HIR::Struct {
         LowerHIR_GenericParams(ent.params(), nullptr),
-        // TODO: Get repr from attributes
-        ::HIR::Struct::Repr::Rust,
+        repr,
         mv$(data)
         };
 }
@@ -1093,10 +1113,23 @@ namespace {
     }
 
     bool force_emit = false;
+    auto inline_hint = ::HIR::Function::Inline::Auto;
     if( const auto* a = attrs.get("inline") )
     {
-        (void)a;
         force_emit = true;
+        inline_hint = ::HIR::Function::Inline::Hint;
+        if( a->has_sub_items() )
+        {
+            for(const auto& i : a->items())
+            {
+                if( i.name() == "always" )
+                    inline_hint = ::HIR::Function::Inline::Always;
+                else if( i.name() == "never" )
+                    inline_hint = ::HIR::Function::Inline::Never;
+                else
+                    ERROR(sp, E0000, "Unknown #[inline] option - " << i.name());
+            }
+        }
     }
 
     ::HIR::Linkage  linkage;
@@ -1139,7 +1172,9 @@ namespace {
         LowerHIR_GenericParams(f.params(), nullptr),    // TODO: If this is a method, then it can add the Self: Sized bound
         mv$(args), f.is_variadic(),
         LowerHIR_Type( f.rettype() ),
-        LowerHIR_Expr( f.code() )
+        LowerHIR_Expr( f.code() ),
+        inline_hint,
+        attrs.has("cold")
         };
 }
 
@@ -1249,7 +1284,7 @@ void _add_mod_val_item(::HIR::Module& mod, ::std::string name, bool is_pub,  ::H
             }
             else {
             }
-            _add_mod_ns_item( mod,  item.name, item.is_pub, LowerHIR_Struct(item_path, e) );
+            _add_mod_ns_item( mod,  item.name, item.is_pub, LowerHIR_Struct(item_path, e, item.data.attrs) );
             ),
         (Enum,
             _add_mod_ns_item( mod,  item.name, item.is_pub, LowerHIR_Enum(item_path, e) );
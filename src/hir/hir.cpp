@@ -24,6 +24,12 @@ namespace HIR {
                 os << " " << val << ",";
             os << " ]";
             ),
+        (Packed,
+            os << "[";
+            for(size_t i = 0; i < e.size(); i ++)
+                os << " " << e.get(i) << ",";
+            os << " ]";
+            ),
         (Variant,
             os << "#" << e.idx << ":[";
             for(const auto& val : e.vals)
@@ -63,6 +69,9 @@ namespace HIR {
                 if( le[i] != re[i] )
                     return false;
             ),
+        (Packed,
+            return le.elem_size == re.elem_size && le.is_signed == re.is_signed && le.data == re.data;
+            ),
         (Variant,
             if( le.idx != re.idx )
                 return false;
@@ -90,6 +99,120 @@ namespace HIR {
         )
         return true;
     }
+
+    bool Literal::pack(unsigned int elem_size, bool is_signed)
+    {
+        assert(1 <= elem_size && elem_size <= 8);
+        if( !this->is_List() )
+            return false;
+        const auto& vals = this->as_List();
+        for(const auto& v : vals)
+            if( !v.is_Integer() )
+                return false;
+
+        ::std::vector<uint8_t>  data;
+        data.reserve(vals.size() * elem_size);
+        for(const auto& v : vals)
+        {
+            auto iv = v.as_Integer();
+            for(unsigned int i = 0; i < elem_size; i ++)
+                data.push_back( static_cast<uint8_t>(iv >> (i * 8)) );
+        }
+        *this = Literal::make_Packed({ elem_size, is_signed, mv$(data) });
+        return true;
+    }
+    void Literal::unpack()
+    {
+        if( !this->is_Packed() )
+            return ;
+        const auto& pe = this->as_Packed();
+        ::std::vector<Literal>  vals;
+        vals.reserve(pe.size());
+        for(size_t i = 0; i < pe.size(); i ++)
+            vals.push_back( Literal(pe.get(i)) );
+        *this = Literal::make_List( mv$(vals) );
+    }
+    void Literal::pack_arrays(const ::HIR::TypeRef& ty)
+    {
+        auto pack_list = [&](const ::HIR::TypeRef& inner_ty) {
+            if( !this->is_List() )
+                return ;
+            for(auto& v : this->as_List())
+                v.pack_arrays(inner_ty);
+            unsigned int elem_size = 0;
+            bool is_signed = false;
+            if( inner_ty.m_data.is_Primitive() )
+            {
+                switch( inner_ty.m_data.as_Primitive() )
+                {
+                case ::HIR::CoreType::U8:  case ::HIR::CoreType::Bool:
+                    elem_size = 1;  break;
+                case ::HIR::CoreType::I8:
+                    elem_size = 1;  is_signed = true;   break;
+                case ::HIR::CoreType::U16:
+                    elem_size = 2;  break;
+                case ::HIR::CoreType::I16:
+                    elem_size = 2;  is_signed = true;   break;
+                case ::HIR::CoreType::U32: case ::HIR::CoreType::Char:
+                    elem_size = 4;  break;
+                case ::HIR::CoreType::I32:
+                    elem_size = 4;  is_signed = true;   break;
+                case ::HIR::CoreType::U64: case ::HIR::CoreType::Usize:
+                    elem_size = 8;  break;
+                case ::HIR::CoreType::I64: case ::HIR::CoreType::Isize:
+                    elem_size = 8;  is_signed = true;   break;
+                default:
+                    break;
+                }
+            }
+            if( elem_size > 0 )
+                this->pack(elem_size, is_signed);
+            };
+        TU_MATCH_DEF(::HIR::TypeRef::Data, (ty.m_data), (te),
+        (
+            ),
+        (Array,
+            pack_list(*te.inner);
+            ),
+        (Slice,
+            pack_list(*te.inner);
+            ),
+        (Tuple,
+            if( this->is_List() && this->as_List().size() == te.size() )
+            {
+                for(unsigned int i = 0; i < te.size(); i ++)
+                    this->as_List()[i].pack_arrays(te[i]);
+            }
+            ),
+        (Borrow,
+            if( this->is_BorrowData() )
+                this->as_BorrowData()->pack_arrays(*te.inner);
+            ),
+        (Path,
+            // Struct fields (only when their types don't depend on the struct's parameters)
+            if( te.binding.is_Struct() && this->is_List() )
+            {
+                auto& vals = this->as_List();
+                auto visit_field = [&](unsigned int i, const ::HIR::TypeRef& fld_ty) {
+                    if( i < vals.size() && !monomorphise_type_needed(fld_ty) )
+                        vals[i].pack_arrays(fld_ty);
+                    };
+                TU_MATCHA( (te.binding.as_Struct()->m_data), (se),
+                (Unit,
+                    ),
+                (Tuple,
+                    for(unsigned int i = 0; i < se.size(); i ++)
+                        visit_field(i, se[i].ent);
+                    ),
+                (Named,
+                    for(unsigned int i = 0; i < se.size(); i ++)
+                        visit_field(i, se[i].second.ent);
+                    )
+                )
+            }
+            )
+        )
+    }
 }
 
 const ::HIR::Enum::Variant* ::HIR::Enum::get_variant(const ::std::string& name) const
@@ -1258,14 +1381,100 @@ bool ::HIR::Crate::find_auto_trait_impls(const ::HIR::SimplePath& trait, const :
     }
     return false;
 }
+namespace {
+    /// Outer shape of a type for `Crate::find_type_impls`, false if the type could match any impl
+    bool get_type_impl_key(const ::HIR::TypeRef& ty, const ::HIR::SimplePath*& out_path, unsigned& out_key)
+    {
+        out_path = nullptr;
+        out_key = static_cast<unsigned>(ty.m_data.tag());
+        TU_MATCH_DEF(::HIR::TypeRef::Data, (ty.m_data), (te),
+        (
+            ),
+        (Infer,
+            return false;
+            ),
+        (Generic,
+            return false;
+            ),
+        (Primitive,
+            out_key |= static_cast<unsigned>(te) << 8;
+            ),
+        (Path,
+            if( te.path.m_data.is_Generic() )
+                out_path = &te.path.m_data.as_Generic().m_path;
+            // Unexpanded associated types
+            else if( te.path.m_data.is_UfcsKnown() || te.binding.is_Unbound() )
+                return false;
+            )
+        )
+        return true;
+    }
+}
+
 bool ::HIR::Crate::find_type_impls(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TypeImpl&)> callback) const
 {
-    // TODO: Restrict which crate is searched based on the type.
-    for( const auto& impl : this->m_type_impls )
+    auto& index = m_type_impl_index;
+    if( index.impl_count != m_type_impls.size() )
     {
-        if( impl.matches_type(type, ty_res) ) {
-            if( callback(impl) ) {
-                return true;
+        index = TypeImplIndex();
+        index.impl_count = m_type_impls.size();
+        for(unsigned int i = 0; i < m_type_impls.size(); i ++)
+        {
+            const ::HIR::SimplePath* path;
+            unsigned key;
+            if( !get_type_impl_key(m_type_impls[i].m_type, path, key) )
+                index.wildcard.push_back(i);
+            else if( path )
+                index.named[*path].push_back(i);
+            else
+                index.unnamed[key].push_back(i);
+        }
+    }
+
+    // Only search impls with the same outer type (keeping the declaration order)
+    const ::std::vector<unsigned>*  bucket = nullptr;
+    const auto& top_ty = (type.m_data.is_Infer() || type.m_data.is_Generic() ? ty_res(type) : type);
+    const ::HIR::SimplePath* path;
+    unsigned key;
+    if( get_type_impl_key(top_ty, path, key) )
+    {
+        static const ::std::vector<unsigned>  empty;
+        if( path ) {
+            auto it = index.named.find(*path);
+            bucket = (it != index.named.end() ? &it->second : &empty);
+        }
+        else {
+            auto it = index.unnamed.find(key);
+            bucket = (it != index.unnamed.end() ? &it->second : &empty);
+        }
+    }
+    if( bucket )
+    {
+        auto it_b = bucket->begin();
+        auto it_w = index.wildcard.begin();
+        while( it_b != bucket->end() || it_w != index.wildcard.end() )
+        {
+            unsigned idx;
+            if( it_w == index.wildcard.end() || (it_b != bucket->end() && *it_b < *it_w) )
+                idx = *it_b++;
+            else
+                idx = *it_w++;
+            const auto& impl = m_type_impls[idx];
+            if( impl.matches_type(type, ty_res) ) {
+                if( callback(impl) ) {
+                    return true;
+                }
+            }
+        }
+    }
+    else
+    {
+        for( const auto& impl : this->m_type_impls )
+        {
+            if( impl.matches_type(type, ty_res) ) {
+                if( callback(impl) ) {
+                    return true;
+                }
             }
         }
     }
@@ -47,10 +47,27 @@ struct VisEnt
 
 /// Literal type used for constant evaluation
 /// NOTE: Intentionally minimal, just covers the values (not the types)
-TAGGED_UNION(Literal, Invalid,
+TAGGED_UNION_EX(Literal, (), Invalid, (
     (Invalid, struct {}),
     // List = Array, Tuple, struct literal
     (List, ::std::vector<Literal>), // TODO: Have a variant for repetition lists
+    // Packed = Array of integers, stored as `elem_size`-byte little-endian values
+    (Packed, struct {
+        unsigned int    elem_size;
+        // Entries are sign-extended when read (matching how `Integer` stores signed values)
+        bool    is_signed;
+        ::std::vector<uint8_t>  data;
+
+        size_t size() const { return data.size() / elem_size; }
+        uint64_t get(size_t idx) const {
+            uint64_t rv = 0;
+            for(unsigned int i = 0; i < elem_size; i ++)
+                rv |= static_cast<uint64_t>(data[idx * elem_size + i]) << (i * 8);
+            if( is_signed && elem_size < 8 && (rv >> (elem_size * 8 - 1)) != 0 )
+                rv |= ~uint64_t(0) << (elem_size * 8);
+            return rv;
+        }
+        }),
     // Variant = Enum variant
     (Variant, struct {
         unsigned int    idx;
@@ -65,6 +82,14 @@ TAGGED_UNION(Literal, Invalid,
     (BorrowData, ::std::unique_ptr<Literal>),
     // String = &'static str or &[u8; N]
     (String, ::std::string)
+    ), (), (), (
+        /// Convert a `List` of only `Integer`s into `Packed` (returns false and leaves it unchanged otherwise)
+        bool pack(unsigned int elem_size, bool is_signed);
+        /// Convert a `Packed` back into a `List` (before modifying individual entries)
+        void unpack();
+        /// Pack every integer array within this literal (entry sizes from `ty`)
+        void pack_arrays(const ::HIR::TypeRef& ty);
+    )
     );
 extern ::std::ostream& operator<<(::std::ostream& os, const Literal& v);
 extern bool operator==(const Literal& l, const Literal& r);
@@ -123,6 +148,12 @@ public:
         //PointerConst,
         Box,
     };
+    enum class Inline {
+        Auto,   // No attribute
+        Hint,   // #[inline]
+        Always, // #[inline(always)]
+        Never,  // #[inline(never)]
+    };
 
     typedef ::std::vector< ::std::pair< ::HIR::Pattern, ::HIR::TypeRef> >   args_t;
 
@@ -142,6 +173,10 @@ public:
 
     ExprPtr m_code;
 
+    // Code generation hints
+    Inline  m_inline = Inline::Auto;
+    bool    m_cold = false; // #[cold]
+
     //::HIR::TypeRef make_ty(const Span& sp, const ::HIR::PathParams& params) const;
 };
 
@@ -208,6 +243,9 @@ struct StructMarkings
     unsigned int coerce_unsized_index = ~0u;
     // Index of the parameter that controls the CoerceUnsized (either a T: ?Sized, or a T: CoerceUnsized)
     unsigned int coerce_param = ~0u;
+
+    /// This is a trait's vtable (created by HIR_Expand_VTables, codegen inserts a size/align header)
+    bool    is_vtable = false;
 };
 
 class Enum
@@ -250,6 +288,7 @@ public:
         Rust,
         C,
         Packed,
+        Simd,
         //Union,
     };
     TAGGED_UNION(Data, Unit,
@@ -468,6 +507,13 @@ public:
     ::std::unordered_map< ::std::string, ExternCrate>  m_ext_crates;
     ::std::vector<ExternLibrary>    m_ext_libs;
     ::std::vector<::std::string>    m_link_paths;
+    /// Mangled names of the vtables and drop glue defined (as weak symbols) by this crate's object
+    /// - Downstream crates link to these instead of emitting their own copy
+    ::std::vector<::std::string>    m_exported_glue;
+    /// Mangled names of the monomorphised functions (generic instances, and functions with saved
+    /// MIR) defined with external linkage by this crate's object
+    /// - Downstream crates link to these instead of monomorphising them again
+    ::std::vector<::std::string>    m_exported_instances;
 
     /// Method called to populate runtime state after deserialisation
     /// See hir/crate_post_load.cpp
@@ -507,6 +553,20 @@ public:
     bool find_trait_impls(const ::HIR::SimplePath& path, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TraitImpl&)> callback) const;
     bool find_auto_trait_impls(const ::HIR::SimplePath& path, const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::MarkerImpl&)> callback) const;
     bool find_type_impls(const ::HIR::TypeRef& type, t_cb_resolve_type ty_res, ::std::function<bool(const ::HIR::TypeImpl&)> callback) const;
+
+private:
+    /// Indexes into `m_type_impls`, grouped by the outer shape of the impl type (built on first use by `find_type_impls`)
+    struct TypeImplIndex
+    {
+        /// Size of `m_type_impls` when the index was built
+        size_t  impl_count = 0;
+        ::std::map< ::HIR::SimplePath, ::std::vector<unsigned> >    named;
+        /// Other types, keyed on the type tag (and the primitive type)
+        ::std::map< unsigned, ::std::vector<unsigned> > unnamed;
+        /// Generic/unexpanded impl types, can match anything
+        ::std::vector<unsigned> wildcard;
+    };
+    mutable TypeImplIndex   m_type_impl_index;
 };
 
 }   // namespace HIR
@@ -10,12 +10,27 @@
 #include "crate_ptr.hpp"
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace AST {
     class Crate;
 }
+namespace HIR {
+    class Path;
+    class TypeRef;
+    namespace serialise {
+        class Writer;
+        class Reader;
+    }
+}
 
 extern void HIR_Dump(::std::ostream& sink, const ::HIR::Crate& crate);
 extern ::HIR::CratePtr  LowerHIR_FromAST(::AST::Crate crate);
 extern void HIR_Serialise(const ::std::string& filename, const ::HIR::Crate& crate);
 extern ::HIR::CratePtr HIR_Deserialise(const ::std::string& filename, const ::std::string& loaded_name);
+/// Read only the crate name and the (name, filename) list of crates it references
+extern ::std::string HIR_Deserialise_Header(const ::std::string& filename, ::std::vector< ::std::pair< ::std::string, ::std::string> >& out_ext_crates);
+/// Write standalone lists of paths and types (for caches kept next to an output), deduplicated as in .hir files
+extern void HIR_Serialise_PathsTypes(::HIR::serialise::Writer& out, const ::std::vector<const ::HIR::Path*>& paths, const ::std::vector<const ::HIR::TypeRef*>& types);
+/// Read lists written by `HIR_Serialise_PathsTypes` (types are left unbound, see `ConvertHIR_Bind_Type`)
+extern void HIR_Deserialise_PathsTypes(::HIR::serialise::Reader& in, ::std::vector< ::HIR::Path>& out_paths, ::std::vector< ::HIR::TypeRef>& out_types);
@@ -11,11 +11,26 @@
 #include <macro_rules/macro_rules.hpp>
 #include <mir/mir.hpp>
 #include "serialise_lowlevel.hpp"
+#include <hir_typeck/common.hpp>    // visit_ty_with
+#include <algorithm>
 
 namespace {
     class HirSerialiser
     {
         ::HIR::serialise::Writer&   m_out;
+
+        // Deduplication tables
+        // - The first occurrence of a path/type is written inline (after a `0` marker) and is given the next index,
+        //   later occurrences are written as just `index+1`. The deserialiser builds the same tables as it reads.
+        ::std::map< ::HIR::SimplePath, unsigned int>    m_simplepaths;
+        unsigned int    m_simplepath_count = 0;
+        ::std::map< ::HIR::GenericPath, unsigned int>   m_genericpaths;
+        unsigned int    m_genericpath_count = 0;
+        ::std::map< ::HIR::TypeRef, unsigned int>   m_types;
+        unsigned int    m_type_count = 0;
+
+        // Function bodies to be written to the MIR section (in order)
+        ::std::vector<const ::MIR::Function*>   m_mir_section;
     public:
         HirSerialiser(::HIR::serialise::Writer& out):
             m_out( out )
@@ -81,7 +96,35 @@ namespace {
         //    m_out.write_count(val);
         //}
 
+        /// Returns true if `TypeRef::ord` distinguishes every serialised field of this type
+        /// - Erased types (`m_index`) and inherent UFCS paths (`impl_params`) have fields that `ord` ignores
+        static bool type_can_dedup(const ::HIR::TypeRef& ty)
+        {
+            return !visit_ty_with(ty, [](const ::HIR::TypeRef& t) {
+                if( t.m_data.is_ErasedType() )
+                    return true;
+                if( t.m_data.is_Path() && t.m_data.as_Path().path.m_data.is_UfcsInherent() )
+                    return true;
+                return false;
+                });
+        }
+
+        // NOTE: Lookups don't need the `*_can_dedup` check, an `ord`-equal entry would contain the same non-dedupable
+        // parts (so would never have been inserted)
         void serialise_type(const ::HIR::TypeRef& ty)
+        {
+            auto it = m_types.find(ty);
+            if( it != m_types.end() ) {
+                m_out.write_u64c(it->second + 1);
+                return ;
+            }
+            m_out.write_u64c(0);
+            serialise_type_inner(ty);
+            auto idx = m_type_count ++;
+            if( type_can_dedup(ty) )
+                m_types.insert( ::std::make_pair(ty.clone(), idx) );
+        }
+        void serialise_type_inner(const ::HIR::TypeRef& ty)
         {
             m_out.write_tag( ty.m_data.tag() );
             TU_MATCHA( (ty.m_data), (e),
@@ -151,8 +194,15 @@ namespace {
         void serialise_simplepath(const ::HIR::SimplePath& path)
         {
             DEBUG(path);
+            auto it = m_simplepaths.find(path);
+            if( it != m_simplepaths.end() ) {
+                m_out.write_u64c(it->second + 1);
+                return ;
+            }
+            m_out.write_u64c(0);
             m_out.write_string(path.m_crate_name);
             serialise_vec(path.m_components);
+            m_simplepaths.insert( ::std::make_pair(path, m_simplepath_count++) );
         }
         void serialise_pathparams(const ::HIR::PathParams& pp)
         {
@@ -163,8 +213,17 @@ namespace {
         void serialise_genericpath(const ::HIR::GenericPath& path)
         {
             TRACE_FUNCTION_F(path);
+            auto it = m_genericpaths.find(path);
+            if( it != m_genericpaths.end() ) {
+                m_out.write_u64c(it->second + 1);
+                return ;
+            }
+            m_out.write_u64c(0);
             serialise_simplepath(path.m_path);
             serialise_pathparams(path.m_params);
+            auto idx = m_genericpath_count ++;
+            if( ::std::all_of(path.m_params.m_types.begin(), path.m_params.m_types.end(), type_can_dedup) )
+                m_genericpaths.insert( ::std::make_pair(path.clone(), idx) );
         }
         void serialise(const ::HIR::GenericPath& path) { serialise_genericpath(path); }
         void serialise_traitpath(const ::HIR::TraitPath& path)
@@ -240,6 +299,13 @@ namespace {
         void serialise_crate(const ::HIR::Crate& crate)
         {
             m_out.write_string(crate.m_crate_name);
+            // NOTE: Referenced crates are part of the header (read by `HIR_Deserialise_Header` before loading)
+            m_out.write_count(crate.m_ext_crates.size());
+            for(const auto& ext : crate.m_ext_crates)
+            {
+                m_out.write_string(ext.first);
+                m_out.write_string(ext.second.m_basename);
+            }
             serialise_module(crate.m_root_module);
 
             m_out.write_count(crate.m_type_impls.size());
@@ -260,14 +326,10 @@ namespace {
             serialise_strmap(crate.m_exported_macros);
             serialise_strmap(crate.m_lang_items);
 
-            m_out.write_count(crate.m_ext_crates.size());
-            for(const auto& ext : crate.m_ext_crates)
-            {
-                m_out.write_string(ext.first);
-                m_out.write_string(ext.second.m_basename);
-            }
             serialise_vec(crate.m_ext_libs);
             serialise_vec(crate.m_link_paths);
+            serialise_vec(crate.m_exported_glue);
+            serialise_vec(crate.m_exported_instances);
         }
         void serialise(const ::HIR::ExternLibrary& lib)
         {
@@ -434,6 +496,12 @@ namespace {
             (List,
                 serialise_vec(e);
                 ),
+            (Packed,
+                // Entry size, with the top bit set for signed entries
+                m_out.write_u8(static_cast<uint8_t>(e.elem_size | (e.is_signed ? 0x80 : 0)));
+                m_out.write_u64c(e.data.size());
+                m_out.write(e.data.data(), e.data.size());
+                ),
             (Variant,
                 m_out.write_count(e.idx);
                 serialise_vec(e.vals);
@@ -456,14 +524,30 @@ namespace {
             )
         }
 
-        void serialise(const ::HIR::ExprPtr& exp, bool save_mir=true)
+        /// `in_mir_section` defers the MIR to the separate MIR section (only read by crates that use the function)
+        void serialise(const ::HIR::ExprPtr& exp, bool save_mir=true, bool in_mir_section=false)
         {
-            m_out.write_bool( (bool)exp.m_mir && save_mir );
-            if( exp.m_mir && save_mir ) {
+            // 0 = No MIR, 1 = MIR follows, 2 = MIR is the next entry in the MIR section
+            if( !exp.m_mir || !save_mir ) {
+                m_out.write_tag(0);
+            }
+            else if( in_mir_section ) {
+                m_out.write_tag(2);
+                m_mir_section.push_back( &*exp.m_mir );
+            }
+            else {
+                m_out.write_tag(1);
                 serialise(*exp.m_mir);
             }
             serialise_vec( exp.m_erased_types );
         }
+        const ::std::vector<const ::MIR::Function*>& mir_section() const { return m_mir_section; }
+        void serialise_mir_section(const ::std::vector<const ::MIR::Function*>& fcns)
+        {
+            m_out.write_u64c(fcns.size());
+            for(const auto* fcn : fcns)
+                serialise(*fcn);
+        }
         void serialise(const ::MIR::Function& mir)
         {
             // Write out MIR.
@@ -820,7 +904,12 @@ namespace {
             serialise(fcn.m_return);
             DEBUG("m_args = " << fcn.m_args);
 
-            serialise(fcn.m_code, fcn.m_save_code || fcn.m_const);
+            // `const fn` bodies are needed by constant evaluation (so are always loaded), others are only needed
+            // when the function is monomorphised/inlined
+            serialise(fcn.m_code, fcn.m_save_code || fcn.m_const, !fcn.m_const);
+
+            m_out.write_tag( static_cast<int>(fcn.m_inline) );
+            m_out.write_bool(fcn.m_cold);
         }
         void serialise(const ::HIR::Constant& item)
         {
@@ -894,6 +983,7 @@ namespace {
             uint8_t bitflag_1 = 0;
             #define BIT(i,fld)  if(fld) bitflag_1 |= 1 << (i);
             BIT(0, m.can_unsize)
+            BIT(1, m.is_vtable)
             #undef BIT
             m_out.write_u8(bitflag_1);
 
@@ -984,5 +1074,20 @@ void HIR_Serialise(const ::std::string& filename, const ::HIR::Crate& crate)
     ::HIR::serialise::Writer    out { filename };
     HirSerialiser  s { out };
     s.serialise_crate(crate);
+
+    // MIR of generic functions goes in a separate file, read on first use by downstream crates
+    ::HIR::serialise::Writer    mir_out { filename + ".mir" };
+    HirSerialiser  ms { mir_out };
+    ms.serialise_mir_section(s.mir_section());
 }
 
+void HIR_Serialise_PathsTypes(::HIR::serialise::Writer& out, const ::std::vector<const ::HIR::Path*>& paths, const ::std::vector<const ::HIR::TypeRef*>& types)
+{
+    HirSerialiser  s { out };
+    out.write_u64c(paths.size());
+    for(const auto* p : paths)
+        s.serialise_path(*p);
+    out.write_u64c(types.size());
+    for(const auto* t : types)
+        s.serialise_type(*t);
+}
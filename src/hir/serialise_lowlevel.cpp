@@ -10,22 +10,182 @@
 #include <fstream>
 #include <string.h>   // memcpy
 #include <common.hpp>
+#include <deque>
+#include <future>
+#include <thread>
+#include <atomic>
 
 namespace HIR {
 namespace serialise {
 
+namespace {
+    // File layout: MAGIC, then chunks of `[codec:u8] [raw_len:u32] [data_len:u32] data`, ending with a zero-length chunk.
+    // - Chunks are compressed independently, so they can be (de)compressed in parallel
+    const char  MAGIC[4] = { 'M', 'R', 'H', 'Z' };
+    const size_t    CHUNK_SIZE = 512*1024;
+    const size_t    CHUNK_HEADER_SIZE = 1+4+4;
+
+    CompressionOptions  s_compression;
+
+    struct Chunk
+    {
+        Codec   codec;
+        uint32_t    raw_len;
+        ::std::vector<unsigned char>    data;
+    };
+
+    // Maximum number of chunks in flight (compressing/decompressing) at one time
+    size_t max_pending_chunks()
+    {
+        return ::std::max(1u, ::std::thread::hardware_concurrency());
+    }
+    // Threads that can still be started (the main thread counts against the limit)
+    ::std::atomic<int>& free_workers()
+    {
+        static ::std::atomic<int>   s_free_workers { static_cast<int>(::std::max(1u, ::std::thread::hardware_concurrency())) - 1 };
+        return s_free_workers;
+    }
+    // Start `fcn` on a new thread if the budget allows, otherwise defer it until the result is requested
+    template<typename Fcn>
+    auto start_task(Fcn fcn) -> ::std::future<decltype(fcn())>
+    {
+        if( try_acquire_worker() )
+        {
+            return ::std::async(::std::launch::async, [fcn=mv$(fcn)]() mutable {
+                struct Release { ~Release() { release_worker(); } } release;
+                return fcn();
+                });
+        }
+        else
+        {
+            return ::std::async(::std::launch::deferred, mv$(fcn));
+        }
+    }
+
+    Chunk compress_chunk(const CompressionOptions& opts, ::std::vector<unsigned char> raw)
+    {
+        Chunk   rv;
+        rv.raw_len = static_cast<uint32_t>(raw.size());
+        if( opts.codec == Codec::Deflate )
+        {
+            uLongf  len = compressBound(raw.size());
+            rv.data.resize(len);
+            int ret = compress2(rv.data.data(), &len, raw.data(), raw.size(), opts.level);
+            if(ret != Z_OK)
+                throw ::std::runtime_error("zlib compress failure");
+            // Chunks that don't compress are stored raw
+            if( len < raw.size() )
+            {
+                rv.codec = Codec::Deflate;
+                rv.data.resize(len);
+                return rv;
+            }
+        }
+        rv.codec = Codec::None;
+        rv.data = mv$(raw);
+        return rv;
+    }
+    ::std::vector<unsigned char> decompress_chunk(Chunk c)
+    {
+        switch(c.codec)
+        {
+        case Codec::None:
+            if( c.data.size() != c.raw_len )
+                throw ::std::runtime_error("Stored chunk size mismatch");
+            return mv$(c.data);
+        case Codec::Deflate: {
+            ::std::vector<unsigned char>    rv(c.raw_len);
+            uLongf  len = rv.size();
+            int ret = uncompress(rv.data(), &len, c.data.data(), c.data.size());
+            if(ret != Z_OK || len != rv.size())
+                throw ::std::runtime_error("zlib inflate error");
+            return rv;
+            }
+        }
+        throw ::std::runtime_error("Unknown chunk codec");
+    }
+
+    void put_u32(unsigned char* dst, uint32_t v)
+    {
+        dst[0] = static_cast<unsigned char>(v);
+        dst[1] = static_cast<unsigned char>(v >> 8);
+        dst[2] = static_cast<unsigned char>(v >> 16);
+        dst[3] = static_cast<unsigned char>(v >> 24);
+    }
+    uint32_t get_u32(const unsigned char* src)
+    {
+        return static_cast<uint32_t>(src[0])
+            | (static_cast<uint32_t>(src[1]) << 8)
+            | (static_cast<uint32_t>(src[2]) << 16)
+            | (static_cast<uint32_t>(src[3]) << 24)
+            ;
+    }
+}
+
+bool try_acquire_worker()
+{
+    auto& free = free_workers();
+    int cur = free.load();
+    while( cur > 0 )
+    {
+        if( free.compare_exchange_weak(cur, cur - 1) )
+            return true;
+    }
+    return false;
+}
+void release_worker()
+{
+    free_workers() ++;
+}
+
+void set_compression(const CompressionOptions& opts)
+{
+    s_compression = opts;
+}
+bool parse_compression(const ::std::string& spec, CompressionOptions& out)
+{
+    if( spec == "none" ) {
+        out.codec = Codec::None;
+    }
+    else if( spec == "fast" ) {
+        out.codec = Codec::Deflate;
+        out.level = Z_BEST_SPEED;
+    }
+    else if( spec == "best" ) {
+        out.codec = Codec::Deflate;
+        out.level = Z_BEST_COMPRESSION;
+    }
+    else if( spec == "deflate" ) {
+        out.codec = Codec::Deflate;
+        out.level = 6;
+    }
+    else if( spec.compare(0, 8, "deflate:") == 0 && spec.size() == 9 && '1' <= spec[8] && spec[8] <= '9' ) {
+        out.codec = Codec::Deflate;
+        out.level = spec[8] - '0';
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
 class WriterInner
 {
     ::std::ofstream m_backing;
-    z_stream    m_zstream;
+    CompressionOptions  m_opts;
+    // Uncompressed data for the next chunk
     ::std::vector<unsigned char> m_buffer;
 
-    unsigned int    m_byte_out_count = 0;
-    unsigned int    m_byte_in_count = 0;
+    // Chunks being compressed, written to the file in order
+    ::std::deque< ::std::future<Chunk> >    m_pending;
+    size_t  m_max_pending;
 public:
     WriterInner(const ::std::string& filename);
     ~WriterInner();
     void write(const void* buf, size_t len);
+private:
+    void submit_chunk();
+    void write_chunk(const Chunk& c);
 };
 
 Writer::Writer(const ::std::string& filename):
@@ -44,112 +204,91 @@ void Writer::write(const void* buf, size_t len)
 
 WriterInner::WriterInner(const ::std::string& filename):
     m_backing( filename, ::std::ios_base::out | ::std::ios_base::binary),
-    m_zstream(),
-    m_buffer( 16*1024 )
-    //m_buffer( 4*1024 )
+    m_opts( s_compression ),
+    m_max_pending( max_pending_chunks() )
 {
-    m_zstream.zalloc = Z_NULL;
-    m_zstream.zfree = Z_NULL;
-    m_zstream.opaque = Z_NULL;
-
-    const int COMPRESSION_LEVEL = Z_BEST_COMPRESSION;
-    int ret = deflateInit(&m_zstream, COMPRESSION_LEVEL);
-    if(ret != Z_OK)
-        throw ::std::runtime_error("zlib init failure");
-
-    m_zstream.avail_out = m_buffer.size();
-    m_zstream.next_out = m_buffer.data();
+    if( !m_backing.is_open() )
+        throw ::std::runtime_error("Unable to open file");
+    m_backing.write(MAGIC, sizeof(MAGIC));
+    m_buffer.reserve(CHUNK_SIZE);
 }
 WriterInner::~WriterInner()
 {
-    assert( m_zstream.avail_in == 0 );
-
-    // Complete the compression
-    int ret;
-    do
+    try
     {
-        ret = deflate(&m_zstream, Z_FINISH);
-        if(ret == Z_STREAM_ERROR) {
-            ::std::cerr << "ERROR: zlib deflate stream error (cleanup)";
-            abort();
-        }
-        if( m_zstream.avail_out != m_buffer.size() )
+        if( !m_buffer.empty() )
+            submit_chunk();
+        while( !m_pending.empty() )
         {
-            size_t rem = m_buffer.size() - m_zstream.avail_out;
-            m_byte_out_count += rem;
-            m_backing.write( reinterpret_cast<char*>(m_buffer.data()), rem );
-
-            m_zstream.avail_out = m_buffer.size();
-            m_zstream.next_out = m_buffer.data();
+            write_chunk( m_pending.front().get() );
+            m_pending.pop_front();
         }
-    } while(ret == Z_OK);
-    deflateEnd(&m_zstream);
+        // Terminating empty chunk
+        write_chunk( Chunk { Codec::None, 0, {} } );
+    }
+    catch(const ::std::exception& e)
+    {
+        ::std::cerr << "ERROR: Metadata compression failed (cleanup): " << e.what() << ::std::endl;
+        abort();
+    }
 }
 
 void WriterInner::write(const void* buf, size_t len)
 {
-    m_zstream.avail_in = len;
-    m_zstream.next_in = reinterpret_cast<unsigned char*>( const_cast<void*>(buf) );
-
-    size_t last_avail_in = m_zstream.avail_in;
-
-    // While there's data to compress
-    while( m_zstream.avail_in > 0 )
+    const auto* src = reinterpret_cast<const unsigned char*>(buf);
+    while( len > 0 )
     {
-        assert(m_zstream.avail_out != 0);
-
-        // Compress the data
-        int ret = deflate(&m_zstream, Z_NO_FLUSH);
-        if(ret == Z_STREAM_ERROR)
-            throw ::std::runtime_error("zlib deflate stream error");
-
-        size_t used_this_time = last_avail_in - m_zstream.avail_in;
-        last_avail_in = m_zstream.avail_in;
-        m_byte_in_count += used_this_time;
-
-        // If the entire input wasn't consumed, then it was likely due to a lack of output space
-        // - Flush the output buffer to the file
-        if( m_zstream.avail_in > 0 )
-        {
-            size_t bytes = m_buffer.size() - m_zstream.avail_out;
-            m_backing.write( reinterpret_cast<char*>(m_buffer.data()), bytes );
-            m_byte_out_count += bytes;
-
-            m_zstream.avail_out = m_buffer.size();
-            m_zstream.next_out = m_buffer.data();
-        }
+        size_t n = ::std::min(len, CHUNK_SIZE - m_buffer.size());
+        m_buffer.insert(m_buffer.end(), src, src + n);
+        src += n;
+        len -= n;
+        if( m_buffer.size() == CHUNK_SIZE )
+            submit_chunk();
     }
+}
+void WriterInner::submit_chunk()
+{
+    // Without a free thread, the chunk is compressed on this thread when it's written
+    const auto& opts = m_opts;
+    m_pending.push_back( start_task([opts, raw=mv$(m_buffer)]() mutable { return compress_chunk(opts, mv$(raw)); }) );
+    m_buffer = ::std::vector<unsigned char>();
+    m_buffer.reserve(CHUNK_SIZE);
 
-    // Flush stream contents if the output buffer is full.
-    while( m_zstream.avail_out == 0 )
+    while( m_pending.size() > m_max_pending )
     {
-        size_t bytes = m_buffer.size() - m_zstream.avail_out;
-        m_backing.write( reinterpret_cast<char*>(m_buffer.data()), bytes );
-        m_byte_out_count += bytes;
-
-        m_zstream.avail_out = m_buffer.size();
-        m_zstream.next_out = m_buffer.data();
-
-        int ret = deflate(&m_zstream, Z_NO_FLUSH);
-        if(ret == Z_STREAM_ERROR)
-            throw ::std::runtime_error("zlib deflate stream error");
+        write_chunk( m_pending.front().get() );
+        m_pending.pop_front();
     }
 }
+void WriterInner::write_chunk(const Chunk& c)
+{
+    unsigned char   hdr[CHUNK_HEADER_SIZE];
+    hdr[0] = static_cast<unsigned char>(c.codec);
+    put_u32(hdr+1, c.raw_len);
+    put_u32(hdr+5, static_cast<uint32_t>(c.data.size()));
+    m_backing.write( reinterpret_cast<const char*>(hdr), sizeof(hdr) );
+    m_backing.write( reinterpret_cast<const char*>(c.data.data()), c.data.size() );
+}
 
 
 // --------------------------------------------------------------------
 class ReaderInner
 {
     ::std::ifstream m_backing;
-    z_stream    m_zstream;
-    ::std::vector<unsigned char> m_buffer;
+    bool    m_seen_end = false;
+
+    // Chunks read from the file and being decompressed (in file order)
+    ::std::deque< ::std::future< ::std::vector<unsigned char> > >    m_pending;
+    size_t  m_max_pending;
 
-    unsigned int    m_byte_out_count = 0;
-    unsigned int    m_byte_in_count = 0;
+    // Current decompressed chunk
+    ::std::vector<unsigned char>    m_chunk;
+    size_t  m_chunk_ofs = 0;
 public:
     ReaderInner(const ::std::string& filename);
-    ~ReaderInner();
     size_t read(void* buf, size_t len);
+private:
+    void queue_chunks();
 };
 
 
@@ -204,7 +343,9 @@ void Reader::read(void* buf, size_t len)
 
     if( len >= m_buffer.capacity() )
     {
-        m_inner->read(buf, len);
+        used = m_inner->read(buf, len);
+        if( used != len )
+            throw ::std::runtime_error( FMT("Reader::read - Requested " << len << " bytes, got " << used) );
     }
     else
     {
@@ -218,64 +359,63 @@ void Reader::read(void* buf, size_t len)
 
 ReaderInner::ReaderInner(const ::std::string& filename):
     m_backing(filename, ::std::ios_base::in|::std::ios_base::binary),
-    m_zstream(),
-    m_buffer(16*1024)
+    m_max_pending( max_pending_chunks() )
 {
     if( !m_backing.is_open() )
         throw ::std::runtime_error("Unable to open file");
 
-    m_zstream.zalloc = Z_NULL;
-    m_zstream.zfree = Z_NULL;
-    m_zstream.opaque = Z_NULL;
-
-    int ret = inflateInit(&m_zstream);
-    if(ret != Z_OK)
-        throw ::std::runtime_error("zlib init failure");
-
-    m_zstream.avail_in = 0;
+    char    magic[sizeof(MAGIC)];
+    m_backing.read(magic, sizeof(magic));
+    if( m_backing.gcount() != sizeof(magic) || memcmp(magic, MAGIC, sizeof(magic)) != 0 )
+        throw ::std::runtime_error("Not a metadata file, or from an incompatible version");
 }
-ReaderInner::~ReaderInner()
+void ReaderInner::queue_chunks()
 {
-    inflateEnd(&m_zstream);
+    while( !m_seen_end && m_pending.size() < m_max_pending )
+    {
+        unsigned char   hdr[CHUNK_HEADER_SIZE];
+        m_backing.read( reinterpret_cast<char*>(hdr), sizeof(hdr) );
+        if( m_backing.gcount() != sizeof(hdr) )
+            throw ::std::runtime_error("Truncated metadata (chunk header)");
+
+        Chunk   c;
+        c.codec = static_cast<Codec>(hdr[0]);
+        c.raw_len = get_u32(hdr+1);
+        c.data.resize( get_u32(hdr+5) );
+        if( c.raw_len == 0 ) {
+            m_seen_end = true;
+            break;
+        }
+        m_backing.read( reinterpret_cast<char*>(c.data.data()), c.data.size() );
+        if( static_cast<size_t>(m_backing.gcount()) != c.data.size() )
+            throw ::std::runtime_error("Truncated metadata (chunk data)");
+
+        m_pending.push_back( start_task([c=mv$(c)]() mutable { return decompress_chunk(mv$(c)); }) );
+    }
 }
 size_t ReaderInner::read(void* buf, size_t len)
 {
-    m_zstream.avail_out = len;
-    m_zstream.next_out = reinterpret_cast<unsigned char*>(buf);
-    do {
-        // Reset input buffer if empty
-        if( m_zstream.avail_in == 0 )
-        {
-            m_backing.read( reinterpret_cast<char*>(m_buffer.data()), m_buffer.size() );
-            m_zstream.avail_in = m_backing.gcount();
-            if( m_zstream.avail_in == 0 ) {
-                m_byte_out_count += len  - m_zstream.avail_out;
-                //::std::cerr << "Out of bytes, " << m_zstream.avail_out << " needed" << ::std::endl;
-                return len - m_zstream.avail_out;
-            }
-            m_zstream.next_in = const_cast<unsigned char*>(m_buffer.data());
-
-            m_byte_in_count += m_zstream.avail_in;
-        }
-
-        int ret = inflate(&m_zstream, Z_NO_FLUSH);
-        if(ret == Z_STREAM_ERROR)
-            throw ::std::runtime_error("zlib inflate stream error");
-        switch(ret)
+    auto* dst = reinterpret_cast<unsigned char*>(buf);
+    size_t  rv = 0;
+    while( rv < len )
+    {
+        if( m_chunk_ofs == m_chunk.size() )
         {
-        case Z_NEED_DICT:
-            ret = Z_DATA_ERROR;
-        case Z_DATA_ERROR:
-        case Z_MEM_ERROR:
-            throw ::std::runtime_error("zlib inflate error");
-        default:
-            break;
+            queue_chunks();
+            if( m_pending.empty() )
+                break;
+            m_chunk = m_pending.front().get();
+            m_pending.pop_front();
+            m_chunk_ofs = 0;
+            // Start on the next chunk while this one is consumed
+            queue_chunks();
         }
-
-    } while( m_zstream.avail_out > 0 );
-    m_byte_out_count += len;
-
-    return len;
+        size_t n = ::std::min(len - rv, m_chunk.size() - m_chunk_ofs);
+        memcpy(dst + rv, m_chunk.data() + m_chunk_ofs, n);
+        m_chunk_ofs += n;
+        rv += n;
+    }
+    return rv;
 }
 
 }   // namespace serialise
@@ -18,6 +18,29 @@ namespace serialise {
 class WriterInner;
 class ReaderInner;
 
+/// Codec used for the chunks of a metadata stream
+enum class Codec
+{
+    None,
+    Deflate,
+};
+struct CompressionOptions
+{
+    Codec   codec = Codec::Deflate;
+    /// zlib level, 1 (fastest) to 9 (smallest)
+    unsigned int    level = 6;
+};
+/// Set the options used by `Writer`s created after this call
+extern void set_compression(const CompressionOptions& opts);
+/// Parse a `-Z hir-compression=` value: `none`, `fast`, `best`, `deflate` or `deflate:<level>`
+extern bool parse_compression(const ::std::string& spec, CompressionOptions& out);
+
+/// Take a thread from the budget shared by all metadata loading/saving (returns false if none are free)
+/// - Crate loading and chunk (de)compression both draw from it, so nesting them doesn't multiply the thread count
+extern bool try_acquire_worker();
+/// Return a thread taken by `try_acquire_worker`
+extern void release_worker();
+
 class Writer
 {
     WriterInner*    m_inner;
@@ -118,6 +118,8 @@ namespace {
                     visit_literal(sp, val);
                 }
                 ),
+            (Packed,
+                ),
             (Variant,
                 for(auto& val : e.vals) {
                     visit_literal(sp, val);
@@ -502,40 +504,81 @@ namespace {
                 ExprVisitor v { *this };
                 (*expr).visit(v);
             }
-            else if( expr.m_mir )
+            else if( expr.m_mir && !expr.m_mir.is_pending() )
             {
-                struct H {
-                    static void visit_lvalue(Visitor& upper_visitor, ::MIR::LValue& lv)
-                    {
-                        TU_MATCHA( (lv), (e),
-                        (Return,
-                            ),
-                        (Local,
-                            ),
-                        (Argument,
-                            ),
-                        (Static,
-                            upper_visitor.visit_path(e, ::HIR::Visitor::PathContext::VALUE);
-                            ),
-                        (Field,
-                            H::visit_lvalue(upper_visitor, *e.val);
-                            ),
-                        (Deref,
-                            H::visit_lvalue(upper_visitor, *e.val);
-                            ),
-                        (Index,
-                            H::visit_lvalue(upper_visitor, *e.val);
-                            H::visit_lvalue(upper_visitor, *e.idx);
+                visit_mir(*expr.m_mir);
+            }
+            else
+            {
+                // Deferred MIR is bound as it is loaded (see ConvertHIR_Bind)
+            }
+        }
+
+        void visit_mir(::MIR::Function& fcn)
+        {
+            struct H {
+                static void visit_lvalue(Visitor& upper_visitor, ::MIR::LValue& lv)
+                {
+                    TU_MATCHA( (lv), (e),
+                    (Return,
+                        ),
+                    (Local,
+                        ),
+                    (Argument,
+                        ),
+                    (Static,
+                        upper_visitor.visit_path(e, ::HIR::Visitor::PathContext::VALUE);
+                        ),
+                    (Field,
+                        H::visit_lvalue(upper_visitor, *e.val);
+                        ),
+                    (Deref,
+                        H::visit_lvalue(upper_visitor, *e.val);
+                        ),
+                    (Index,
+                        H::visit_lvalue(upper_visitor, *e.val);
+                        H::visit_lvalue(upper_visitor, *e.idx);
+                        ),
+                    (Downcast,
+                        H::visit_lvalue(upper_visitor, *e.val);
+                        )
+                    )
+                }
+                static void visit_param(Visitor& upper_visitor, ::MIR::Param& p)
+                {
+                    TU_MATCHA( (p), (e),
+                    (LValue, H::visit_lvalue(upper_visitor, e);),
+                    (Constant,
+                        TU_MATCHA( (e), (ce),
+                        (Int, ),
+                        (Uint,),
+                        (Float, ),
+                        (Bool, ),
+                        (Bytes, ),
+                        (StaticString, ),  // String
+                        (Const,
+                            upper_visitor.visit_path(ce.p, ::HIR::Visitor::PathContext::VALUE);
                             ),
-                        (Downcast,
-                            H::visit_lvalue(upper_visitor, *e.val);
+                        (ItemAddr,
+                            upper_visitor.visit_path(ce, ::HIR::Visitor::PathContext::VALUE);
                             )
                         )
-                    }
-                    static void visit_param(Visitor& upper_visitor, ::MIR::Param& p)
-                    {
-                        TU_MATCHA( (p), (e),
-                        (LValue, H::visit_lvalue(upper_visitor, e);),
+                        )
+                    )
+                }
+            };
+            for(auto& ty : fcn.locals)
+                this->visit_type(ty);
+            for(auto& block : fcn.blocks)
+            {
+                for(auto& stmt : block.statements)
+                {
+                    TU_IFLET(::MIR::Statement, stmt, Assign, se,
+                        H::visit_lvalue(*this, se.dst);
+                        TU_MATCHA( (se.src), (e),
+                        (Use,
+                            H::visit_lvalue(*this, e);
+                            ),
                         (Constant,
                             TU_MATCHA( (e), (ce),
                             (Int, ),
@@ -545,130 +588,95 @@ namespace {
                             (Bytes, ),
                             (StaticString, ),  // String
                             (Const,
-                                upper_visitor.visit_path(ce.p, ::HIR::Visitor::PathContext::VALUE);
+                                this->visit_path(ce.p, ::HIR::Visitor::PathContext::VALUE);
                                 ),
                             (ItemAddr,
-                                upper_visitor.visit_path(ce, ::HIR::Visitor::PathContext::VALUE);
+                                this->visit_path(ce, ::HIR::Visitor::PathContext::VALUE);
                                 )
                             )
+                            ),
+                        (SizedArray,
+                            H::visit_param(*this, e.val);
+                            ),
+                        (Borrow,
+                            H::visit_lvalue(*this, e.val);
+                            ),
+                        (Cast,
+                            H::visit_lvalue(*this, e.val);
+                            this->visit_type(e.type);
+                            ),
+                        (BinOp,
+                            H::visit_param(*this, e.val_l);
+                            H::visit_param(*this, e.val_r);
+                            ),
+                        (UniOp,
+                            H::visit_lvalue(*this, e.val);
+                            ),
+                        (DstMeta,
+                            H::visit_lvalue(*this, e.val);
+                            ),
+                        (DstPtr,
+                            H::visit_lvalue(*this, e.val);
+                            ),
+                        (MakeDst,
+                            H::visit_param(*this, e.ptr_val);
+                            H::visit_param(*this, e.meta_val);
+                            ),
+                        (Tuple,
+                            for(auto& val : e.vals)
+                                H::visit_param(*this, val);
+                            ),
+                        (Array,
+                            for(auto& val : e.vals)
+                                H::visit_param(*this, val);
+                            ),
+                        (Variant,
+                            H::visit_param(*this, e.val);
+                            ),
+                        (Struct,
+                            for(auto& val : e.vals)
+                                H::visit_param(*this, val);
                             )
                         )
+                    )
+                    else TU_IFLET(::MIR::Statement, stmt, Drop, se,
+                        H::visit_lvalue(*this, se.slot);
+                    )
+                    else {
                     }
-                };
-                for(auto& ty : expr.m_mir->locals)
-                    this->visit_type(ty);
-                for(auto& block : expr.m_mir->blocks)
-                {
-                    for(auto& stmt : block.statements)
-                    {
-                        TU_IFLET(::MIR::Statement, stmt, Assign, se,
-                            H::visit_lvalue(*this, se.dst);
-                            TU_MATCHA( (se.src), (e),
-                            (Use,
-                                H::visit_lvalue(*this, e);
-                                ),
-                            (Constant,
-                                TU_MATCHA( (e), (ce),
-                                (Int, ),
-                                (Uint,),
-                                (Float, ),
-                                (Bool, ),
-                                (Bytes, ),
-                                (StaticString, ),  // String
-                                (Const,
-                                    this->visit_path(ce.p, ::HIR::Visitor::PathContext::VALUE);
-                                    ),
-                                (ItemAddr,
-                                    this->visit_path(ce, ::HIR::Visitor::PathContext::VALUE);
-                                    )
-                                )
-                                ),
-                            (SizedArray,
-                                H::visit_param(*this, e.val);
-                                ),
-                            (Borrow,
-                                H::visit_lvalue(*this, e.val);
-                                ),
-                            (Cast,
-                                H::visit_lvalue(*this, e.val);
-                                this->visit_type(e.type);
-                                ),
-                            (BinOp,
-                                H::visit_param(*this, e.val_l);
-                                H::visit_param(*this, e.val_r);
-                                ),
-                            (UniOp,
-                                H::visit_lvalue(*this, e.val);
-                                ),
-                            (DstMeta,
-                                H::visit_lvalue(*this, e.val);
-                                ),
-                            (DstPtr,
-                                H::visit_lvalue(*this, e.val);
-                                ),
-                            (MakeDst,
-                                H::visit_param(*this, e.ptr_val);
-                                H::visit_param(*this, e.meta_val);
-                                ),
-                            (Tuple,
-                                for(auto& val : e.vals)
-                                    H::visit_param(*this, val);
-                                ),
-                            (Array,
-                                for(auto& val : e.vals)
-                                    H::visit_param(*this, val);
-                                ),
-                            (Variant,
-                                H::visit_param(*this, e.val);
-                                ),
-                            (Struct,
-                                for(auto& val : e.vals)
-                                    H::visit_param(*this, val);
-                                )
-                            )
-                        )
-                        else TU_IFLET(::MIR::Statement, stmt, Drop, se,
-                            H::visit_lvalue(*this, se.slot);
-                        )
-                        else {
-                        }
-                    }
-                    TU_MATCHA( (block.terminator), (te),
-                    (Incomplete, ),
-                    (Return, ),
-                    (Diverge, ),
-                    (Goto, ),
-                    (Panic, ),
-                    (If,
-                        H::visit_lvalue(*this, te.cond);
-                        ),
-                    (Switch,
-                        H::visit_lvalue(*this, te.val);
+                }
+                TU_MATCHA( (block.terminator), (te),
+                (Incomplete, ),
+                (Return, ),
+                (Diverge, ),
+                (Goto, ),
+                (Panic, ),
+                (If,
+                    H::visit_lvalue(*this, te.cond);
+                    ),
+                (Switch,
+                    H::visit_lvalue(*this, te.val);
+                    ),
+                (SwitchValue,
+                    H::visit_lvalue(*this, te.val);
+                    ),
+                (Call,
+                    H::visit_lvalue(*this, te.ret_val);
+                    TU_MATCHA( (te.fcn), (e2),
+                    (Value,
+                        H::visit_lvalue(*this, e2);
                         ),
-                    (SwitchValue,
-                        H::visit_lvalue(*this, te.val);
+                    (Path,
+                        visit_path(e2, ::HIR::Visitor::PathContext::VALUE);
                         ),
-                    (Call,
-                        H::visit_lvalue(*this, te.ret_val);
-                        TU_MATCHA( (te.fcn), (e2),
-                        (Value,
-                            H::visit_lvalue(*this, e2);
-                            ),
-                        (Path,
-                            visit_path(e2, ::HIR::Visitor::PathContext::VALUE);
-                            ),
-                        (Intrinsic,
-                            visit_path_params(e2.params);
-                            )
-                        )
-                        for(auto& arg : te.args)
-                            H::visit_param(*this, arg);
+                    (Intrinsic,
+                        visit_path_params(e2.params);
                         )
                     )
-                }
-            }
-            else
-            {
+                    for(auto& arg : te.args)
+                        H::visit_param(*this, arg);
+                    )
+                )
             }
         }
     };
@@ -684,4 +692,21 @@ void ConvertHIR_Bind(::HIR::Crate& crate)
     {
         exp.visit_crate( *ec.second.m_data );
     }
+
+    // Extern MIR that is loaded on first use is bound when it's loaded
+    const auto& crate_ref = crate;
+    ::MIR::FunctionPointer::set_load_hook([&crate_ref](::MIR::Function& fcn) {
+        Visitor v { crate_ref };
+        v.visit_mir(fcn);
+        });
+}
+void ConvertHIR_Bind_Path(const ::HIR::Crate& crate, ::HIR::Path& path)
+{
+    Visitor v { crate };
+    v.visit_path(path, ::HIR::Visitor::PathContext::VALUE);
+}
+void ConvertHIR_Bind_Type(const ::HIR::Crate& crate, ::HIR::TypeRef& ty)
+{
+    Visitor v { crate };
+    v.visit_type(ty);
 }
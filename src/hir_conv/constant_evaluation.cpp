@@ -13,8 +13,12 @@
 #include <mir/mir.hpp>
 #include <hir_typeck/common.hpp>    // Monomorph
 #include <mir/helpers.hpp>
+#include <hir/const_eval_cache.hpp>
 
 namespace {
+    /// Memoised results of `const fn` calls (cleared for each crate)
+    ::HIR::ConstEvalCache   g_eval_cache;
+
     typedef ::std::vector< ::std::pair< ::std::string, ::HIR::Static> > t_new_values;
 
     struct NewvalState {
@@ -47,7 +51,7 @@ namespace {
         }
     };
 
-    ::HIR::Literal evaluate_constant(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::ExprPtr& expr, ::HIR::TypeRef exp, ::std::vector< ::HIR::Literal> args={});
+    ::HIR::Literal evaluate_constant(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::ExprPtr& expr, ::HIR::TypeRef exp, MonomorphState ms={}, ::std::vector< ::HIR::Literal> args={});
 
     ::HIR::Literal clone_literal(const ::HIR::Literal& v)
     {
@@ -62,6 +66,9 @@ namespace {
             }
             return ::HIR::Literal( mv$(vals) );
             ),
+        (Packed,
+            return ::HIR::Literal::make_Packed({ e.elem_size, e.is_signed, e.data });
+            ),
         (Variant,
             ::std::vector< ::HIR::Literal>  vals;
             for(const auto& val : e.vals) {
@@ -87,6 +94,30 @@ namespace {
         )
         throw "";
     }
+    ::std::vector< ::HIR::Literal> clone_literals(const ::std::vector< ::HIR::Literal>& v)
+    {
+        ::std::vector< ::HIR::Literal>  rv;
+        rv.reserve( v.size() );
+        for(const auto& val : v)
+            rv.push_back( clone_literal(val) );
+        return rv;
+    }
+
+    /// Evaluate a `const fn` body, reusing the result of an earlier call to `path` with the same arguments
+    /// - `path` must be monomorphised (the same generic path can name different functions)
+    ::HIR::Literal evaluate_constant_cached(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::Path& path, const ::HIR::ExprPtr& expr, ::HIR::TypeRef exp, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
+    {
+        auto key = FMT(path);
+        if( const auto* v = g_eval_cache.get(key, args) )
+        {
+            DEBUG("Cached " << path << " = " << *v);
+            return clone_literal(*v);
+        }
+        auto cache_args = clone_literals(args);
+        auto rv = evaluate_constant(sp, crate, mv$(newval_state), expr, mv$(exp), mv$(ms), mv$(args));
+        g_eval_cache.insert( mv$(key), mv$(cache_args), clone_literal(rv) );
+        return rv;
+    }
 
     TAGGED_UNION(EntPtr, NotFound,
         (NotFound, struct{}),
@@ -158,10 +189,12 @@ namespace {
         }
         throw "";
     }
-    EntPtr get_ent_fullpath(const Span& sp, const ::HIR::Crate& crate, const ::HIR::Path& path, EntNS ns)
+    EntPtr get_ent_fullpath(const Span& sp, const ::HIR::Crate& crate, const ::HIR::Path& path, EntNS ns, MonomorphState& out_ms)
     {
         TU_MATCH(::HIR::Path::Data, (path.m_data), (e),
         (Generic,
+            out_ms = MonomorphState {};
+            out_ms.pp_method = &e.m_params;
             return get_ent_simplepath(sp, crate, e.m_path, ns);
             ),
         (UfcsInherent,
@@ -194,6 +227,9 @@ namespace {
                 }
                 return false;
                 });
+            out_ms = MonomorphState {};
+            out_ms.pp_method = &e.params;
+            out_ms.pp_impl = &e.impl_params;
             return rv;
             ),
         (UfcsKnown,
@@ -228,6 +264,9 @@ namespace {
                 }
                 return false;
                 });
+            out_ms = MonomorphState {};
+            out_ms.pp_method = &e.params;
+            // TODO: How to get pp_impl here? Needs specialisation magic.
             return rv;
             ),
         (UfcsUnknown,
@@ -237,9 +276,9 @@ namespace {
         )
         throw "";
     }
-    const ::HIR::Function& get_function(const Span& sp, const ::HIR::Crate& crate, const ::HIR::Path& path)
+    const ::HIR::Function& get_function(const Span& sp, const ::HIR::Crate& crate, const ::HIR::Path& path, MonomorphState& out_ms)
     {
-        auto rv = get_ent_fullpath(sp, crate, path, EntNS::Value);
+        auto rv = get_ent_fullpath(sp, crate, path, EntNS::Value, out_ms);
         TU_IFLET( EntPtr, rv, Function, e,
             return *e;
         )
@@ -247,14 +286,24 @@ namespace {
             TODO(sp, "Could not find function for " << path << " - " << rv.tag_str());
         }
     }
+    /// Monomorphise a path used in the body being evaluated
+    /// - Outside of a `const fn` call there's nothing to substitute, and the path is used as-is
+    ::HIR::Path monomorph_path(const Span& sp, const MonomorphState& ms, const ::HIR::Path& path)
+    {
+        if( !ms.self_ty && !ms.pp_impl && !ms.pp_method )
+            return path.clone();
+        return ms.monomorph(sp, path);
+    }
 
-    ::HIR::Literal evaluate_constant_hir(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::ExprNode& expr, ::HIR::TypeRef exp_type, ::std::vector< ::HIR::Literal> args)
+    ::HIR::Literal evaluate_constant_hir(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::ExprNode& expr, ::HIR::TypeRef exp_type, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
     {
         struct Visitor:
             public ::HIR::ExprVisitor
         {
             const ::HIR::Crate& m_crate;
             NewvalState m_newval_state;
+            // Parameters of the `const fn` being evaluated
+            MonomorphState  m_ms;
 
             ::std::vector< ::HIR::Literal>   m_values;
 
@@ -262,9 +311,10 @@ namespace {
             ::HIR::TypeRef  m_rv_type;
             ::HIR::Literal  m_rv;
 
-            Visitor(const ::HIR::Crate& crate, NewvalState newval_state, ::HIR::TypeRef exp_ty):
+            Visitor(const ::HIR::Crate& crate, NewvalState newval_state, MonomorphState ms, ::HIR::TypeRef exp_ty):
                 m_crate(crate),
                 m_newval_state( mv$(newval_state) ),
+                m_ms( mv$(ms) ),
                 m_exp_type( mv$(exp_ty) )
             {}
 
@@ -541,14 +591,24 @@ namespace {
                 // Value
                 m_exp_type = ::HIR::TypeRef::new_slice( mv$(exp_ty) );
                 node.m_value->visit(*this);
-                if( !m_rv.is_List() )
-                    ERROR(node.span(), E0000, "Indexed value isn't a list - got " << m_rv.tag_str());
-                auto v = mv$( m_rv.as_List() );
-
-                // -> Perform
-                if( idx >= v.size() )
-                    ERROR(node.span(), E0000, "Constant array index " << idx << " out of range " << v.size());
-                m_rv = mv$(v[idx]);
+                if( m_rv.is_Packed() )
+                {
+                    auto v = mv$( m_rv.as_Packed() );
+                    if( idx >= v.size() )
+                        ERROR(node.span(), E0000, "Constant array index " << idx << " out of range " << v.size());
+                    m_rv = ::HIR::Literal( v.get(idx) );
+                }
+                else
+                {
+                    if( !m_rv.is_List() )
+                        ERROR(node.span(), E0000, "Indexed value isn't a list - got " << m_rv.tag_str());
+                    auto v = mv$( m_rv.as_List() );
+
+                    // -> Perform
+                    if( idx >= v.size() )
+                        ERROR(node.span(), E0000, "Constant array index " << idx << " out of range " << v.size());
+                    m_rv = mv$(v[idx]);
+                }
 
                 TU_MATCH_DEF( ::HIR::TypeRef::Data, (m_rv_type.m_data), (e),
                 (
@@ -607,7 +667,9 @@ namespace {
             {
 
                 TRACE_FUNCTION_FR("_CallPath - " << node.m_path, m_rv);
-                auto& fcn = get_function(node.span(), m_crate, node.m_path);
+                auto fcnp = monomorph_path(node.span(), m_ms, node.m_path);
+                MonomorphState  fcn_ms;
+                auto& fcn = get_function(node.span(), m_crate, fcnp, fcn_ms);
 
                 // TODO: Set m_const during parse
                 //if( ! fcn.m_const ) {
@@ -645,8 +707,8 @@ namespace {
 
                 // Call by invoking evaluate_constant on the function
                 {
-                    TRACE_FUNCTION_F("Call const fn " << node.m_path << " args={ " << args << " }");
-                    m_rv = evaluate_constant(node.span(), m_crate, m_newval_state,  fcn.m_code, mv$(exp_ret_type), mv$(args));
+                    TRACE_FUNCTION_F("Call const fn " << fcnp << " args={ " << args << " }");
+                    m_rv = evaluate_constant_cached(node.span(), m_crate, m_newval_state, fcnp,  fcn.m_code, mv$(exp_ret_type), mv$(fcn_ms), mv$(args));
                 }
             }
             void visit(::HIR::ExprNode_CallValue& node) override {
@@ -776,7 +838,8 @@ namespace {
             }
             void visit(::HIR::ExprNode_PathValue& node) override {
                 TRACE_FUNCTION_FR("_PathValue - " << node.m_path, m_rv);
-                auto ep = get_ent_fullpath(node.span(), m_crate, node.m_path, EntNS::Value);
+                MonomorphState  ent_ms;
+                auto ep = get_ent_fullpath(node.span(), m_crate, node.m_path, EntNS::Value, ent_ms);
                 TU_MATCH_DEF( EntPtr, (ep), (e),
                 (
                     BUG(node.span(), "Path value with unsupported value type - " << ep.tag_str());
@@ -976,6 +1039,7 @@ namespace {
                 m_exp_type = ::HIR::CoreType::Usize;
                 node.m_size->visit(*this);
                 assert( m_rv.is_Integer() );
+                g_eval_cache.check_array_len(node.span(), m_rv.as_Integer());
                 unsigned int count = static_cast<unsigned int>(m_rv.as_Integer());
 
                 ::std::vector< ::HIR::Literal>  vals;
@@ -1000,7 +1064,7 @@ namespace {
             }
         };
 
-        Visitor v { crate, newval_state, mv$(exp_type) };
+        Visitor v { crate, newval_state, mv$(ms), mv$(exp_type) };
         for(auto& arg : args)
             v.m_values.push_back( mv$(arg) );
         const_cast<::HIR::ExprNode&>(expr).visit(v);
@@ -1012,7 +1076,7 @@ namespace {
         return mv$(v.m_rv);
     }
 
-    ::HIR::Literal evaluate_constant_mir(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::MIR::Function& fcn, ::HIR::TypeRef exp, ::std::vector< ::HIR::Literal> args)
+    ::HIR::Literal evaluate_constant_mir(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::MIR::Function& fcn, ::HIR::TypeRef exp, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
     {
         TRACE_FUNCTION_F("exp=" << exp << ", args=" << args);
 
@@ -1095,7 +1159,8 @@ namespace {
                 return ::HIR::Literal(e2);
                 ),
             (Const,
-                auto ent = get_ent_fullpath(sp, crate, e2.p, EntNS::Value);
+                MonomorphState  const_ms;
+                auto ent = get_ent_fullpath(sp, crate, e2.p, EntNS::Value, const_ms);
                 ASSERT_BUG(sp, ent.is_Constant(), "MIR Constant::Const("<<e2.p<<") didn't point to a Constant - " << ent.tag_str());
                 return clone_literal( ent.as_Constant()->m_value_res );
                 ),
@@ -1125,6 +1190,7 @@ namespace {
             for(const auto& stmt : block.statements)
             {
                 state.set_cur_stmt(cur_block, next_stmt_idx++);
+                g_eval_cache.step(sp);
 
                 if( ! stmt.is_Assign() ) {
                     //BUG(sp, "Non-assign statement - drop " << stmt.as_Drop().slot);
@@ -1141,6 +1207,7 @@ namespace {
                     val = const_to_lit(e);
                     ),
                 (SizedArray,
+                    g_eval_cache.check_array_len(sp, e.count);
                     ::std::vector< ::HIR::Literal>  vals;
                     if( e.count > 0 )
                     {
@@ -1428,10 +1495,11 @@ namespace {
             (Call,
                 if( !e.fcn.is_Path() )
                     BUG(sp, "Unexpected terminator - " << block.terminator);
-                const auto& fcnp = e.fcn.as_Path();
+                auto fcnp = monomorph_path(sp, ms, e.fcn.as_Path());
 
                 auto& dst = get_lval(e.ret_val);
-                auto& fcn = get_function(sp, crate, fcnp);
+                MonomorphState  fcn_ms;
+                auto& fcn = get_function(sp, crate, fcnp, fcn_ms);
 
                 ::std::vector< ::HIR::Literal>  call_args;
                 call_args.reserve( e.args.size() );
@@ -1442,7 +1510,7 @@ namespace {
                 // Call by invoking evaluate_constant on the function
                 {
                     TRACE_FUNCTION_F("Call const fn " << fcnp << " args={ " << call_args << " }");
-                    dst = evaluate_constant(sp, crate, newval_state,  fcn.m_code, fcn.m_return.clone(), mv$(call_args));
+                    dst = evaluate_constant_cached(sp, crate, newval_state, fcnp,  fcn.m_code, fcn.m_return.clone(), mv$(fcn_ms), mv$(call_args));
                 }
 
                 cur_block = e.ret_block;
@@ -1451,13 +1519,14 @@ namespace {
         }
     }
 
-    ::HIR::Literal evaluate_constant(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::ExprPtr& expr, ::HIR::TypeRef exp, ::std::vector< ::HIR::Literal> args)
+    ::HIR::Literal evaluate_constant(const Span& sp, const ::HIR::Crate& crate, NewvalState newval_state, const ::HIR::ExprPtr& expr, ::HIR::TypeRef exp, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
     {
+        ::HIR::ConstEvalCache::Frame    frame { g_eval_cache, sp, FMT_CB(ss, ss << "value of type " << exp;) };
         if( expr.m_mir ) {
-            return evaluate_constant_mir(sp, crate, mv$(newval_state), *expr.m_mir, mv$(exp), mv$(args));
+            return evaluate_constant_mir(sp, crate, mv$(newval_state), *expr.m_mir, mv$(exp), mv$(ms), mv$(args));
         }
         else if( expr ) {
-            return evaluate_constant_hir(sp, crate, mv$(newval_state), *expr, mv$(exp), mv$(args));
+            return evaluate_constant_hir(sp, crate, mv$(newval_state), *expr, mv$(exp), mv$(ms), mv$(args));
         }
         else {
             BUG(sp, "Attempting to evaluate constant expression with no associated code");
@@ -1599,6 +1668,7 @@ namespace {
                 item.m_value_res = evaluate_constant(item.m_value->span(), m_crate, nvs, item.m_value, item.m_type.clone(), {});
 
                 check_lit_type(item.m_value->span(), item.m_type, item.m_value_res);
+                item.m_value_res.pack_arrays(item.m_type);
 
                 DEBUG("constant: " << item.m_type <<  " = " << item.m_value_res);
             }
@@ -1648,7 +1718,7 @@ namespace {
                 void visit(::HIR::ExprNode_ArraySized& node) override {
                     assert( node.m_size );
                     NewvalState nvs { m_exp.m_new_values, *m_exp.m_mod_path, FMT("array_" << &node << "$") };
-                    auto val = evaluate_constant_hir(node.span(), m_exp.m_crate, mv$(nvs), *node.m_size, ::HIR::CoreType::Usize, {});
+                    auto val = evaluate_constant_hir(node.span(), m_exp.m_crate, mv$(nvs), *node.m_size, ::HIR::CoreType::Usize, {}, {});
                     if( !val.is_Integer() )
                         ERROR(node.span(), E0000, "Array size isn't an integer");
                     node.m_size_val = static_cast<size_t>(val.as_Integer());
@@ -1677,5 +1747,7 @@ namespace {
 void ConvertHIR_ConstantEvaluate(::HIR::Crate& crate)
 {
     Expander    exp { crate };
+    g_eval_cache.clear();
     exp.visit_crate( crate );
+    g_eval_cache.clear();
 }
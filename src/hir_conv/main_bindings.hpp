@@ -4,10 +4,15 @@
 
 namespace HIR {
     class Crate;
+    class Path;
+    class TypeRef;
 };
 
 extern void ConvertHIR_ExpandAliases(::HIR::Crate& crate);
 extern void ConvertHIR_Bind(::HIR::Crate& crate);
+/// Bind a path/type read from outside of the crate metadata (e.g. a trans cache)
+extern void ConvertHIR_Bind_Path(const ::HIR::Crate& crate, ::HIR::Path& path);
+extern void ConvertHIR_Bind_Type(const ::HIR::Crate& crate, ::HIR::TypeRef& ty);
 extern void ConvertHIR_ResolveUFCS(::HIR::Crate& crate);
 extern void ConvertHIR_Markings(::HIR::Crate& crate);
 extern void ConvertHIR_ConstantEvaluate(::HIR::Crate& hir_crate);
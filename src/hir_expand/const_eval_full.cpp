@@ -16,8 +16,12 @@
 #include <mir/mir.hpp>
 #include <hir_typeck/common.hpp>    // Monomorph
 #include <mir/helpers.hpp>
+#include <hir/const_eval_cache.hpp>
 
 namespace {
+    /// Memoised results of `const fn` calls and constant references (cleared for each crate)
+    ::HIR::ConstEvalCache   g_eval_cache;
+
     typedef ::std::vector< ::std::pair< ::std::string, ::HIR::Static> > t_new_values;
 
     struct NewvalState {
@@ -65,6 +69,9 @@ namespace {
             }
             return ::HIR::Literal( mv$(vals) );
             ),
+        (Packed,
+            return ::HIR::Literal::make_Packed({ e.elem_size, e.is_signed, e.data });
+            ),
         (Variant,
             ::std::vector< ::HIR::Literal>  vals;
             for(const auto& val : e.vals) {
@@ -90,6 +97,29 @@ namespace {
         )
         throw "";
     }
+    ::std::vector< ::HIR::Literal> clone_literals(const ::std::vector< ::HIR::Literal>& v)
+    {
+        ::std::vector< ::HIR::Literal>  rv;
+        rv.reserve( v.size() );
+        for(const auto& val : v)
+            rv.push_back( clone_literal(val) );
+        return rv;
+    }
+
+    /// Evaluate a constant/`const fn` body, reusing the result of an earlier identical evaluation of `path`
+    ::HIR::Literal evaluate_constant_cached(const Span& sp, const ::StaticTraitResolve& resolve, NewvalState newval_state, const ::HIR::Path& path, const ::HIR::ExprPtr& expr, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
+    {
+        auto key = FMT(path);
+        if( const auto* v = g_eval_cache.get(key, args) )
+        {
+            DEBUG("Cached " << path << " = " << *v);
+            return clone_literal(*v);
+        }
+        auto cache_args = clone_literals(args);
+        auto rv = evaluate_constant(sp, resolve, mv$(newval_state), FMT_CB(ss, ss << path;), expr, mv$(ms), mv$(args));
+        g_eval_cache.insert( mv$(key), mv$(cache_args), clone_literal(rv) );
+        return rv;
+    }
 
     void monomorph_literal_inplace(const Span& sp, ::HIR::Literal& lit, const MonomorphState& ms)
     {
@@ -101,6 +131,8 @@ namespace {
                 monomorph_literal_inplace(sp, val, ms);
             }
             ),
+        (Packed,
+            ),
         (Variant,
             for(auto& val : e.vals) {
                 monomorph_literal_inplace(sp, val, ms);
@@ -345,6 +377,8 @@ namespace {
                     ),
                 (Index,
                     auto& val = get_lval(*e.val);
+                    // The entry may be modified through the returned reference, so expand packed arrays
+                    val.unpack();
                     MIR_ASSERT(state, val.is_List(), "LValue::Index on non-list literal - " << val.tag_str() << " - " << lv);
                     auto& idx = get_lval(*e.idx);
                     MIR_ASSERT(state, idx.is_Integer(), "LValue::Index with non-integer index literal - " << idx.tag_str() << " - " << lv);
@@ -364,6 +398,19 @@ namespace {
 
         auto get_lval = [&](const ::MIR::LValue& lv) -> ::HIR::Literal& { return local_state.get_lval(lv); };
         auto read_lval = [&](const ::MIR::LValue& lv) -> ::HIR::Literal {
+            // Read entries of packed arrays without expanding them
+            if( const auto* ie = lv.opt_Index() )
+            {
+                const auto& base = get_lval(*ie->val);
+                if( const auto* pe = base.opt_Packed() )
+                {
+                    const auto& idx = get_lval(*ie->idx);
+                    MIR_ASSERT(state, idx.is_Integer(), "LValue::Index with non-integer index literal - " << idx.tag_str() << " - " << lv);
+                    auto idx_v = static_cast<size_t>( idx.as_Integer() );
+                    MIR_ASSERT(state, idx_v < pe->size(), "LValue::Index index out of range");
+                    return ::HIR::Literal( pe->get(idx_v) );
+                }
+            }
             auto& v = get_lval(lv);
             TU_MATCH_DEF(::HIR::Literal, (v), (e),
             (
@@ -414,7 +461,7 @@ namespace {
                 //   effectively the same thing.
                 // Avoids _BorrowData leftovers.
                 if( c.m_value ) {
-                    return evaluate_constant(sp, resolve, newval_state, FMT_CB(ss, ss << e2.p;), ent.as_Constant()->m_value, {}, {});
+                    return evaluate_constant_cached(sp, resolve, newval_state, e2.p, ent.as_Constant()->m_value, {}, {});
                 }
                 else {
                     auto val = clone_literal( ent.as_Constant()->m_value_res );
@@ -450,6 +497,7 @@ namespace {
             for(const auto& stmt : block.statements)
             {
                 state.set_cur_stmt(cur_block, next_stmt_idx++);
+                g_eval_cache.step(sp);
 
                 if( ! stmt.is_Assign() ) {
                     //BUG(sp, "Non-assign statement - drop " << stmt.as_Drop().slot);
@@ -467,6 +515,7 @@ namespace {
                     val = const_to_lit(e);
                     ),
                 (SizedArray,
+                    g_eval_cache.check_array_len(sp, e.count);
                     ::std::vector< ::HIR::Literal>  vals;
                     if( e.count > 0 )
                     {
@@ -761,7 +810,7 @@ namespace {
                 // Call by invoking evaluate_constant on the function
                 {
                     TRACE_FUNCTION_F("Call const fn " << fcnp << " args={ " << call_args << " }");
-                    dst = evaluate_constant(sp, resolve, newval_state, FMT_CB(ss, ss << fcnp;),  fcn.m_code, mv$(fcn_ms), mv$(call_args));
+                    dst = evaluate_constant_cached(sp, resolve, newval_state, fcnp,  fcn.m_code, mv$(fcn_ms), mv$(call_args));
                 }
 
                 DEBUG("= " << dst);
@@ -774,6 +823,7 @@ namespace {
     ::HIR::Literal evaluate_constant(const Span& sp, const StaticTraitResolve& resolve, NewvalState newval_state, FmtLambda name, const ::HIR::ExprPtr& expr, MonomorphState ms, ::std::vector< ::HIR::Literal> args)
     {
         if( expr.m_mir ) {
+            ::HIR::ConstEvalCache::Frame    frame { g_eval_cache, sp, name };
             return evaluate_constant_mir(sp, resolve, mv$(newval_state), name, *expr.m_mir, mv$(ms), mv$(args));
         }
         else {
@@ -906,6 +956,7 @@ namespace {
                 item.m_value_res = evaluate_constant(item.m_value->span(), m_resolve, nvs, FMT_CB(ss, ss << p;), item.m_value, {}, {});
 
                 check_lit_type(item.m_value->span(), item.m_type, item.m_value_res);
+                item.m_value_res.pack_arrays(item.m_type);
                 DEBUG("constant: " << item.m_type <<  " = " << item.m_value_res);
                 visit_expr(item.m_value);
             }
@@ -917,6 +968,7 @@ namespace {
             {
                 auto nvs = NewvalState { m_new_values, *m_mod_path, FMT(p.get_name() << "$") };
                 item.m_value_res = evaluate_constant(item.m_value->span(), m_resolve, mv$(nvs), FMT_CB(ss, ss << p;), item.m_value, {}, {});
+                item.m_value_res.pack_arrays(item.m_type);
                 DEBUG("static: " << item.m_type <<  " = " << item.m_value_res);
                 visit_expr(item.m_value);
             }
@@ -938,5 +990,7 @@ namespace {
 void ConvertHIR_ConstantEvaluateFull(::HIR::Crate& crate)
 {
     Expander    exp { crate };
+    g_eval_cache.clear();
     exp.visit_crate( crate );
+    g_eval_cache.clear();
 }
@@ -206,12 +206,15 @@ namespace {
                     params.m_types.push_back( ::HIR::TypeRef( mv$(path) ) );
                 }
             }
+            ::HIR::StructMarkings   markings;
+            markings.is_vtable = true;
             // TODO: Would like to have access to the publicity marker
             auto item_path = m_new_type(true, FMT(p.get_name() << "#vtable"), ::HIR::Struct {
                 mv$(args),
                 ::HIR::Struct::Repr::Rust,
                 ::HIR::Struct::Data(mv$(fields)),
-                {}
+                {},
+                mv$(markings)
                 });
             DEBUG("Vtable structure created - " << item_path);
             ::HIR::GenericPath  path( mv$(item_path), mv$(params) );
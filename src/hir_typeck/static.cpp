@@ -16,6 +16,8 @@ void StaticTraitResolve::prep_indexes()
     TRACE_FUNCTION_F("");
 
     m_copy_cache.clear();
+    m_drop_glue_cache.clear();
+    m_target_layout_cache.reset();
 
     auto add_equality = [&](::HIR::TypeRef long_ty, ::HIR::TypeRef short_ty){
         DEBUG("[prep_indexes] ADD " << long_ty << " => " << short_ty);
@@ -1748,17 +1750,171 @@ bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeR
         // TODO: Is this an error?
         return true;
         ),
+    (Path,
+        {
+            auto it = m_drop_glue_cache.find(ty);
+            if( it != m_drop_glue_cache.end() )
+                return it->second;
+        }
+        bool rv = path_needs_drop_glue(sp, ty);
+        m_drop_glue_cache.insert(::std::make_pair( ty.clone(), rv ));
+        return rv;
+        ),
+    (Diverge,
+        return false;
+        ),
+    (Closure,
+        // TODO: Destructure?
+        return true;
+        ),
+    (Infer,
+        BUG(sp, "type_needs_drop_glue on _");
+        return false;
+        ),
+    (Borrow,
+        // &-ptrs don't have drop glue
+        if( e.type != ::HIR::BorrowType::Owned )
+            return false;
+        return type_needs_drop_glue(sp, *e.inner);
+        ),
+    (Pointer,
+        return false;
+        ),
+    (Function,
+        return false;
+        ),
+    (Primitive,
+        return false;
+        ),
+    (Array,
+        return type_needs_drop_glue(sp, *e.inner);
+        ),
+    (Slice,
+        return type_needs_drop_glue(sp, *e.inner);
+        ),
+    (TraitObject,
+        return true;
+        ),
+    (ErasedType,
+        // Is this an error?
+        return true;
+        ),
+    (Tuple,
+        for(const auto& ty : e)
+        {
+            if( type_needs_drop_glue(sp, ty) )
+                return true;
+        }
+        return false;
+        )
+    )
+    assert(!"Fell off the end of type_needs_drop_glue");
+    throw "";
+}
+bool StaticTraitResolve::path_needs_drop_glue(const Span& sp, const ::HIR::TypeRef& ty) const
+{
+    const auto& e = ty.m_data.as_Path();
+    if( e.binding.is_Opaque() )
+        return true;
+    // Box frees its allocation even if the contents are trivial
+    if( is_type_owned_box(ty) )
+        return true;
+
+    auto pp = ::HIR::PathParams();
+    bool has_direct_drop = this->find_impl(sp, m_lang_Drop, &pp, ty, [&](auto , bool){ return true; }, true);
+    if( has_direct_drop )
+        return true;
+
+    ::HIR::TypeRef  tmp_ty;
+    const auto& pe = e.path.m_data.as_Generic();
+    auto monomorph_cb = monomorphise_type_get_cb(sp, nullptr, &pe.m_params, nullptr, nullptr);
+    auto monomorph = [&](const auto& tpl)->const ::HIR::TypeRef& {
+        if( monomorphise_type_needed(tpl) ) {
+            tmp_ty = monomorphise_type_with(sp, tpl, monomorph_cb, false);
+            this->expand_associated_types(sp, tmp_ty);
+            return tmp_ty;
+        }
+        else {
+            return tpl;
+        }
+        };
+    TU_MATCHA( (e.binding), (pbe),
+    (Unbound,
+        BUG(sp, "Unbound path");
+        ),
+    (Opaque,
+        // Technically a bug, checked above
+        return true;
+        ),
+    (Struct,
+        TU_MATCHA( (pbe->m_data), (se),
+        (Unit,
+            ),
+        (Tuple,
+            for(const auto& e : se)
+            {
+                if( type_needs_drop_glue(sp, monomorph(e.ent)) )
+                    return true;
+            }
+            ),
+        (Named,
+            for(const auto& e : se)
+            {
+                if( type_needs_drop_glue(sp, monomorph(e.second.ent)) )
+                    return true;
+            }
+            )
+        )
+        return false;
+        ),
+    (Enum,
+        for(const auto& e : pbe->m_variants)
+        {
+            TU_MATCHA( (e.second), (ve),
+            (Unit,
+                ),
+            (Value,
+                ),
+            (Tuple,
+                for(const auto& e : ve)
+                {
+                    if( type_needs_drop_glue(sp, monomorph(e.ent)) )
+                        return true;
+                }
+                ),
+            (Struct,
+                for(const auto& e : ve)
+                {
+                    if( type_needs_drop_glue(sp, monomorph(e.second.ent)) )
+                        return true;
+                }
+                )
+            )
+        }
+        return false;
+        ),
+    (Union,
+        // Unions don't have drop glue unless they impl Drop
+        return false;
+        )
+    )
+    throw "";
+}
+
+bool StaticTraitResolve::type_is_interior_mutable(const Span& sp, const ::HIR::TypeRef& ty) const
+{
+    TU_MATCH(::HIR::TypeRef::Data, (ty.m_data), (e),
+    (Generic,
+        return true;
+        ),
     (Path,
         if( e.binding.is_Opaque() )
             return true;
-
-        auto pp = ::HIR::PathParams();
-        bool has_direct_drop = this->find_impl(sp, m_lang_Drop, &pp, ty, [&](auto , bool){ return true; }, true);
-        if( has_direct_drop )
+        const auto& pe = e.path.m_data.as_Generic();
+        if( pe.m_path == m_lang_UnsafeCell )
             return true;
 
         ::HIR::TypeRef  tmp_ty;
-        const auto& pe = e.path.m_data.as_Generic();
         auto monomorph_cb = monomorphise_type_get_cb(sp, nullptr, &pe.m_params, nullptr, nullptr);
         auto monomorph = [&](const auto& tpl)->const ::HIR::TypeRef& {
             if( monomorphise_type_needed(tpl) ) {
@@ -1775,7 +1931,6 @@ bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeR
             BUG(sp, "Unbound path");
             ),
         (Opaque,
-            // Technically a bug, checked above
             return true;
             ),
         (Struct,
@@ -1785,14 +1940,14 @@ bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeR
             (Tuple,
                 for(const auto& e : se)
                 {
-                    if( type_needs_drop_glue(sp, monomorph(e.ent)) )
+                    if( type_is_interior_mutable(sp, monomorph(e.ent)) )
                         return true;
                 }
                 ),
             (Named,
                 for(const auto& e : se)
                 {
-                    if( type_needs_drop_glue(sp, monomorph(e.second.ent)) )
+                    if( type_is_interior_mutable(sp, monomorph(e.second.ent)) )
                         return true;
                 }
                 )
@@ -1810,14 +1965,14 @@ bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeR
                 (Tuple,
                     for(const auto& e : ve)
                     {
-                        if( type_needs_drop_glue(sp, monomorph(e.ent)) )
+                        if( type_is_interior_mutable(sp, monomorph(e.ent)) )
                             return true;
                     }
                     ),
                 (Struct,
                     for(const auto& e : ve)
                     {
-                        if( type_needs_drop_glue(sp, monomorph(e.second.ent)) )
+                        if( type_is_interior_mutable(sp, monomorph(e.second.ent)) )
                             return true;
                     }
                     )
@@ -1826,7 +1981,11 @@ bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeR
             return false;
             ),
         (Union,
-            // Unions don't have drop glue unless they impl Drop
+            for(const auto& e : pbe->m_variants)
+            {
+                if( type_is_interior_mutable(sp, monomorph(e.second.ent)) )
+                    return true;
+            }
             return false;
             )
         )
@@ -1835,18 +1994,15 @@ bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeR
         return false;
         ),
     (Closure,
-        // TODO: Destructure?
+        // TODO: Check the captures
         return true;
         ),
     (Infer,
-        BUG(sp, "type_needs_drop_glue on _");
-        return false;
+        BUG(sp, "type_is_interior_mutable on _");
+        return true;
         ),
     (Borrow,
-        // &-ptrs don't have drop glue
-        if( e.type != ::HIR::BorrowType::Owned )
-            return false;
-        return type_needs_drop_glue(sp, *e.inner);
+        return false;
         ),
     (Pointer,
         return false;
@@ -1858,28 +2014,27 @@ bool StaticTraitResolve::type_needs_drop_glue(const Span& sp, const ::HIR::TypeR
         return false;
         ),
     (Array,
-        return type_needs_drop_glue(sp, *e.inner);
+        return type_is_interior_mutable(sp, *e.inner);
         ),
     (Slice,
-        return type_needs_drop_glue(sp, *e.inner);
+        return type_is_interior_mutable(sp, *e.inner);
         ),
     (TraitObject,
         return true;
         ),
     (ErasedType,
-        // Is this an error?
         return true;
         ),
     (Tuple,
         for(const auto& ty : e)
         {
-            if( type_needs_drop_glue(sp, ty) )
+            if( type_is_interior_mutable(sp, ty) )
                 return true;
         }
         return false;
         )
     )
-    assert(!"Fell off the end of type_needs_drop_glue");
+    assert(!"Fell off the end of type_is_interior_mutable");
     throw "";
 }
 
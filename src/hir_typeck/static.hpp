@@ -11,6 +11,8 @@
 #include "common.hpp"
 #include "impl_ref.hpp"
 
+struct TargetLayoutCache;
+
 class StaticTraitResolve
 {
 public:
@@ -31,11 +33,17 @@ public:
     ::HIR::SimplePath   m_lang_FnOnce;
     ::HIR::SimplePath   m_lang_Box;
     ::HIR::SimplePath   m_lang_PhantomData;
+    ::HIR::SimplePath   m_lang_UnsafeCell;
 
 private:
     mutable ::std::map< ::HIR::TypeRef, bool >  m_copy_cache;
+    /// Result of `type_needs_drop_glue` for path types (the only ones that need a trait lookup)
+    mutable ::std::map< ::HIR::TypeRef, bool >  m_drop_glue_cache;
 
 public:
+    /// Struct and enum layouts computed by trans/target.cpp (created on first use)
+    mutable ::std::shared_ptr<TargetLayoutCache>    m_target_layout_cache;
+
     StaticTraitResolve(const ::HIR::Crate& crate):
         m_crate(crate),
         m_impl_generics(nullptr),
@@ -50,6 +58,7 @@ public:
         m_lang_FnOnce = m_crate.get_lang_item_path_opt("fn_once");
         m_lang_Box = m_crate.get_lang_item_path_opt("owned_box");
         m_lang_PhantomData = m_crate.get_lang_item_path_opt("phantom_data");
+        m_lang_UnsafeCell = m_crate.get_lang_item_path_opt("unsafe_cell");
         prep_indexes();
     }
 
@@ -183,6 +192,11 @@ public:
 
     /// Returns `true` if the passed type either implements Drop, or contains a type that implements Drop
     bool type_needs_drop_glue(const Span& sp, const ::HIR::TypeRef& ty) const;
+private:
+    bool path_needs_drop_glue(const Span& sp, const ::HIR::TypeRef& ty) const;
+public:
+    /// Returns `true` if the passed type contains an `UnsafeCell` (not behind a pointer), i.e. it can be mutated through a `&`
+    bool type_is_interior_mutable(const Span& sp, const ::HIR::TypeRef& ty) const;
 
     const ::HIR::TypeRef* is_type_owned_box(const ::HIR::TypeRef& ty) const;
     const ::HIR::TypeRef* is_type_phantom_data(const ::HIR::TypeRef& ty) const;
@@ -10,22 +10,68 @@
 #include <debug.hpp>
 #include <common.hpp>   // vector print
 
-unsigned int Ident::Hygiene::g_next_scope = 0;
+namespace {
+    struct HygieneNode
+    {
+        unsigned int    parent;
+        unsigned int    depth;
+    };
+    // Global context tree, node 0 is the root (empty context)
+    ::std::vector<HygieneNode>& hygiene_tree() {
+        static ::std::vector<HygieneNode> s_tree { HygieneNode { 0, 0 } };
+        return s_tree;
+    }
+
+    // Direct-mapped cache of recent ancestor checks, macro expansion asks the same question for every token of an
+    // identifier lookup.
+    struct VisibilityCacheEnt {
+        unsigned int    des;
+        unsigned int    src;
+        bool    rv;
+    };
+    VisibilityCacheEnt  s_visibility_cache[256];
+}
+
+unsigned int Ident::Hygiene::add_node(unsigned int parent)
+{
+    auto& tree = hygiene_tree();
+    unsigned int depth = tree[parent].depth + 1;
+    tree.push_back(HygieneNode { parent, depth });
+    return tree.size() - 1;
+}
+Ident::Hygiene Ident::Hygiene::get_parent() const
+{
+    //assert(this->m_id != 0);
+    return Hygiene(hygiene_tree()[m_id].parent);
+}
 
 bool Ident::Hygiene::is_visible(const Hygiene& src) const
 {
     // HACK: Disable hygiene for now
     //return true;
 
-    if( this->contexts.size() == 0 ) {
-        return src.contexts.size() == 0;
+    if( this->m_id == 0 ) {
+        return src.m_id == 0;
+    }
+    // Visible if this context is an ancestor of (or equal to) the source context
+    if( this->m_id == src.m_id ) {
+        return true;
+    }
+
+    auto& cache_ent = s_visibility_cache[(this->m_id * 31 + src.m_id) % 256];
+    if( cache_ent.des == this->m_id && cache_ent.src == src.m_id ) {
+        return cache_ent.rv;
     }
 
-    auto des = this->contexts.back();
-    for(const auto& c : src.contexts)
-        if( des == c )
-            return true;
-    return false;
+    const auto& tree = hygiene_tree();
+    auto des_depth = tree[this->m_id].depth;
+    auto cur = src.m_id;
+    while( tree[cur].depth > des_depth )
+        cur = tree[cur].parent;
+    bool rv = (cur == this->m_id);
+
+    cache_ent = VisibilityCacheEnt { this->m_id, src.m_id, rv };
+    return rv;
 }
 
 ::std::ostream& operator<<(::std::ostream& os, const Ident& x) {
@@ -34,7 +80,11 @@ bool Ident::Hygiene::is_visible(const Hygiene& src) const
 }
 
 ::std::ostream& operator<<(::std::ostream& os, const Ident::Hygiene& x) {
-    os << "{" << x.contexts << "}";
+    // Reconstruct the scope chain from the tree
+    ::std::vector<unsigned int> contexts;
+    for(auto id = x.m_id; id != 0; id = hygiene_tree()[id].parent)
+        contexts.insert(contexts.begin(), id);
+    os << "{" << contexts << "}";
     return os;
 }
 
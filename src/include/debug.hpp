@@ -6,24 +6,43 @@
 #include <functional>
 
 extern int g_debug_indent_level;
+extern bool g_debug_enabled;
 
-#ifndef DISABLE_DEBUG
+// Compile-time tracing level
+// - 0: No debug output at all (same as defining DISABLE_DEBUG)
+// - 1: `DEBUG` only, `TRACE_FUNCTION*` compile to nothing
+// - 2: Everything (default)
+#ifndef MRUSTC_TRACE_LEVEL
+# define MRUSTC_TRACE_LEVEL 2
+#endif
+#ifdef DISABLE_DEBUG
+# undef MRUSTC_TRACE_LEVEL
+# define MRUSTC_TRACE_LEVEL 0
+#endif
+
+#if MRUSTC_TRACE_LEVEL > 0
 # define INDENT()    do { g_debug_indent_level += 1; assert(g_debug_indent_level<300); } while(0)
 # define UNINDENT()    do { g_debug_indent_level -= 1; } while(0)
 # define DEBUG(ss)   do{ if(debug_enabled()) { debug_output(g_debug_indent_level, __FUNCTION__) << ss << ::std::endl; } } while(0)
-# define TRACE_FUNCTION  TraceLog _tf_(__func__)
-# define TRACE_FUNCTION_F(ss)    TraceLog _tf_(__func__, [&](::std::ostream&__os){ __os << ss; })
-# define TRACE_FUNCTION_FR(ss,ss2)    TraceLog _tf_(__func__, [&](::std::ostream&__os){ __os << ss; }, [&](::std::ostream&__os){ __os << ss2;})
 #else
 # define INDENT()    do { } while(0)
 # define UNINDENT()    do {} while(0)
 # define DEBUG(ss)   do{ if(false) (void)(::NullSink() << ss); } while(0)
+#endif
+#if MRUSTC_TRACE_LEVEL > 1
+# define TRACE_FUNCTION  ::TraceLog< ::TraceNoRet> _tf_(__func__)
+# define TRACE_FUNCTION_F(ss)    ::TraceLog< ::TraceNoRet> _tf_(__func__, [&](::std::ostream&__os){ __os << ss; })
+# define TRACE_FUNCTION_FR(ss,ss2)    auto _tf_ = ::make_trace_log(__func__, [&](::std::ostream&__os){ __os << ss; }, [&](::std::ostream&__os){ __os << ss2;})
+#else
 # define TRACE_FUNCTION  do{} while(0)
 # define TRACE_FUNCTION_F(ss)  do{ if(false) (void)(::NullSink() << ss); } while(0)
 # define TRACE_FUNCTION_FR(ss,ss2)  do{ if(false) (void)(::NullSink() << ss); if(false) (void)(::NullSink() << ss2); } while(0)
 #endif
 
-extern bool debug_enabled();
+// Checked before building any debug output, so kept inline
+static inline bool debug_enabled() {
+    return g_debug_enabled;
+}
 extern ::std::ostream& debug_output(int indent, const char* function);
 
 struct RepeatLitStr
@@ -48,16 +67,64 @@ public:
     const NullSink& operator<<(const T&) const { return *this;  }
 };
 
+/// Type-erased reference to a formatting callback, only created when output is enabled
+typedef void (*TraceFmtFcn)(::std::ostream& os, const void* cb);
+template<typename Cb>
+void trace_fmt(::std::ostream& os, const void* cb) {
+    (*static_cast<const Cb*>(cb))(os);
+}
+// Out-of-line halves of TraceLog (`fmt` is null for a bare `TRACE_FUNCTION`)
+extern void trace_enter(const char* tag, TraceFmtFcn fmt, const void* cb);
+extern void trace_leave(const char* tag, TraceFmtFcn fmt, const void* cb);
+
+struct TraceNoRet {
+    void operator()(::std::ostream& ) const {}
+};
+
+/// Function entry/exit tracing, does nothing past a flag check when debug output is disabled
+/// - The callbacks are stored by value (no `std::function`) and only run if output is enabled
+template<typename RetCb>
 class TraceLog
 {
     const char* m_tag;
-    ::std::function<void(::std::ostream&)>  m_ret;
+    RetCb   m_ret;
+    bool    m_active;
 public:
-    TraceLog(const char* tag, ::std::function<void(::std::ostream&)> info_cb, ::std::function<void(::std::ostream&)> ret);
-    TraceLog(const char* tag, ::std::function<void(::std::ostream&)> info_cb);
-    TraceLog(const char* tag);
-    ~TraceLog();
+    TraceLog(const char* tag, RetCb ret=RetCb()):
+        m_tag(tag),
+        m_ret(::std::move(ret)),
+        m_active(debug_enabled())
+    {
+        if( m_active )
+            trace_enter(m_tag, nullptr, nullptr);
+    }
+    template<typename InfoCb>
+    TraceLog(const char* tag, const InfoCb& info_cb, RetCb ret=RetCb()):
+        m_tag(tag),
+        m_ret(::std::move(ret)),
+        m_active(debug_enabled())
+    {
+        if( m_active )
+            trace_enter(m_tag, &trace_fmt<InfoCb>, &info_cb);
+    }
+    TraceLog(TraceLog&& x):
+        m_tag(x.m_tag),
+        m_ret(::std::move(x.m_ret)),
+        m_active(x.m_active)
+    {
+        x.m_active = false;
+    }
+    TraceLog(const TraceLog&) = delete;
+    TraceLog& operator=(const TraceLog&) = delete;
+    ~TraceLog() {
+        if( m_active )
+            trace_leave(m_tag, &trace_fmt<RetCb>, &m_ret);
+    }
 };
+template<typename InfoCb, typename RetCb>
+TraceLog<RetCb> make_trace_log(const char* tag, const InfoCb& info_cb, RetCb ret) {
+    return TraceLog<RetCb>(tag, info_cb, ::std::move(ret));
+}
 
 struct FmtLambda
 {
@@ -11,39 +11,34 @@
 
 struct Ident
 {
+    /// Hygiene context
+    ///
+    /// Contexts are interned into a global tree (see ident.cpp), each `Hygiene` is just the index of a node in that
+    /// tree. A context is the chain of scopes from the root to its node, so `new_scope_chained` adds a child and
+    /// `get_parent` walks up one level.
     class Hygiene
     {
-        static unsigned g_next_scope;
+        /// Index into the global context tree, 0 is the root (empty context)
+        unsigned int    m_id;
 
-        ::std::vector<unsigned int> contexts;
-
-        Hygiene(unsigned int index):
-            contexts({index})
+        explicit Hygiene(unsigned int id):
+            m_id(id)
         {}
+        static unsigned int add_node(unsigned int parent);
     public:
         Hygiene():
-            contexts({})
+            m_id(0)
         {}
 
         static Hygiene new_scope()
         {
-            return Hygiene(++g_next_scope);
+            return Hygiene(add_node(0));
         }
         static Hygiene new_scope_chained(const Hygiene& parent)
         {
-            Hygiene rv;
-            rv.contexts.reserve( parent.contexts.size() + 1 );
-            rv.contexts.insert( rv.contexts.begin(),  parent.contexts.begin(), parent.contexts.end() );
-            rv.contexts.push_back( ++g_next_scope );
-            return rv;
-        }
-        Hygiene get_parent() const
-        {
-            //assert(this->contexts.size() > 1);
-            Hygiene rv;
-            rv.contexts.insert(rv.contexts.begin(),  this->contexts.begin(), this->contexts.end()-1);
-            return rv;
+            return Hygiene(add_node(parent.m_id));
         }
+        Hygiene get_parent() const;
 
         Hygiene(Hygiene&& x) = default;
         Hygiene(const Hygiene& x) = default;
@@ -52,8 +47,8 @@ struct Ident
 
         // Returns true if an ident with hygine `souce` can see an ident with this hygine
         bool is_visible(const Hygiene& source) const;
-        //bool operator==(const Hygiene& x) const { return scope_index == x.scope_index; }
-        //bool operator!=(const Hygiene& x) const { return scope_index != x.scope_index; }
+        bool operator==(const Hygiene& x) const { return m_id == x.m_id; }
+        bool operator!=(const Hygiene& x) const { return m_id != x.m_id; }
 
         friend ::std::ostream& operator<<(::std::ostream& os, const Hygiene& v);
     };
@@ -0,0 +1,47 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * include/node_pool.hpp
+ * - Pooled allocation for tree nodes (expression nodes)
+ */
+#pragma once
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+/// Bump allocator with per-size free lists
+///
+/// Used as the backing store for the class-specific `operator new`/`operator delete` of AST/HIR expression nodes.
+/// Nodes are carved out of large chunks (so a tree is mostly contiguous), freed nodes are recycled by size, and once
+/// every node from a pool has been freed (e.g. the AST is dropped after HIR lowering) all chunks are released at once.
+class NodePool
+{
+    static const size_t GRANULE = 16;
+    static const size_t MAX_POOLED_SIZE = 512;
+    static const size_t CHUNK_SIZE = 256*1024;
+
+    const char* m_name;
+    ::std::vector<void*>    m_chunks;
+    // Singly-linked free lists, indexed by size class
+    void*   m_free_lists[MAX_POOLED_SIZE / GRANULE];
+    char*   m_cur;
+    char*   m_end;
+
+    size_t  m_live_count;
+    size_t  m_peak_bytes;
+    size_t  m_cur_bytes;
+public:
+    NodePool(const char* name);
+    NodePool(const NodePool&) = delete;
+
+    void* allocate(size_t size);
+    void deallocate(void* ptr, size_t size);
+
+    /// Number of allocations not yet freed
+    size_t live_count() const { return m_live_count; }
+
+    void dump_stats(::std::ostream& os) const;
+private:
+    void release_all();
+};
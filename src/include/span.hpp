@@ -10,6 +10,7 @@
 #include <rc_string.hpp>
 #include <functional>
 #include <memory>
+#include <cstdint>
 
 enum ErrorType
 {
@@ -29,9 +30,9 @@ struct ProtoSpan
     unsigned int start_line;
     unsigned int start_ofs;
 };
-struct Span
+/// Source map entry, referenced by index from `Span`
+struct SpanData
 {
-    ::std::shared_ptr<Span> outer_span; // Expansion target for macros
     RcString    filename;
 
     unsigned int start_line;
@@ -39,16 +40,41 @@ struct Span
     unsigned int end_line;
     unsigned int end_ofs;
 
-    Span(RcString filename, unsigned int start_line, unsigned int start_ofs,  unsigned int end_line, unsigned int end_ofs):
-        filename( ::std::move(filename) ),
-        start_line(start_line),
-        start_ofs(start_ofs),
-        end_line(end_line),
-        end_ofs(end_ofs)
-    {}
-    Span(const Span& x);
+    uint32_t    outer_idx;  // Expansion target for macros (0 = none)
+};
+/// Handle into the global source map
+///
+/// Copying a span is a single integer copy, the file/line information (and the macro expansion backtrace) lives in a
+/// global table that is never freed.
+struct Span
+{
+    /// Index into the global source map, 0 is the empty span
+    uint32_t    m_idx;
+
+    Span(RcString filename, unsigned int start_line, unsigned int start_ofs,  unsigned int end_line, unsigned int end_ofs);
+    Span(const Span& outer, RcString filename, unsigned int start_line, unsigned int start_ofs,  unsigned int end_line, unsigned int end_ofs);
+    Span(const Span& outer, const Position& position);
     Span(const Position& position);
-    Span();
+    Span(const Span& x) = default;
+    Span& operator=(const Span& x) = default;
+    Span():
+        m_idx(0)
+    {
+    }
+
+    bool is_empty() const { return m_idx == 0; }
+    const SpanData& data() const;
+
+    const RcString& filename() const { return data().filename; }
+    unsigned int start_line() const { return data().start_line; }
+    unsigned int start_ofs() const { return data().start_ofs; }
+    unsigned int end_line() const { return data().end_line; }
+    unsigned int end_ofs() const { return data().end_ofs; }
+    /// Span of the macro invocation this span was expanded from (empty if not from a macro)
+    Span outer_span() const;
+
+    /// Number of entries in the source map (for statistics)
+    static size_t source_map_size();
 
     void bug(::std::function<void(::std::ostream&)> msg) const;
     void error(ErrorType tag, ::std::function<void(::std::ostream&)> msg) const;
@@ -56,6 +82,8 @@ struct Span
     void note(::std::function<void(::std::ostream&)> msg) const;
 
     friend ::std::ostream& operator<<(::std::ostream& os, const Span& sp);
+private:
+    void print_backtrace(::std::ostream& os) const;
 };
 
 template<typename T>
@@ -577,7 +577,7 @@ class MacroExpander:
     const RcString  m_macro_filename;
 
     const ::std::string m_crate_name;
-    ::std::shared_ptr<Span> m_invocation_span;
+    Span    m_invocation_span;
 
     ParameterMappings m_mappings;
     MacroExpandState    m_state;
@@ -592,7 +592,7 @@ public:
     MacroExpander(const ::std::string& macro_name, const Span& sp, const Ident::Hygiene& parent_hygiene, const ::std::vector<MacroExpansionEnt>& contents, ParameterMappings mappings, ::std::string crate_name):
         m_macro_filename( FMT("Macro:" << macro_name) ),
         m_crate_name( mv$(crate_name) ),
-        m_invocation_span( new Span(sp) ),
+        m_invocation_span( sp ),
         m_mappings( mv$(mappings) ),
         m_state( contents, m_mappings ),
         m_hygiene( Ident::Hygiene::new_scope_chained(parent_hygiene) )
@@ -600,7 +600,7 @@ public:
     }
 
     Position getPosition() const override;
-    ::std::shared_ptr<Span> outerSpan() const override;
+    Span outerSpan() const override;
     Ident::Hygiene realGetHygiene() const override;
     Token realGetToken() override;
 };
@@ -2253,7 +2253,7 @@ Position MacroExpander::getPosition() const
     // TODO: Return the attached position of the last fetched token
     return Position(m_macro_filename, 0, m_state.top_pos());
 }
-::std::shared_ptr<Span> MacroExpander::outerSpan() const
+Span MacroExpander::outerSpan() const
 {
     return m_invocation_span;
 }
@@ -7,6 +7,7 @@
  */
 #include <iostream>
 #include <iomanip>
+#include <fstream>
 #include <string>
 #include <set>
 #include "parse/lex.hpp"
@@ -18,6 +19,7 @@
 #include <main_bindings.hpp>
 #include "resolve/main_bindings.hpp"
 #include "hir/main_bindings.hpp"
+#include "hir/serialise_lowlevel.hpp"
 #include "hir_conv/main_bindings.hpp"
 #include "hir_typeck/main_bindings.hpp"
 #include "hir_expand/main_bindings.hpp"
@@ -26,6 +28,12 @@
 #include "trans/target.hpp"
 
 #include "expand/cfg.hpp"
+#include <ast/expr.hpp>
+#include <hir/expr.hpp>
+
+#ifndef _WIN32
+# include <sys/resource.h>   // getrusage
+#endif
 
 // Hacky default target
 #ifdef _MSC_VER
@@ -84,6 +92,7 @@ void init_debug_list()
     g_debug_disable_map.insert( "MIR Validate Full Early" );
     g_debug_disable_map.insert( "Dump MIR" );
     g_debug_disable_map.insert( "Constant Evaluate Full" );
+    g_debug_disable_map.insert( "Free HIR Expressions" );
     g_debug_disable_map.insert( "MIR Cleanup" );
     g_debug_disable_map.insert( "MIR Optimise" );
     g_debug_disable_map.insert( "MIR Validate PO" );
@@ -122,10 +131,6 @@ bool debug_enabled_update() {
         return true;
     }
 }
-bool debug_enabled()
-{
-    return g_debug_enabled;
-}
 ::std::ostream& debug_output(int indent, const char* function)
 {
     return ::std::cout << g_cur_phase << "- " << RepeatLitStr { " ", indent } << function << ": ";
@@ -154,9 +159,12 @@ struct ProgramParams
 
     unsigned opt_level = 0;
     bool emit_debug_info = false;
+    bool enable_lto = false;
 
     bool test_harness = false;
 
+    ::HIR::serialise::CompressionOptions    hir_compression;
+
     ::std::vector<const char*> lib_search_dirs;
     ::std::vector<const char*> libraries;
     ::std::map<::std::string, ::std::string>    crate_overrides;    // --extern name=path
@@ -168,11 +176,49 @@ struct ProgramParams
         bool disable_mir_optimisations = false;
         bool full_validate = false;
         bool full_validate_early = false;
+        bool memory_report = false;
+        bool emulate_i128 = false;
+        bool emit_restrict = false;
+        bool flat_c = false;
+        bool no_enum_cache = false;
     } debug;
 
     ProgramParams(int argc, char *argv[]);
 };
 
+bool g_memory_report = false;
+struct MemoryUsage {
+    size_t  current_kb;
+    size_t  peak_kb;
+};
+MemoryUsage get_memory_usage()
+{
+    MemoryUsage rv { 0, 0 };
+#ifdef __linux__
+    // VmRSS is the current resident set, VmHWM is the peak
+    ::std::ifstream is("/proc/self/status");
+    ::std::string line;
+    while( ::std::getline(is, line) )
+    {
+        if( line.compare(0, 6, "VmRSS:") == 0 )
+            rv.current_kb = ::std::strtoul(line.c_str() + 6, nullptr, 10);
+        else if( line.compare(0, 6, "VmHWM:") == 0 )
+            rv.peak_kb = ::std::strtoul(line.c_str() + 6, nullptr, 10);
+    }
+#elif !defined(_WIN32)
+    struct rusage ru;
+    if( getrusage(RUSAGE_SELF, &ru) == 0 )
+    {
+    # ifdef __APPLE__
+        rv.peak_kb = ru.ru_maxrss / 1024;
+    # else
+        rv.peak_kb = ru.ru_maxrss;
+    # endif
+    }
+#endif
+    return rv;
+}
+
 template <typename Rv, typename Fcn>
 Rv CompilePhase(const char *name, Fcn f) {
     ::std::cout << name << ": V V V" << ::std::endl;
@@ -186,6 +232,14 @@ Rv CompilePhase(const char *name, Fcn f) {
 
     ::std::cout <<"(" << ::std::fixed << ::std::setprecision(2) << static_cast<double>(end - start) / static_cast<double>(CLOCKS_PER_SEC) << " s) ";
     ::std::cout << name << ": DONE";
+    if( g_memory_report )
+    {
+        auto mem = get_memory_usage();
+        ::std::cout << " [RSS " << (mem.current_kb + 1023) / 1024 << " MiB, peak " << (mem.peak_kb + 1023) / 1024 << " MiB"
+            << ", AST nodes " << ::AST::ExprNode::pool().live_count()
+            << ", HIR nodes " << ::HIR::ExprNode::pool().live_count()
+            << "]";
+    }
     ::std::cout << ::std::endl;
     return rv;
 }
@@ -199,6 +253,8 @@ int main(int argc, char *argv[])
 {
     init_debug_list();
     ProgramParams   params(argc, argv);
+    g_memory_report = params.debug.memory_report;
+    ::HIR::serialise::set_compression(params.hir_compression);
 
     // Set up cfg values
     Cfg_SetValue("rust_compiler", "mrustc");
@@ -206,6 +262,8 @@ int main(int argc, char *argv[])
         return params.features.count(s) != 0;
         });
     Target_SetCfg(params.target);
+    if( params.debug.emulate_i128 )
+        Target_ForceEmulatedI128();
 
 
     if( params.test_harness )
@@ -326,8 +384,10 @@ int main(int argc, char *argv[])
             if( crate.m_crate_type == ::AST::Crate::Type::Executable || params.test_harness )
             {
                 // TODO: Detect if an allocator crate is already present.
-                crate.load_extern_crate(Span(), "alloc_system");
-                crate.load_extern_crate(Span(), "panic_abort");
+                crate.load_extern_crates({
+                    ::AST::ExternCrateRequest { Span(), "alloc_system", "" },
+                    ::AST::ExternCrateRequest { Span(), "panic_abort", "" }
+                    });
 
                 // - `mrustc-main` lang item default
                 crate.m_lang_items.insert(::std::make_pair( ::std::string("mrustc-main"), ::AST::Path("", {AST::PathNode("main")}) ));
@@ -466,6 +526,10 @@ int main(int argc, char *argv[])
             ::std::ofstream os (FMT(params.outfile << "_2_hir.rs"));
             HIR_Dump( os, *hir_crate );
             });
+        // - Only MIR is used from here on (including for serialisation), release the HIR expression trees
+        CompilePhaseV("Free HIR Expressions", [&]() {
+            HIR_FreeExprTrees(*hir_crate);
+            });
 
         // - Expand constants in HIR and virtualise calls
         CompilePhaseV("MIR Cleanup", [&]() {
@@ -515,6 +579,11 @@ int main(int argc, char *argv[])
             hir_crate->m_ext_libs.push_back(::HIR::ExternLibrary { libname });
         }
         trans_opt.emit_debug_info = params.emit_debug_info;
+        trans_opt.enable_lto = params.enable_lto;
+        trans_opt.emit_restrict = params.debug.emit_restrict;
+        trans_opt.structured_c = !params.debug.flat_c;
+        // Enumeration of upstream generics, reused while the upstream crates are unchanged
+        ::std::string   enum_cache = params.debug.no_enum_cache ? "" : params.outfile + ".tenum";
 
         // Generate code for non-generic public items (if requested)
         if( params.test_harness )
@@ -530,7 +599,7 @@ int main(int argc, char *argv[])
         case ::AST::Crate::Type::RustLib: {
             #if 1
             // Generate a .o
-            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate); });
+            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate, enum_cache); });
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + ".o", trans_opt, *hir_crate, items, false); });
             #endif
 
@@ -545,7 +614,7 @@ int main(int argc, char *argv[])
         case ::AST::Crate::Type::RustDylib: {
             #if 1
             // Generate a .o
-            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate); });
+            TransList   items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Public(*hir_crate, enum_cache); });
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile + ".o", trans_opt, *hir_crate, items, false); });
             #endif
             // Save a loadable HIR dump
@@ -560,7 +629,7 @@ int main(int argc, char *argv[])
         case ::AST::Crate::Type::Executable:
             // Generate a binary
             // - Enumerate items for translation
-            TransList items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Main(*hir_crate); });
+            TransList items = CompilePhase<TransList>("Trans Enumerate", [&]() { return Trans_Enumerate_Main(*hir_crate, enum_cache); });
             // - Perform codegen
             CompilePhaseV("Trans Codegen", [&]() { Trans_Codegen(params.outfile, trans_opt, *hir_crate, items, true); });
             // - Invoke linker?
@@ -659,6 +728,28 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                 else if( optname == "full-validate-early" ) {
                     this->debug.full_validate_early = true;
                 }
+                else if( optname == "memory-report" ) {
+                    this->debug.memory_report = true;
+                }
+                else if( optname == "emulate-i128" ) {
+                    this->debug.emulate_i128 = true;
+                }
+                else if( optname == "emit-restrict" ) {
+                    this->debug.emit_restrict = true;
+                }
+                else if( optname == "flat-c" ) {
+                    this->debug.flat_c = true;
+                }
+                else if( optname == "no-enum-cache" ) {
+                    this->debug.no_enum_cache = true;
+                }
+                // `-Z hir-compression=<none|fast|best|deflate:N>` - Codec/level used for the output metadata
+                else if( optname.compare(0, 16, "hir-compression=") == 0 ) {
+                    if( !::HIR::serialise::parse_compression(optname.substr(16), this->hir_compression) ) {
+                        ::std::cerr << "Unknown HIR compression '" << optname.substr(16) << "', expected none, fast, best, or deflate:<1-9>" << ::std::endl;
+                        exit(1);
+                    }
+                }
                 else {
                     ::std::cerr << "Unknown debug option: '" << optname << "'" << ::std::endl;
                     exit(1);
@@ -798,6 +889,10 @@ ProgramParams::ProgramParams(int argc, char *argv[])
                     Cfg_SetFlag(opt_and_val);
                 }
             }
+            // `--lto`   - Emit objects for link-time optimisation (must be passed to every crate, including the executable)
+            else if( strcmp(arg, "--lto") == 0 ) {
+                this->enable_lto = true;
+            }
             // `--target <triple>`  - Override the default compiler target
             else if( strcmp(arg, "--target") == 0 ) {
                 if (i == argc - 1) {
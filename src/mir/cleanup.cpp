@@ -219,6 +219,15 @@ const ::HIR::Literal* MIR_Cleanup_GetConstant(const Span& sp, const StaticTraitR
         return ::MIR::RValue::make_Tuple({ mv$(lvals) });
         ),
     (Array,
+        if( const auto* pe = lit.opt_Packed() )
+        {
+            // MIR needs a value per entry, so expand back into a list
+            ::std::vector< ::HIR::Literal>  vals;
+            vals.reserve( pe->size() );
+            for(size_t i = 0; i < pe->size(); i ++)
+                vals.push_back( ::HIR::Literal(pe->get(i)) );
+            return MIR_Cleanup_LiteralToRValue(state, mutator, ::HIR::Literal(mv$(vals)), mv$(ty), mv$(path));
+        }
         MIR_ASSERT(state, lit.is_List(), "Non-list literal for Array - " << lit);
         const auto& vals = lit.as_List();
 
@@ -407,8 +416,8 @@ const ::HIR::Literal* MIR_Cleanup_GetConstant(const Span& sp, const StaticTraitR
             // 2. Borrow that slot
             if( const auto* tie = te.inner->m_data.opt_Slice() )
             {
-                MIR_ASSERT(state, inner_lit.is_List(), "BorrowData of non-list resulting in &[T]");
-                auto size = inner_lit.as_List().size();
+                MIR_ASSERT(state, inner_lit.is_List() || inner_lit.is_Packed(), "BorrowData of non-list resulting in &[T]");
+                auto size = inner_lit.is_Packed() ? inner_lit.as_Packed().size() : inner_lit.as_List().size();
                 auto inner_ty = ::HIR::TypeRef::new_array(tie->inner->clone(), size);
                 auto size_val = ::MIR::Param( ::MIR::Constant::make_Uint({ size, ::HIR::CoreType::Usize }) );
                 auto ptr_ty = ::HIR::TypeRef::new_borrow(te.type, inner_ty.clone());
@@ -1769,7 +1769,7 @@ namespace {
             {
                 const auto& gpath = node.m_path.m_data.as_Generic();
                 const auto& fcn = m_builder.crate().get_function_by_path(node.span(), gpath.m_path);
-                if( fcn.m_abi == "rust-intrinsic" )
+                if( fcn.m_abi == "rust-intrinsic" || fcn.m_abi == "platform-intrinsic" )
                 {
                     m_builder.end_block(::MIR::Terminator::make_Call({
                         next_block, panic_block,
@@ -2345,3 +2345,27 @@ void HIR_GenerateMIR(::HIR::Crate& crate)
     ov.visit_crate(crate);
 }
 
+void HIR_FreeExprTrees(::HIR::Crate& crate)
+{
+    // Once MIR exists (and constants have been evaluated) nothing reads the HIR expression nodes, so release them.
+    // - The root is replaced with an empty placeholder (instead of being cleared) so `ExprPtr`'s bool conversion (used
+    //   to check for a function body) and `->span()` remain valid. Block roots stay blocks, as MIR Optimise uses that
+    //   to tell function bodies from constant initialisers.
+    ::MIR::OuterVisitor    ov { crate, [&](const auto& res, const auto& p, auto& expr_ptr, const auto& args, const auto& ty){
+            if( !expr_ptr.m_mir )
+                return ;
+            auto sp = expr_ptr->span();
+            if( auto* root = dynamic_cast< ::HIR::ExprNode_Block*>(expr_ptr.get()) )
+            {
+                if( root->m_nodes.empty() && !root->m_value_node )
+                    return ;
+                expr_ptr.reset( new ::HIR::ExprNode_Block(sp) );
+            }
+            else
+            {
+                expr_ptr.reset( new ::HIR::ExprNode_Tuple(sp, {}) );
+            }
+        } };
+    ov.visit_crate(crate);
+}
+
@@ -687,6 +687,17 @@ void PatternRulesetBuilder::append_from_lit(const Span& sp, const ::HIR::Literal
 {
     TRACE_FUNCTION_F("lit="<<lit<<", ty="<<ty<<",   m_field_path=[" << m_field_path << "]");
 
+    if( const auto* pe = lit.opt_Packed() )
+    {
+        // Rules are per-entry, so expand back into a list
+        ::std::vector< ::HIR::Literal>  vals;
+        vals.reserve( pe->size() );
+        for(size_t i = 0; i < pe->size(); i ++)
+            vals.push_back( ::HIR::Literal(pe->get(i)) );
+        this->append_from_lit(sp, ::HIR::Literal(mv$(vals)), ty);
+        return ;
+    }
+
     TU_MATCHA( (ty.m_data), (e),
     (Infer,   BUG(sp, "Ivar for in match type"); ),
     (Diverge, BUG(sp, "Diverge in match type");  ),
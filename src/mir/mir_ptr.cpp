@@ -7,11 +7,90 @@
  */
 #include "mir_ptr.hpp"
 #include "mir.hpp"
+#include <mutex>
+#include <unordered_map>
 
+namespace {
+    // Placeholders that haven't been filled yet, and the loader that will fill them
+    // - Locked because crates (and so placeholders) can be deserialised in parallel
+    // - Never freed, placeholders can outlive static destructors
+    ::std::mutex    s_pending_lock;
+    auto& s_pending = *new ::std::unordered_map< ::MIR::Function*, ::std::shared_ptr< ::MIR::LazyLoader> >();
+    auto& s_load_hook = *new ::std::function<void(::MIR::Function&)>();
+
+    bool take_pending(::MIR::Function* placeholder, const ::MIR::LazyLoader* loader)
+    {
+        ::std::lock_guard< ::std::mutex>    lh { s_pending_lock };
+        auto it = s_pending.find(placeholder);
+        if( it == s_pending.end() )
+            return false;
+        // A dropped placeholder's address may have been reused by another loader's placeholder
+        if( loader && it->second.get() != loader )
+            return false;
+        s_pending.erase(it);
+        return true;
+    }
+}
+
+::MIR::LazyLoader::~LazyLoader()
+{
+}
+
+::MIR::FunctionPointer MIR::FunctionPointer::new_pending(::std::shared_ptr<LazyLoader> loader, ::MIR::Function*& out_placeholder)
+{
+    FunctionPointer rv { new ::MIR::Function() };
+    rv.m_pending = true;
+    out_placeholder = rv.ptr;
+    ::std::lock_guard< ::std::mutex>    lh { s_pending_lock };
+    s_pending.insert( ::std::make_pair(rv.ptr, ::std::move(loader)) );
+    return rv;
+}
+bool MIR::FunctionPointer::fill_pending(::MIR::Function* placeholder, const LazyLoader* loader, ::MIR::Function&& value)
+{
+    if( !take_pending(placeholder, loader) )
+        return false;
+    *placeholder = ::std::move(value);
+    if( s_load_hook )
+        s_load_hook(*placeholder);
+    return true;
+}
+void MIR::FunctionPointer::set_load_hook(::std::function<void(::MIR::Function&)> hook)
+{
+    s_load_hook = ::std::move(hook);
+}
+bool MIR::FunctionPointer::is_pending() const
+{
+    if( m_pending )
+    {
+        ::std::lock_guard< ::std::mutex>    lh { s_pending_lock };
+        if( s_pending.count(this->ptr) == 0 )
+            m_pending = false;
+    }
+    return m_pending;
+}
+
+void ::MIR::FunctionPointer::load_pending() const
+{
+    m_pending = false;
+    ::std::shared_ptr<LazyLoader>   loader;
+    {
+        ::std::lock_guard< ::std::mutex>    lh { s_pending_lock };
+        auto it = s_pending.find(this->ptr);
+        if( it == s_pending.end() )
+            return ;
+        loader = it->second;
+    }
+    // Fills (and stops tracking) every placeholder of this loader, including this one
+    loader->load();
+}
 
 void ::MIR::FunctionPointer::reset()
 {
     if( this->ptr ) {
+        if( m_pending ) {
+            take_pending(this->ptr, nullptr);
+            m_pending = false;
+        }
         delete this->ptr;
         this->ptr = nullptr;
     }
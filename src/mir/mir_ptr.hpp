@@ -8,17 +8,33 @@
 #pragma once
 
 
+#include <memory>
+#include <functional>
+
 namespace MIR {
 
 class Function;
 
+/// Source of MIR bodies that are only read when first used (e.g. a crate's MIR metadata section)
+class LazyLoader
+{
+public:
+    virtual ~LazyLoader();
+    /// Fill every placeholder created for this loader (see `FunctionPointer::new_pending`)
+    virtual void load() = 0;
+};
+
 class FunctionPointer
 {
     ::MIR::Function*    ptr;
+    // Set if `ptr` may still be an empty placeholder (cleared on first access)
+    mutable bool    m_pending;
+
+    void load_pending() const;
 public:
-    FunctionPointer(): ptr(nullptr) {}
-    FunctionPointer(::MIR::Function* p): ptr(p) {}
-    FunctionPointer(FunctionPointer&& x): ptr(x.ptr) { x.ptr = nullptr; }
+    FunctionPointer(): ptr(nullptr), m_pending(false) {}
+    FunctionPointer(::MIR::Function* p): ptr(p), m_pending(false) {}
+    FunctionPointer(FunctionPointer&& x): ptr(x.ptr), m_pending(x.m_pending) { x.ptr = nullptr; x.m_pending = false; }
 
     ~FunctionPointer() {
         reset();
@@ -26,16 +42,29 @@ public:
     FunctionPointer& operator=(FunctionPointer&& x) {
         reset();
         ptr = x.ptr;
+        m_pending = x.m_pending;
         x.ptr = nullptr;
+        x.m_pending = false;
         return *this;
     }
 
+    /// Create a placeholder (returned in `out_placeholder`) for `loader` to fill
+    /// - The first access through any of a loader's placeholders calls `loader->load()`
+    static FunctionPointer new_pending(::std::shared_ptr<LazyLoader> loader, ::MIR::Function*& out_placeholder);
+    /// Used by loaders: moves `value` into the placeholder if it is still waiting on `loader` (returns false if it was dropped)
+    static bool fill_pending(::MIR::Function* placeholder, const LazyLoader* loader, ::MIR::Function&& value);
+    /// Set the function applied to every body filled by `fill_pending` (e.g. binding paths to the current crate)
+    static void set_load_hook(::std::function<void(::MIR::Function&)> hook);
+
+    /// True if the body hasn't been loaded yet (does not trigger a load)
+    bool is_pending() const;
+
     void reset();
 
-    ::MIR::Function* operator->() { return ptr; }
-    ::MIR::Function& operator*() { return *ptr; }
-    const ::MIR::Function* operator->() const { return ptr; }
-    const ::MIR::Function& operator*() const { return *ptr; }
+    ::MIR::Function* operator->() { if(m_pending) load_pending(); return ptr; }
+    ::MIR::Function& operator*() { if(m_pending) load_pending(); return *ptr; }
+    const ::MIR::Function* operator->() const { if(m_pending) load_pending(); return ptr; }
+    const ::MIR::Function& operator*() const { if(m_pending) load_pending(); return *ptr; }
 
     operator bool() const { return ptr != nullptr; }
 };
@@ -492,7 +492,9 @@ bool MIR_Optimise_PropagateKnownValues(::MIR::TypeResolve& state, ::MIR::Functio
 bool MIR_Optimise_UnifyTemporaries(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_UnifyBlocks(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_ConstPropagte(::MIR::TypeResolve& state, ::MIR::Function& fcn);
+bool MIR_Optimise_NoopDrops(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_DeadDropFlags(::MIR::TypeResolve& state, ::MIR::Function& fcn);
+bool MIR_Optimise_ConstantDropFlags(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_GarbageCollect_Partial(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 bool MIR_Optimise_GarbageCollect(::MIR::TypeResolve& state, ::MIR::Function& fcn);
 
@@ -582,8 +584,12 @@ void MIR_Optimise(const StaticTraitResolve& resolve, const ::HIR::ItemPath& path
 
         // >> Combine Duplicate Blocks
         change_happened |= MIR_Optimise_UnifyBlocks(state, fcn);
+        // >> Remove drops of types without drop glue (leaves their flags unused)
+        change_happened |= MIR_Optimise_NoopDrops(state, fcn);
         // >> Remove assignments of unsed drop flags
         change_happened |= MIR_Optimise_DeadDropFlags(state, fcn);
+        // >> Remove drop flags that never change from their initial value
+        change_happened |= MIR_Optimise_ConstantDropFlags(state, fcn);
 
         #if CHECK_AFTER_ALL
         MIR_Validate(resolve, path, fcn, args, ret_type);
@@ -1687,7 +1693,7 @@ bool MIR_Optimise_ConstPropagte(::MIR::TypeResolve& state, ::MIR::Function& fcn)
         if( tef.name == "size_of" )
         {
             size_t size_val = 0;
-            if( Target_GetSizeOf(state.sp, tef.params.m_types.at(0), size_val) )
+            if( Target_GetSizeOf(state.sp, state.m_resolve, tef.params.m_types.at(0), size_val) )
             {
                 auto val = ::MIR::Constant::make_Uint({ size_val, ::HIR::CoreType::Usize });
                 bb.statements.push_back(::MIR::Statement::make_Assign({ mv$(te.ret_val), mv$(val) }));
@@ -1698,7 +1704,7 @@ bool MIR_Optimise_ConstPropagte(::MIR::TypeResolve& state, ::MIR::Function& fcn)
         else if( tef.name == "align_of" )
         {
             size_t align_val = 0;
-            if( Target_GetAlignOf(state.sp, tef.params.m_types.at(0), align_val) )
+            if( Target_GetAlignOf(state.sp, state.m_resolve, tef.params.m_types.at(0), align_val) )
             {
                 auto val = ::MIR::Constant::make_Uint({ align_val, ::HIR::CoreType::Usize });
                 bb.statements.push_back(::MIR::Statement::make_Assign({ mv$(te.ret_val), mv$(val) }));
@@ -2551,6 +2557,34 @@ bool MIR_Optimise_PropagateSingleAssignments(::MIR::TypeResolve& state, ::MIR::F
     return replacement_happend;
 }
 
+// ----------------------------------------
+// Remove deep drops of types that have no drop glue
+// ----------------------------------------
+bool MIR_Optimise_NoopDrops(::MIR::TypeResolve& state, ::MIR::Function& fcn)
+{
+    bool removed_statement = false;
+    for(auto& block : fcn.blocks)
+    {
+        for(auto it = block.statements.begin(); it != block.statements.end(); )
+        {
+            if( const auto* e = it->opt_Drop() )
+            {
+                ::HIR::TypeRef  tmp;
+                // NOTE: Generic/erased types always report as needing glue, so this only fires once the type is known
+                if( e->kind == ::MIR::eDropKind::DEEP && !state.m_resolve.type_needs_drop_glue(state.sp, state.get_lvalue_type(tmp, e->slot)) )
+                {
+                    DEBUG("Remove no-op drop of " << e->slot);
+                    removed_statement = true;
+                    it = block.statements.erase(it);
+                    continue ;
+                }
+            }
+            ++ it;
+        }
+    }
+    return removed_statement;
+}
+
 // ----------------------------------------
 // Clear all drop flags that are never read
 // ----------------------------------------
@@ -2591,6 +2625,77 @@ bool MIR_Optimise_DeadDropFlags(::MIR::TypeResolve& state, ::MIR::Function& fcn)
 }
 
 
+// ----------------------------------------
+// Remove drop flags that always hold their initial value
+// ----------------------------------------
+bool MIR_Optimise_ConstantDropFlags(::MIR::TypeResolve& state, ::MIR::Function& fcn)
+{
+    // Optimistically assume every flag is constant, then clear flags that are set to anything else.
+    ::std::vector<bool> is_constant( fcn.drop_flags.size(), true );
+    for(bool changed = true; changed; )
+    {
+        changed = false;
+        for(const auto& block : fcn.blocks)
+        {
+            for(const auto& stmt : block.statements)
+            {
+                const auto* e = stmt.opt_SetDropFlag();
+                if( !e || !is_constant[e->idx] )
+                    continue ;
+                bool is_same;
+                if( e->other == ~0u )
+                    is_same = (e->new_val == fcn.drop_flags[e->idx]);
+                else
+                    is_same = is_constant[e->other] && (e->new_val != fcn.drop_flags[e->other]) == fcn.drop_flags[e->idx];
+                if( !is_same )
+                {
+                    is_constant[e->idx] = false;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    bool rv = false;
+    for(auto& block : fcn.blocks)
+    {
+        for(auto it = block.statements.begin(); it != block.statements.end(); )
+        {
+            if( auto* e = it->opt_SetDropFlag() )
+            {
+                if( is_constant[e->idx] ) {
+                    DEBUG(state << "Remove " << *it << " - df" << e->idx << " is always " << fcn.drop_flags[e->idx]);
+                    it = block.statements.erase(it);
+                    rv = true;
+                    continue ;
+                }
+                if( e->other != ~0u && is_constant[e->other] ) {
+                    e->new_val = (e->new_val != fcn.drop_flags[e->other]);
+                    e->other = ~0u;
+                    rv = true;
+                }
+            }
+            else if( auto* e = it->opt_Drop() )
+            {
+                if( e->flag_idx != ~0u && is_constant[e->flag_idx] ) {
+                    rv = true;
+                    if( fcn.drop_flags[e->flag_idx] ) {
+                        e->flag_idx = ~0u;
+                    }
+                    else {
+                        DEBUG(state << "Remove " << *it << " - flag is never set");
+                        it = block.statements.erase(it);
+                        continue ;
+                    }
+                }
+            }
+            ++ it;
+        }
+    }
+    return rv;
+}
+
+
 // --------------------------------------------------------------------
 // Clear all unused blocks
 // --------------------------------------------------------------------
@@ -0,0 +1,96 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * node_pool.cpp
+ * - Pooled allocation for tree nodes (expression nodes)
+ */
+#include <node_pool.hpp>
+#include <new>
+#include <ostream>
+
+NodePool::NodePool(const char* name):
+    m_name(name),
+    m_free_lists(),
+    m_cur(nullptr),
+    m_end(nullptr),
+    m_live_count(0),
+    m_peak_bytes(0),
+    m_cur_bytes(0)
+{
+}
+
+void* NodePool::allocate(size_t size)
+{
+    if( size > MAX_POOLED_SIZE )
+    {
+        m_live_count ++;
+        return ::operator new(size);
+    }
+    size_t cls = (size + GRANULE - 1) / GRANULE - 1;
+    size_t rounded = (cls + 1) * GRANULE;
+
+    m_live_count ++;
+    m_cur_bytes += rounded;
+    if( m_cur_bytes > m_peak_bytes )
+        m_peak_bytes = m_cur_bytes;
+
+    // Re-use a freed slot of the same size if there is one
+    if( m_free_lists[cls] )
+    {
+        void* rv = m_free_lists[cls];
+        m_free_lists[cls] = *reinterpret_cast<void**>(rv);
+        return rv;
+    }
+
+    if( m_cur == nullptr || static_cast<size_t>(m_end - m_cur) < rounded )
+    {
+        // NOTE: The tail of the previous chunk is discarded, it's at most MAX_POOLED_SIZE bytes.
+        m_cur = static_cast<char*>( ::operator new(CHUNK_SIZE) );
+        m_end = m_cur + CHUNK_SIZE;
+        m_chunks.push_back(m_cur);
+    }
+    void* rv = m_cur;
+    m_cur += rounded;
+    return rv;
+}
+void NodePool::deallocate(void* ptr, size_t size)
+{
+    if( !ptr )
+        return ;
+    m_live_count --;
+    if( size > MAX_POOLED_SIZE )
+    {
+        ::operator delete(ptr);
+    }
+    else
+    {
+        size_t cls = (size + GRANULE - 1) / GRANULE - 1;
+        m_cur_bytes -= (cls + 1) * GRANULE;
+        *reinterpret_cast<void**>(ptr) = m_free_lists[cls];
+        m_free_lists[cls] = ptr;
+    }
+
+    if( m_live_count == 0 )
+    {
+        this->release_all();
+    }
+}
+
+void NodePool::release_all()
+{
+    for(auto p : m_chunks)
+        ::operator delete(p);
+    m_chunks.clear();
+    m_chunks.shrink_to_fit();
+    for(auto& fl : m_free_lists)
+        fl = nullptr;
+    m_cur = nullptr;
+    m_end = nullptr;
+}
+
+void NodePool::dump_stats(::std::ostream& os) const
+{
+    os << m_name << ": " << m_live_count << " live, " << (m_cur_bytes + 1023) / 1024 << "KiB in use (peak " << (m_peak_bytes + 1023) / 1024 << "KiB), "
+        << m_chunks.size() << " chunks" << ::std::endl;
+}
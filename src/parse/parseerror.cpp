@@ -59,7 +59,7 @@ ParseError::Unexpected::Unexpected(const TokenStream& lex, const Token& tok)//:
 //    m_tok( mv$(tok) )
 {
     Span pos = tok.get_pos();
-    if(pos.filename == "")
+    if(pos.filename() == "")
         pos = lex.point_span();
     ::std::cout << pos << ": Unexpected(" << tok << ")" << ::std::endl;
 }
@@ -67,14 +67,14 @@ ParseError::Unexpected::Unexpected(const TokenStream& lex, const Token& tok, Tok
 //    m_tok( mv$(tok) )
 {
     Span pos = tok.get_pos();
-    if(pos.filename == "")
+    if(pos.filename() == "")
         pos = lex.point_span();
     ::std::cout << pos << ": Unexpected(" << tok << ", " << exp << ")" << ::std::endl;
 }
 ParseError::Unexpected::Unexpected(const TokenStream& lex, const Token& tok, ::std::vector<eTokenType> exp)
 {
     Span pos = tok.get_pos();
-    if(pos.filename == "")
+    if(pos.filename() == "")
         pos = lex.point_span();
     ::std::cout << pos << ": Unexpected " << tok << ", expected ";
     bool f = true;
@@ -7,60 +7,98 @@
  */
 #include <functional>
 #include <iostream>
+#include <deque>
 #include <span.hpp>
 #include <parse/lex.hpp>
 #include <common.hpp>
 
-Span::Span(const Span& x):
-    outer_span(x.outer_span),
-    filename(x.filename),
-    start_line(x.start_line),
-    start_ofs(x.start_ofs),
-    end_line(x.end_line),
-    end_ofs(x.end_ofs)
+namespace {
+    ::std::deque<SpanData>& source_map() {
+        // NOTE: A deque is used so references returned by `Span::data` stay valid as new spans are added
+        static ::std::deque<SpanData> s_map { SpanData { RcString(""), 0,0, 0,0, 0 } };
+        return s_map;
+    }
+    uint32_t source_map_add(RcString filename, unsigned int start_line, unsigned int start_ofs,  unsigned int end_line, unsigned int end_ofs, uint32_t outer_idx)
+    {
+        auto& map = source_map();
+        // Spans are often re-created for the same position (e.g. multiple `point_span` calls without consuming a
+        // token), so check against the most recent entry before adding a new one.
+        const auto& last = map.back();
+        if( last.start_line == start_line && last.start_ofs == start_ofs && last.end_line == end_line && last.end_ofs == end_ofs
+            && last.outer_idx == outer_idx && last.filename.c_str() == filename.c_str() )
+        {
+            return map.size() - 1;
+        }
+        map.push_back(SpanData { ::std::move(filename), start_line, start_ofs, end_line, end_ofs, outer_idx });
+        return map.size() - 1;
+    }
+}
+
+Span::Span(RcString filename, unsigned int start_line, unsigned int start_ofs,  unsigned int end_line, unsigned int end_ofs):
+    m_idx( source_map_add(::std::move(filename), start_line, start_ofs, end_line, end_ofs, 0) )
+{
+}
+Span::Span(const Span& outer, RcString filename, unsigned int start_line, unsigned int start_ofs,  unsigned int end_line, unsigned int end_ofs):
+    m_idx( source_map_add(::std::move(filename), start_line, start_ofs, end_line, end_ofs, outer.m_idx) )
+{
+}
+Span::Span(const Span& outer, const Position& pos):
+    Span(outer, pos.filename, pos.line, pos.ofs, pos.line, pos.ofs)
 {
 }
 Span::Span(const Position& pos):
-    outer_span(),
-    filename(pos.filename),
-    start_line(pos.line),
-    start_ofs(pos.ofs),
-    end_line(pos.line),
-    end_ofs(pos.ofs)
+    Span(pos.filename, pos.line, pos.ofs, pos.line, pos.ofs)
+{
+}
+
+const SpanData& Span::data() const
+{
+    return source_map()[m_idx];
+}
+Span Span::outer_span() const
 {
+    Span rv;
+    rv.m_idx = this->data().outer_idx;
+    return rv;
 }
-Span::Span():
-    outer_span(),
-    filename("")/*,
-    start_line(0), start_ofs(0),
-    end_line(0), end_ofs(0) // */
+size_t Span::source_map_size()
+{
+    return source_map().size();
+}
+
+void Span::print_backtrace(::std::ostream& os) const
 {
-    DEBUG("Empty span");
-    //filename = FMT(":" << __builtin_return_address(0));
+    for(auto idx = this->data().outer_idx; idx != 0; idx = source_map()[idx].outer_idx)
+    {
+        const auto& e = source_map()[idx];
+        os << e.filename << ":" << e.start_line << ": note: in expansion from here" << ::std::endl;
+    }
 }
 
 void Span::bug(::std::function<void(::std::ostream&)> msg) const
 {
-    ::std::cerr << this->filename << ":" << this->start_line << ": BUG:";
+    ::std::cerr << this->filename() << ":" << this->start_line() << ": BUG:";
     msg(::std::cerr);
     ::std::cerr << ::std::endl;
+    this->print_backtrace(::std::cerr);
     abort();
 }
 
 void Span::error(ErrorType tag, ::std::function<void(::std::ostream&)> msg) const {
-    ::std::cerr << this->filename << ":" << this->start_line << ": error:" << tag <<":";
+    ::std::cerr << this->filename() << ":" << this->start_line() << ": error:" << tag <<":";
     msg(::std::cerr);
     ::std::cerr << ::std::endl;
+    this->print_backtrace(::std::cerr);
     abort();
 }
 void Span::warning(WarningType tag, ::std::function<void(::std::ostream&)> msg) const {
-    ::std::cerr << this->filename << ":" << this->start_line << ": warning:" << tag << ":";
+    ::std::cerr << this->filename() << ":" << this->start_line() << ": warning:" << tag << ":";
     msg(::std::cerr);
     ::std::cerr << ::std::endl;
     //abort();
 }
 void Span::note(::std::function<void(::std::ostream&)> msg) const {
-    ::std::cerr << this->filename << ":" << this->start_line << ": note:";
+    ::std::cerr << this->filename() << ":" << this->start_line() << ": note:";
     msg(::std::cerr);
     ::std::cerr << ::std::endl;
     //abort();
@@ -68,6 +106,6 @@ void Span::note(::std::function<void(::std::ostream&)> msg) const {
 
 ::std::ostream& operator<<(::std::ostream& os, const Span& sp)
 {
-    os << sp.filename << ":" << sp.start_line;
+    os << sp.filename() << ":" << sp.start_line();
     return os;
 }
@@ -18,7 +18,7 @@
 void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const ::HIR::Crate& crate, const TransList& list, bool is_executable)
 {
     static Span sp;
-    auto codegen = Trans_Codegen_GetGeneratorC(crate, outfile);
+    auto codegen = Trans_Codegen_GetGeneratorC(crate, outfile, opt);
 
     // 1. Emit structure/type definitions.
     // - Emit in the order they're needed.
@@ -89,13 +89,17 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
         assert( ent.second->ptr );
         const auto& fcn = *ent.second->ptr;
         bool is_extern = ! static_cast<bool>(fcn.m_code);
-        if( fcn.m_code.m_mir ) {
+        if( ent.second->upstream ) {
+            // Defined by an upstream object
+            codegen->emit_function_ext(ent.first, fcn, ent.second->pp);
+        }
+        else if( fcn.m_code.m_mir ) {
             codegen->emit_function_proto(ent.first, fcn, ent.second->pp, is_extern);
         }
         else {
             // TODO: Why would an intrinsic be in the queue?
             // - If it's exported it does.
-            if( fcn.m_abi == "rust-intrinsic" ) {
+            if( fcn.m_abi == "rust-intrinsic" || fcn.m_abi == "platform-intrinsic" ) {
             }
             else {
                 codegen->emit_function_ext(ent.first, fcn, ent.second->pp);
@@ -143,7 +147,7 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
     // 4. Emit function code
     for(const auto& ent : list.m_functions)
     {
-        if( ent.second->ptr && ent.second->ptr->m_code.m_mir )
+        if( ent.second->ptr && ent.second->ptr->m_code.m_mir && !ent.second->upstream )
         {
             const auto& path = ent.first;
             const auto& fcn = *ent.second->ptr;
@@ -167,8 +171,7 @@ void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const
                 MIR_Cleanup(resolve, ip, *mir, args, ret_type);
                 MIR_Optimise(resolve, ip, *mir, args, ret_type);
                 MIR_Validate(resolve, ip, *mir, args, ret_type);
-                // TODO: Flag that this should be a weak (or weak-er) symbol?
-                // - If it's from an external crate, it should be weak
+                // NOTE: If it's from an external crate, it's static (or weak if exported, see codegen_c)
                 codegen->emit_function_code(path, fcn, ent.second->pp, is_extern,  mir);
             }
             // TODO: Detect if the function was a #[inline] function from another crate, and don't emit if that is the case?
@@ -9,6 +9,7 @@
 #include "mangling.hpp"
 #include <fstream>
 #include <algorithm>
+#include <set>
 #include <cmath>
 #include <hir/hir.hpp>
 #include <mir/mir.hpp>
@@ -130,13 +131,30 @@ namespace {
         struct {
             bool emulated_i128 = false;
             bool disallow_empty_structs = false;
+            bool emit_restrict = false;
+            bool structured_c = true;
         } m_options;
 
-        ::std::map<::HIR::GenericPath, ::std::vector<unsigned>> m_enum_repr_cache;
-
         ::std::vector< ::std::pair< ::HIR::GenericPath, const ::HIR::Struct*> >   m_box_glue_todo;
+
+        // Vtables and drop glue already defined by upstream objects (see `HIR::Crate::m_exported_glue`)
+        ::std::set< ::std::string>  m_upstream_glue;
+        // Upstream functions that this crate re-exports (as weak symbols, see `HIR::Crate::m_exported_instances`)
+        ::std::set< ::std::string>  m_exported_instances;
+        unsigned int    m_reused_vtables = 0;
+        unsigned int    m_reused_glue = 0;
+
+        // Per-function state for locals that aren't declared at the top of the function
+        // - Assignments to single-use temporaries, emitted as an expression at the use
+        ::std::set<const ::MIR::Statement*> m_inline_defs;
+        // - Locals only ever used as inline temporaries (never declared)
+        ::std::vector<bool> m_local_is_inline;
+        // - Value of an inline temporary between its definition and its use
+        ::std::vector<const ::MIR::RValue*> m_inline_pending;
+        // - Locals declared at the start of a nested block (keyed by the node emitted within the braces)
+        ::std::map<const Node*, ::std::vector<unsigned>>    m_scope_locals;
     public:
-        CodeGenerator_C(const ::HIR::Crate& crate, const ::std::string& outfile):
+        CodeGenerator_C(const ::HIR::Crate& crate, const ::std::string& outfile, const TransOptions& opt):
             m_crate(crate),
             m_resolve(crate),
             m_outfile_path(outfile),
@@ -147,14 +165,23 @@ namespace {
             {
             case CodegenMode::Gnu11:
                 m_compiler = Compiler::Gcc;
-                m_options.emulated_i128 = false;
                 break;
             case CodegenMode::Msvc:
                 m_compiler = Compiler::Msvc;
-                m_options.emulated_i128 = true;
                 m_options.disallow_empty_structs = true;
                 break;
             }
+            m_options.emulated_i128 = Target_EmulatesI128();
+            m_options.emit_restrict = opt.emit_restrict;
+            m_options.structured_c = opt.structured_c;
+
+            // Upstream glue is only linkable when it was emitted as a (weak) global
+            if( m_compiler == Compiler::Gcc )
+            {
+                for(const auto& ec : m_crate.m_ext_crates)
+                    m_upstream_glue.insert( ec.second.m_data->m_exported_glue.begin(), ec.second.m_data->m_exported_glue.end() );
+                m_exported_instances.insert( m_crate.m_exported_instances.begin(), m_crate.m_exported_instances.end() );
+            }
 
             m_of
                 << "/*\n"
@@ -208,9 +235,14 @@ namespace {
             switch(m_compiler)
             {
             case Compiler::Gcc:
+                if( !m_options.emulated_i128 )
+                {
+                    m_of
+                        << "typedef unsigned __int128 uint128_t;\n"
+                        << "typedef signed __int128 int128_t;\n"
+                        ;
+                }
                 m_of
-                    << "typedef unsigned __int128 uint128_t;\n"
-                    << "typedef signed __int128 int128_t;\n"
                     << "extern void _Unwind_Resume(void) __attribute__((noreturn));\n"
                     << "#define ALIGNOF(t) __alignof__(t)\n"
                     ;
@@ -242,32 +274,58 @@ namespace {
 
             if( m_options.emulated_i128 )
             {
+                // Two-word fallback, used when the C compiler has no 128-bit integer type
                 m_of
                     << "typedef struct { uint64_t lo, hi; } uint128_t;\n"
                     << "typedef struct { uint64_t lo, hi; } int128_t;\n"
-                    << "static inline int128_t make128s(int64_t v) { int128_t rv = { v, (v < 0 ? -1 : 0) }; return rv; }\n"
-                    << "static inline int128_t add128s(int128_t a, int128_t b) { int128_t v; v.lo = a.lo + b.lo; v.hi = a.hi + b.hi + (v.lo < a.lo ? 1 : 0); return v; }\n"
-                    << "static inline int128_t sub128s(int128_t a, int128_t b) { int128_t v; v.lo = a.lo - b.lo; v.hi = a.hi - b.hi - (v.lo > a.lo ? 1 : 0); return v; }\n"
-                    << "static inline int128_t mul128s(int128_t a, int128_t b) { abort(); }\n"
-                    << "static inline int128_t div128s(int128_t a, int128_t b) { abort(); }\n"
-                    << "static inline int128_t mod128s(int128_t a, int128_t b) { abort(); }\n"
-                    << "static inline int128_t and128s(int128_t a, int128_t b) { int128_t v = { a.lo & b.lo, a.hi & b.hi }; return v; }\n"
-                    << "static inline int128_t or128s (int128_t a, int128_t b) { int128_t v = { a.lo | b.lo, a.hi | b.hi }; return v; }\n"
-                    << "static inline int128_t xor128s(int128_t a, int128_t b) { int128_t v = { a.lo ^ b.lo, a.hi ^ b.hi }; return v; }\n"
-                    << "static inline int128_t shl128s(int128_t a, uint32_t b) { int128_t v; if(b < 64) { v.lo = a.lo << b; v.hi = (a.hi << b) | (a.lo >> (64 - b)); } else { v.hi = a.lo << (b - 64); v.lo = 0; } return v; }\n"
-                    << "static inline int128_t shr128s(int128_t a, uint32_t b) { int128_t v; if(b < 64) { v.lo = (a.lo >> b)|(a.hi << (64 - b)); v.hi = a.hi >> b; } else { v.lo = a.hi >> (b - 64); v.hi = 0; } return v; }\n"
                     << "static inline uint128_t make128(uint64_t v) { uint128_t rv = { v, 0 }; return rv; }\n"
+                    << "static inline int cmp128(uint128_t a, uint128_t b) { if(a.hi != b.hi) return a.hi < b.hi ? -1 : 1; if(a.lo != b.lo) return a.lo < b.lo ? -1 : 1; return 0; }\n"
                     << "static inline uint128_t add128(uint128_t a, uint128_t b) { uint128_t v; v.lo = a.lo + b.lo; v.hi = a.hi + b.hi + (v.lo < a.lo ? 1 : 0); return v; }\n"
                     << "static inline uint128_t sub128(uint128_t a, uint128_t b) { uint128_t v; v.lo = a.lo - b.lo; v.hi = a.hi - b.hi - (v.lo > a.lo ? 1 : 0); return v; }\n"
-                    << "static inline uint128_t mul128(uint128_t a, uint128_t b) { abort(); }\n"
-                    << "static inline uint128_t div128(uint128_t a, uint128_t b) { abort(); }\n"
-                    << "static inline uint128_t mod128(uint128_t a, uint128_t b) { abort(); }\n"
+                    << "static inline uint128_t mul128(uint128_t a, uint128_t b) {\n"
+                    << "\tuint64_t a0 = a.lo & 0xFFFFFFFF, a1 = a.lo >> 32, b0 = b.lo & 0xFFFFFFFF, b1 = b.lo >> 32;\n"
+                    << "\tuint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;\n"
+                    << "\tuint64_t mid = (p00 >> 32) + (p01 & 0xFFFFFFFF) + (p10 & 0xFFFFFFFF);\n"
+                    << "\tuint128_t v;\n"
+                    << "\tv.lo = (mid << 32) | (p00 & 0xFFFFFFFF);\n"
+                    << "\tv.hi = p11 + (p01 >> 32) + (p10 >> 32) + (mid >> 32) + a.lo * b.hi + a.hi * b.lo;\n"
+                    << "\treturn v;\n"
+                    << "}\n"
                     << "static inline uint128_t and128(uint128_t a, uint128_t b) { uint128_t v = { a.lo & b.lo, a.hi & b.hi }; return v; }\n"
                     << "static inline uint128_t or128 (uint128_t a, uint128_t b) { uint128_t v = { a.lo | b.lo, a.hi | b.hi }; return v; }\n"
                     << "static inline uint128_t xor128(uint128_t a, uint128_t b) { uint128_t v = { a.lo ^ b.lo, a.hi ^ b.hi }; return v; }\n"
-                    << "static inline uint128_t shl128(uint128_t a, uint32_t b) { uint128_t v; if(b < 64) { v.lo = a.lo << b; v.hi = (a.hi << b) | (a.lo >> (64 - b)); } else { v.hi = a.lo << (b - 64); v.lo = 0; } return v; }\n"
-                    << "static inline uint128_t shr128(uint128_t a, uint32_t b) { uint128_t v; if(b < 64) { v.lo = (a.lo >> b)|(a.hi << (64 - b)); v.hi = a.hi >> b; } else { v.lo = a.hi >> (b - 64); v.hi = 0; } return v; }\n"
-                    << "static inline uint128_t popcount128(uint128_t a) { uint128_t v = { __builtin_popcount(a.lo) + __builtin_popcount(a.hi), 0 }; return v; }\n"
+                    << "static inline uint128_t shl128(uint128_t a, uint32_t b) { uint128_t v; if(b == 0) return a; if(b < 64) { v.lo = a.lo << b; v.hi = (a.hi << b) | (a.lo >> (64 - b)); } else { v.hi = a.lo << (b - 64); v.lo = 0; } return v; }\n"
+                    << "static inline uint128_t shr128(uint128_t a, uint32_t b) { uint128_t v; if(b == 0) return a; if(b < 64) { v.lo = (a.lo >> b)|(a.hi << (64 - b)); v.hi = a.hi >> b; } else { v.lo = a.hi >> (b - 64); v.hi = 0; } return v; }\n"
+                    << "static inline uint128_t divmod128(uint128_t a, uint128_t b, uint128_t* rem) {\n"
+                    << "\tuint128_t q = { 0, 0 }, r = { 0, 0 };\n"
+                    << "\tint i;\n"
+                    << "\tif(a.hi == 0 && b.hi == 0) { q.lo = a.lo / b.lo; r.lo = a.lo % b.lo; }\n"
+                    << "\telse if(cmp128(a, b) < 0) { r = a; }\n"
+                    << "\telse {\n"
+                    << "\t\t// Restoring division, starting at the top set bit of the dividend\n"
+                    << "\t\tfor(i = 127; i >= 0 && !((i >= 64 ? a.hi >> (i - 64) : a.lo >> i) & 1); i --) ;\n"
+                    << "\t\tfor(; i >= 0; i --) {\n"
+                    << "\t\t\tr = shl128(r, 1);\n"
+                    << "\t\t\tr.lo |= (i >= 64 ? a.hi >> (i - 64) : a.lo >> i) & 1;\n"
+                    << "\t\t\tif(cmp128(r, b) >= 0) {\n"
+                    << "\t\t\t\tr = sub128(r, b);\n"
+                    << "\t\t\t\tif(i >= 64) q.hi |= 1ull << (i - 64); else q.lo |= 1ull << i;\n"
+                    << "\t\t\t}\n"
+                    << "\t\t}\n"
+                    << "\t}\n"
+                    << "\tif(rem) *rem = r;\n"
+                    << "\treturn q;\n"
+                    << "}\n"
+                    << "static inline uint128_t div128(uint128_t a, uint128_t b) { return divmod128(a, b, 0); }\n"
+                    << "static inline uint128_t mod128(uint128_t a, uint128_t b) { uint128_t r; divmod128(a, b, &r); return r; }\n"
+                    << "static inline int add128_o(uint128_t a, uint128_t b, uint128_t* o) { *o = add128(a, b); return cmp128(*o, a) < 0; }\n"
+                    << "static inline int sub128_o(uint128_t a, uint128_t b, uint128_t* o) { *o = sub128(a, b); return cmp128(a, b) < 0; }\n"
+                    << "static inline int mul128_o(uint128_t a, uint128_t b, uint128_t* o) { *o = mul128(a, b); return (a.lo != 0 || a.hi != 0) && cmp128(div128(*o, a), b) != 0; }\n"
+                    << "static inline uint128_t add128_ov(uint128_t a, uint128_t b) { uint128_t v; if(add128_o(a, b, &v)) abort(); return v; }\n"
+                    << "static inline uint128_t sub128_ov(uint128_t a, uint128_t b) { uint128_t v; if(sub128_o(a, b, &v)) abort(); return v; }\n"
+                    << "static inline uint128_t mul128_ov(uint128_t a, uint128_t b) { uint128_t v; if(mul128_o(a, b, &v)) abort(); return v; }\n"
+                    << "static inline uint128_t div128_ov(uint128_t a, uint128_t b) { if(b.lo == 0 && b.hi == 0) abort(); return div128(a, b); }\n"
+                    << "static inline uint128_t popcount128(uint128_t a) { uint128_t v = { __builtin_popcountll(a.lo) + __builtin_popcountll(a.hi), 0 }; return v; }\n"
                     << "static inline uint128_t __builtin_bswap128(uint128_t v) { uint128_t rv = { __builtin_bswap64(v.hi), __builtin_bswap64(v.lo) }; return rv; }\n"
                     << "static inline uint128_t intrinsic_ctlz_u128(uint128_t v) {\n"
                     << "\tuint128_t rv = { (v.hi != 0 ? __builtin_clz64(v.hi) : (v.lo != 0 ? 64 + __builtin_clz64(v.lo) : 128)), 0 };\n"
@@ -277,6 +335,49 @@ namespace {
                     << "\tuint128_t rv = { (v.lo == 0 ? (v.hi == 0 ? 128 : __builtin_ctz64(v.hi) + 64) : __builtin_ctz64(v.lo)), 0 };\n"
                     << "\treturn rv;\n"
                     << "}\n"
+                    << "static inline uint128_t u128_from_s(int128_t a) { uint128_t v = { a.lo, a.hi }; return v; }\n"
+                    << "static inline int128_t s128_from_u(uint128_t a) { int128_t v = { a.lo, a.hi }; return v; }\n"
+                    << "static inline int128_t make128s(int64_t v) { int128_t rv = { v, (v < 0 ? -1 : 0) }; return rv; }\n"
+                    << "static inline int cmp128s(int128_t a, int128_t b) { if(a.hi != b.hi) return (int64_t)a.hi < (int64_t)b.hi ? -1 : 1; if(a.lo != b.lo) return a.lo < b.lo ? -1 : 1; return 0; }\n"
+                    << "static inline int128_t neg128s(int128_t a) { int128_t v; v.lo = -a.lo; v.hi = ~a.hi + (a.lo == 0 ? 1 : 0); return v; }\n"
+                    << "static inline int128_t add128s(int128_t a, int128_t b) { return s128_from_u(add128(u128_from_s(a), u128_from_s(b))); }\n"
+                    << "static inline int128_t sub128s(int128_t a, int128_t b) { return s128_from_u(sub128(u128_from_s(a), u128_from_s(b))); }\n"
+                    << "static inline int128_t mul128s(int128_t a, int128_t b) { return s128_from_u(mul128(u128_from_s(a), u128_from_s(b))); }\n"
+                    << "static inline int128_t div128s(int128_t a, int128_t b) {\n"
+                    << "\tint na = (int64_t)a.hi < 0, nb = (int64_t)b.hi < 0;\n"
+                    << "\tint128_t q = s128_from_u(div128(u128_from_s(na ? neg128s(a) : a), u128_from_s(nb ? neg128s(b) : b)));\n"
+                    << "\treturn na != nb ? neg128s(q) : q;\n"
+                    << "}\n"
+                    << "static inline int128_t mod128s(int128_t a, int128_t b) {\n"
+                    << "\tint na = (int64_t)a.hi < 0, nb = (int64_t)b.hi < 0;\n"
+                    << "\tint128_t r = s128_from_u(mod128(u128_from_s(na ? neg128s(a) : a), u128_from_s(nb ? neg128s(b) : b)));\n"
+                    << "\treturn na ? neg128s(r) : r;\n"
+                    << "}\n"
+                    << "static inline int128_t and128s(int128_t a, int128_t b) { int128_t v = { a.lo & b.lo, a.hi & b.hi }; return v; }\n"
+                    << "static inline int128_t or128s (int128_t a, int128_t b) { int128_t v = { a.lo | b.lo, a.hi | b.hi }; return v; }\n"
+                    << "static inline int128_t xor128s(int128_t a, int128_t b) { int128_t v = { a.lo ^ b.lo, a.hi ^ b.hi }; return v; }\n"
+                    << "static inline int128_t shl128s(int128_t a, uint32_t b) { return s128_from_u(shl128(u128_from_s(a), b)); }\n"
+                    << "static inline int128_t shr128s(int128_t a, uint32_t b) { int128_t v; if(b == 0) return a; if(b < 64) { v.lo = (a.lo >> b)|(a.hi << (64 - b)); v.hi = (uint64_t)((int64_t)a.hi >> b); } else { v.lo = (uint64_t)((int64_t)a.hi >> (b - 64)); v.hi = (uint64_t)((int64_t)a.hi >> 63); } return v; }\n"
+                    << "static inline int add128s_o(int128_t a, int128_t b, int128_t* o) { *o = add128s(a, b); return (~(a.hi ^ b.hi) & (a.hi ^ o->hi)) >> 63; }\n"
+                    << "static inline int sub128s_o(int128_t a, int128_t b, int128_t* o) { *o = sub128s(a, b); return ((a.hi ^ b.hi) & (a.hi ^ o->hi)) >> 63; }\n"
+                    << "static inline int mul128s_o(int128_t a, int128_t b, int128_t* o) {\n"
+                    << "\t*o = mul128s(a, b);\n"
+                    << "\tif(a.lo == 0 && a.hi == 0) return 0;\n"
+                    << "\t// -1 * MIN is the only overflow that the division check can't see\n"
+                    << "\tif(a.lo == ~0ull && a.hi == ~0ull) return b.lo == 0 && b.hi == (1ull << 63);\n"
+                    << "\treturn cmp128s(div128s(*o, a), b) != 0;\n"
+                    << "}\n"
+                    << "static inline int128_t add128s_ov(int128_t a, int128_t b) { int128_t v; if(add128s_o(a, b, &v)) abort(); return v; }\n"
+                    << "static inline int128_t sub128s_ov(int128_t a, int128_t b) { int128_t v; if(sub128s_o(a, b, &v)) abort(); return v; }\n"
+                    << "static inline int128_t mul128s_ov(int128_t a, int128_t b) { int128_t v; if(mul128s_o(a, b, &v)) abort(); return v; }\n"
+                    << "static inline int128_t div128s_ov(int128_t a, int128_t b) {\n"
+                    << "\tif(b.lo == 0 && b.hi == 0) abort();\n"
+                    << "\tif(b.lo == ~0ull && b.hi == ~0ull && a.lo == 0 && a.hi == (1ull << 63)) abort();\n"
+                    << "\treturn div128s(a, b);\n"
+                    << "}\n"
+                    << "static inline int128_t popcount128s(int128_t a) { return s128_from_u(popcount128(u128_from_s(a))); }\n"
+                    << "static inline int128_t intrinsic_ctlz_i128(int128_t v) { return s128_from_u(intrinsic_ctlz_u128(u128_from_s(v))); }\n"
+                    << "static inline int128_t intrinsic_cttz_i128(int128_t v) { return s128_from_u(intrinsic_cttz_u128(u128_from_s(v))); }\n"
                     ;
             }
             else
@@ -294,6 +395,9 @@ namespace {
                     << "static inline uint128_t intrinsic_cttz_u128(uint128_t v) {\n"
                     << "\treturn (v == 0 ? 128 : ((v&0xFFFFFFFFFFFFFFFF) == 0 ? __builtin_ctz64(v>>64) + 64 : __builtin_ctz64(v)));\n"
                     << "}\n"
+                    << "static inline uint128_t popcount128(uint128_t v) {\n"
+                    << "\treturn __builtin_popcountll((uint64_t)v) + __builtin_popcountll((uint64_t)(v>>64));\n"
+                    << "}\n"
                     ;
             }
 
@@ -326,6 +430,11 @@ namespace {
                 emit_box_drop_glue( mv$(e.first), *e.second );
             }
 
+            if( m_reused_vtables > 0 || m_reused_glue > 0 )
+            {
+                ::std::cout << "Codegen: Using " << m_reused_vtables << " vtables and " << m_reused_glue << " drop glue functions from upstream crates" << ::std::endl;
+            }
+
             if( is_executable )
             {
                 m_of << "int main(int argc, const char* argv[]) {\n";
@@ -480,6 +589,13 @@ namespace {
                 {
                     args.push_back("-g");
                 }
+                if( opt.enable_lto )
+                {
+                    args.push_back("-flto");
+                    // Keep regular object code too, so the library can still be used by a non-LTO executable
+                    if( !is_executable )
+                        args.push_back("-ffat-lto-objects");
+                }
                 args.push_back("-o");
                 args.push_back(m_outfile_path.c_str());
                 args.push_back(m_outfile_path_c.c_str());
@@ -538,6 +654,10 @@ namespace {
                     args.push_back("/O2");
                     break;
                 }
+                if( opt.enable_lto )
+                {
+                    args.push_back("/GL");
+                }
                 if(is_executable)
                 {
                     args.push_back(cache_str( FMT("/Fe" << m_outfile_path) ));
@@ -565,6 +685,10 @@ namespace {
 
                     // Command-line specified linker search directories
                     args.push_back("/link");
+                    if( opt.enable_lto )
+                    {
+                        args.push_back("/LTCG");
+                    }
                     for(const auto& path : link_dirs )
                     {
                         args.push_back(cache_str( FMT("/LIBPATH:" << path) ));
@@ -621,7 +745,8 @@ namespace {
 
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, args, *(::MIR::Function*)nullptr };
             m_mir_res = &mir_res;
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(struct s_" << Trans_Mangle(p) << "* rv) {\n";
+            emit_glue_linkage(true);
+            m_of << "void " << Trans_Mangle(drop_glue_path) << "(struct s_" << Trans_Mangle(p) << "* rv) {\n";
 
             // Obtain inner pointer
             // TODO: This is very specific to the structure of the official liballoc's Box.
@@ -635,6 +760,43 @@ namespace {
             m_mir_res = nullptr;
         }
 
+        /// Linkage for drop glue (emitted by every crate that needs it)
+        /// - Weak where supported, so the linker keeps one copy and downstream crates can use upstream copies
+        void emit_glue_linkage(bool is_definition)
+        {
+            switch(m_compiler)
+            {
+            case Compiler::Gcc:
+                if( is_definition )
+                    m_of << "__attribute__((weak)) ";
+                break;
+            case Compiler::Msvc:
+                m_of << "static ";
+                break;
+            }
+        }
+        /// Linkage for a function defined by an upstream crate (monomorphised here)
+        /// - Local, unless exported for downstream crates (then weak, as other crates may export it too)
+        void emit_extern_def_linkage(const ::HIR::Path& p, bool is_definition)
+        {
+            if( !m_exported_instances.empty() && m_exported_instances.count( FMT(Trans_Mangle(p)) ) > 0 )
+            {
+                emit_glue_linkage(is_definition);
+            }
+            else
+            {
+                m_of << "static ";
+            }
+        }
+        /// Check if an upstream object already defines this drop glue (the caller then only emits a prototype)
+        bool is_upstream_glue(const ::HIR::Path& drop_glue_path)
+        {
+            if( m_upstream_glue.count( FMT(Trans_Mangle(drop_glue_path)) ) == 0 )
+                return false;
+            m_reused_glue ++;
+            return true;
+        }
+
         void emit_type_id(const ::HIR::TypeRef& ty) override
         {
             switch(m_compiler)
@@ -731,7 +893,7 @@ namespace {
                 if( te.size() > 0 )
                 {
                     m_of << "typedef struct "; emit_ctype(ty); m_of << " {\n";
-                    for(unsigned int i = 0; i < te.size(); i++)
+                    for(auto i : Target_GetStructRepr(sp, m_resolve, ty)->fields)
                     {
                         m_of << "\t";
                         emit_ctype(te[i], FMT_CB(ss, ss << "_" << i;));
@@ -740,12 +902,24 @@ namespace {
                     m_of << "} "; emit_ctype(ty); m_of << ";\n";
                 }
 
+                if( !m_resolve.type_needs_drop_glue(sp, ty) )
+                {
+                    m_mir_res = nullptr;
+                    return ;
+                }
                 auto drop_glue_path = ::HIR::Path(ty.clone(), "#drop_glue");
                 auto args = ::std::vector< ::std::pair<::HIR::Pattern,::HIR::TypeRef> >();
                 auto ty_ptr = ::HIR::TypeRef::new_pointer(::HIR::BorrowType::Owned, ty.clone());
+                if( is_upstream_glue(drop_glue_path) )
+                {
+                    m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(ty); m_of << "* rv);\n";
+                    m_mir_res = nullptr;
+                    return ;
+                }
                 ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), ty_ptr, args, *(::MIR::Function*)nullptr };
                 m_mir_res = &mir_res;
-                m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(ty); m_of << "* rv) {";
+                emit_glue_linkage(true);
+                m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(ty); m_of << "* rv) {";
                 auto self = ::MIR::LValue::make_Deref({ box$(::MIR::LValue::make_Return({})) });
                 auto fld_lv = ::MIR::LValue::make_Field({ box$(self), 0 });
                 for(const auto& ity : te)
@@ -808,18 +982,37 @@ namespace {
                     emit_ctype( ty, inner );
                 }
                 };
+            const auto& repr = *Target_GetStructRepr(sp, m_resolve, ::HIR::TypeRef(p.clone(), &item));
+            // `repr(packed)` - Fields are unaligned (matching the offsets from `Target_GetStructRepr`)
+            bool is_packed = item.m_repr == ::HIR::Struct::Repr::Packed;
             m_of << "// struct " << p << "\n";
+            if( is_packed && m_compiler == Compiler::Msvc )
+                m_of << "#pragma pack(push, 1)\n";
             m_of << "struct s_" << Trans_Mangle(p) << " {\n";
 
             // HACK: For vtables, insert the alignment and size at the start
+            if( item.m_struct_markings.is_vtable )
             {
-                const auto& lc = p.m_path.m_components.back();
-                if( lc.size() > 7 && ::std::strcmp(lc.c_str() + lc.size() - 7, "#vtable") == 0 ) {
-                    m_of << "\tVTABLE_HDR hdr;\n";
-                }
+                m_of << "\tVTABLE_HDR hdr;\n";
             }
 
-            TU_MATCHA( (item.m_data), (e),
+            if( repr.simd_vector )
+            {
+                // `repr(simd)` - Lanes are still accessible as fields, `v` is the gcc vector used by the `simd_*` intrinsics
+                ::HIR::TypeRef  lane_ty;
+                m_of << "\tunion {\n";
+                m_of << "\t\tstruct {";
+                for(auto i : repr.fields)
+                {
+                    const auto& fld_ty = (item.m_data.is_Tuple() ? item.m_data.as_Tuple()[i].ent : item.m_data.as_Named()[i].second.ent);
+                    lane_ty = monomorph(fld_ty).clone();
+                    m_of << " "; emit_ctype(lane_ty, FMT_CB(ss, ss << "_" << i;)); m_of << ";";
+                }
+                m_of << " };\n";
+                m_of << "\t\t"; emit_ctype(lane_ty, FMT_CB(ss, ss << "v";)); m_of << " __attribute__((vector_size(" << repr.size << ")));\n";
+                m_of << "\t};\n";
+            }
+            else TU_MATCHA( (item.m_data), (e),
             (Unit,
                 if( m_options.disallow_empty_structs )
                 {
@@ -836,7 +1029,7 @@ namespace {
                 }
                 else
                 {
-                    for(unsigned int i = 0; i < e.size(); i ++)
+                    for(auto i : repr.fields)
                     {
                         const auto& fld = e[i];
                         m_of << "\t";
@@ -855,7 +1048,7 @@ namespace {
                 }
                 else
                 {
-                    for(unsigned int i = 0; i < e.size(); i ++)
+                    for(auto i : repr.fields)
                     {
                         const auto& fld = e[i].second;
                         m_of << "\t";
@@ -865,12 +1058,28 @@ namespace {
                 }
                 )
             )
-            m_of << "};\n";
+            if( is_packed && m_compiler == Compiler::Gcc )
+                m_of << "} __attribute__((packed));\n";
+            else
+                m_of << "};\n";
+            if( is_packed && m_compiler == Compiler::Msvc )
+                m_of << "#pragma pack(pop)\n";
 
             auto struct_ty = ::HIR::TypeRef(p.clone(), &item);
+            // - Drop Glue (only emitted if something needs dropping)
+            if( !m_resolve.type_needs_drop_glue(sp, struct_ty) )
+            {
+                m_mir_res = nullptr;
+                return ;
+            }
             auto drop_glue_path = ::HIR::Path(struct_ty.clone(), "#drop_glue");
             auto struct_ty_ptr = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Owned, struct_ty.clone());
-            // - Drop Glue
+            if( is_upstream_glue(drop_glue_path) )
+            {
+                m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ");\n";
+                m_mir_res = nullptr;
+                return ;
+            }
 
             ::std::vector< ::std::pair<::HIR::Pattern,::HIR::TypeRef> > args;
             if( item.m_markings.has_drop_impl ) {
@@ -889,13 +1098,15 @@ namespace {
             else if( m_resolve.is_type_owned_box(struct_ty) )
             {
                 m_box_glue_todo.push_back( ::std::make_pair( mv$(struct_ty.m_data.as_Path().path.m_data.as_Generic()), &item ) );
-                m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ");\n";
+                emit_glue_linkage(false);
+                m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ");\n";
                 return ;
             }
 
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, args, *(::MIR::Function*)nullptr };
             m_mir_res = &mir_res;
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ") {\n";
+            emit_glue_linkage(true);
+            m_of << "void " << Trans_Mangle(drop_glue_path) << "("; emit_ctype(struct_ty_ptr, FMT_CB(ss, ss << "rv";)); m_of << ") {\n";
 
             // If this type has an impl of Drop, call that impl
             if( item.m_markings.has_drop_impl ) {
@@ -956,7 +1167,18 @@ namespace {
 
             // Drop glue (calls destructor if there is one)
             auto item_ty = ::HIR::TypeRef(p.clone(), &item);
+            if( !m_resolve.type_needs_drop_glue(sp, item_ty) )
+            {
+                m_mir_res = nullptr;
+                return ;
+            }
             auto drop_glue_path = ::HIR::Path(item_ty.clone(), "#drop_glue");
+            if( is_upstream_glue(drop_glue_path) )
+            {
+                m_of << "void " << Trans_Mangle(drop_glue_path) << "(union u_" << Trans_Mangle(p) << "* rv);\n";
+                m_mir_res = nullptr;
+                return ;
+            }
             auto item_ptr_ty = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Owned, item_ty.clone());
             auto drop_impl_path = (item.m_markings.has_drop_impl ? ::HIR::Path(item_ty.clone(), m_resolve.m_lang_Drop, "drop") : ::HIR::Path(::HIR::SimplePath()));
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), item_ptr_ty, {}, *(::MIR::Function*)nullptr };
@@ -967,7 +1189,8 @@ namespace {
                 m_of << "tUNIT " << Trans_Mangle(drop_impl_path) << "(union u_" << Trans_Mangle(p) << "*rv);\n";
             }
 
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(union u_" << Trans_Mangle(p) << "* rv) {\n";
+            emit_glue_linkage(true);
+            m_of << "void " << Trans_Mangle(drop_glue_path) << "(union u_" << Trans_Mangle(p) << "* rv) {\n";
             if( item.m_markings.has_drop_impl )
             {
                 m_of << "\t" << Trans_Mangle(drop_impl_path) << "(rv);\n";
@@ -975,37 +1198,48 @@ namespace {
             m_of << "}\n";
         }
 
-        // TODO: Move this to codegen.cpp?
-        bool get_nonzero_path(const Span& sp, const ::HIR::TypeRef& ty, ::std::vector<unsigned int>& out) const
+        /// Obtain the niche representation of an enum type, or nullptr if it's tagged (or not an enum)
+        const TargetEnumRepr* get_niche_repr(const Span& sp, const ::HIR::TypeRef& ty) const
         {
-            TU_MATCH_DEF( ::HIR::TypeRef::Data, (ty.m_data), (te),
-            (
-                return false;
-                ),
-            (Borrow,
-                if( metadata_type(*te.inner) != MetadataType::None )
-                {
-                    // HACK: If the inner is a DST, emit ~0 as a marker
-                    out.push_back(~0u);
-                }
-                return true;
-                ),
-            (Function,
-                return true;
-                )
-            )
+            if( !ty.m_data.is_Path() || !ty.m_data.as_Path().binding.is_Enum() )
+                return nullptr;
+            const auto& repr = Target_GetEnumRepr(sp, m_resolve, ty.m_data.as_Path().path.m_data.as_Generic(), *ty.m_data.as_Path().binding.as_Enum());
+            return repr.kind == TargetEnumRepr::Kind::Niche ? &repr : nullptr;
         }
-        void emit_nonzero_path(const ::std::vector<unsigned int>& nonzero_path) {
-            for(const auto v : nonzero_path)
+        static ::std::string get_niche_path(const TargetEnumRepr& repr) {
+            ::std::stringstream ss;
+            for(const auto v : repr.niche_path)
             {
-                if(v == ~0u) {
-                    // NOTE: Should only ever be the last
-                    m_of << ".PTR";
+                if(v == TargetEnumRepr::PATH_PTR) {
+                    ss << ".PTR";
+                }
+                else if(v == TargetEnumRepr::PATH_TAG) {
+                    ss << ".TAG";
                 }
                 else {
-                    m_of << "._" << v;
+                    ss << "._" << v;
                 }
             }
+            return ss.str();
+        }
+        /// Emit the niche slot of an enum value (`emit_base` emits the enum lvalue)
+        void emit_niche_slot(const TargetEnumRepr& repr, ::std::function<void()> emit_base) {
+            // NOTE: `bool` slots hold values that C's `bool` can't, so access them as raw bytes
+            if( repr.niche_is_byte )
+                m_of << "(*(uint8_t*)&";
+            emit_base();
+            m_of << get_niche_path(repr);
+            if( repr.niche_is_byte )
+                m_of << ")";
+        }
+        /// Emit a condition that is true if the enum value holds the data variant
+        void emit_niche_is_data(const TargetEnumRepr& repr, ::std::function<void()> emit_base) {
+            if( repr.niche_count == 1 ) {
+                emit_niche_slot(repr, emit_base); m_of << " != " << repr.niche_start;
+            }
+            else {
+                m_of << "(uint64_t)"; emit_niche_slot(repr, emit_base); m_of << " - " << repr.niche_start << "ull >= " << repr.niche_count << "ull";
+            }
         }
 
         void emit_enum(const Span& sp, const ::HIR::GenericPath& p, const ::HIR::Enum& item) override
@@ -1026,42 +1260,45 @@ namespace {
                 }
                 };
 
-            // TODO: Cache repr info elsewhere (and have core codegen be responsible instead)
-            // TODO: Do more complex nonzero relations.
-            ::std::vector<unsigned> nonzero_path;
+            const auto& repr = Target_GetEnumRepr(sp, m_resolve, p, item);
+
+            m_of << "// enum " << p << "\n";
+            if( repr.kind == TargetEnumRepr::Kind::Niche )
             {
-                // Detect Option (and similar enums)
-                if( item.m_variants.size() == 2 && item.m_variants[0].second.is_Unit() && item.m_variants[1].second.is_Tuple() )
-                {
-                    const auto& data_ents = item.m_variants[1].second.as_Tuple();
-                    if( data_ents.size() == 1 )
-                    {
-                        const auto& data_type = monomorph(data_ents[0].ent);
-                        if( get_nonzero_path(sp, data_type, nonzero_path) )
+                // Data variant's fields are stored directly, the other variants live in the niche
+                const auto& data_var = item.m_variants[repr.data_variant].second;
+                auto emit_fields = [&](const char* indent) {
+                    TU_MATCH_DEF( ::HIR::Enum::Variant, (data_var), (e),
+                    (
+                        MIR_BUG(*m_mir_res, "Niche enum data variant without fields");
+                        ),
+                    (Tuple,
+                        for(auto i : repr.variants[repr.data_variant].fields)
                         {
-                            nonzero_path.push_back(0);
-                            ::std::reverse( nonzero_path.begin(), nonzero_path.end() );
+                            m_of << indent; emit_ctype(monomorph(e[i].ent), FMT_CB(s, s << "_" << i;)); m_of << ";\n";
                         }
-                        else
+                        ),
+                    (Struct,
+                        for(auto i : repr.variants[repr.data_variant].fields)
                         {
-                            assert(nonzero_path.size() == 0);
+                            m_of << indent; emit_ctype(monomorph(e[i].second.ent), FMT_CB(s, s << "_" << i;)); m_of << ";\n";
                         }
-                    }
-                }
-            }
-
-            m_of << "// enum " << p << "\n";
-            if( nonzero_path.size() > 0 )
-            {
-                MIR_ASSERT(*m_mir_res, nonzero_path[0] == 0, "");
-                MIR_ASSERT(*m_mir_res, item.m_variants.size() == 2, "");
-                MIR_ASSERT(*m_mir_res, item.m_variants[0].second.is_Unit(), "");
-                const auto& data_var = item.m_variants[1];
-                MIR_ASSERT(*m_mir_res, data_var.second.is_Tuple(), "");
-                MIR_ASSERT(*m_mir_res, data_var.second.as_Tuple().size() == 1, "");
-                const auto& data_type = monomorph(data_var.second.as_Tuple()[0].ent);
+                        )
+                    )
+                    };
                 m_of << "struct e_" << Trans_Mangle(p) << " {\n";
-                m_of << "\t"; emit_ctype(data_type, FMT_CB(s, s << "_0";)); m_of << ";\n";
+                if( repr.niche_is_byte )
+                {
+                    // Byte view used to initialise the niche in constants
+                    m_of << "\tunion {\n";
+                    m_of << "\t\tstruct {\n"; emit_fields("\t\t\t"); m_of << "\t\t};\n";
+                    m_of << "\t\tuint8_t RAW[sizeof(struct {\n"; emit_fields("\t\t\t"); m_of << "\t\t})];\n";
+                    m_of << "\t};\n";
+                }
+                else
+                {
+                    emit_fields("\t");
+                }
                 m_of << "};\n";
             }
             else if( item.m_repr != ::HIR::Enum::Repr::Rust || ::std::all_of(item.m_variants.begin(), item.m_variants.end(), [](const auto& x){return x.second.is_Unit() || x.second.is_Value();}) )
@@ -1101,23 +1338,23 @@ namespace {
                         ),
                     (Tuple,
                         m_of << "\t\tstruct {\n";
-                        for(unsigned int i = 0; i < e.size(); i ++)
+                        for(auto j : repr.variants[i].fields)
                         {
-                            const auto& fld = e[i];
+                            const auto& fld = e[j];
                             m_of << "\t\t\t";
                             emit_ctype( monomorph(fld.ent) );
-                            m_of << " _" << i << ";\n";
+                            m_of << " _" << j << ";\n";
                         }
                         m_of << "\t\t} var_" << i << ";\n";
                         ),
                     (Struct,
                         m_of << "\t\tstruct {\n";
-                        for(unsigned int i = 0; i < e.size(); i ++)
+                        for(auto j : repr.variants[i].fields)
                         {
-                            const auto& fld = e[i];
+                            const auto& fld = e[j];
                             m_of << "\t\t\t";
                             emit_ctype( monomorph(fld.second.ent) );
-                            m_of << " _" << i << ";\n";
+                            m_of << " _" << j << ";\n";
                         }
                         m_of << "\t\t} var_" << i << ";\n";
                         )
@@ -1131,7 +1368,18 @@ namespace {
             // - Drop Glue
             // ---
             auto struct_ty = ::HIR::TypeRef(p.clone(), &item);
+            if( !m_resolve.type_needs_drop_glue(sp, struct_ty) )
+            {
+                m_mir_res = nullptr;
+                return ;
+            }
             auto drop_glue_path = ::HIR::Path(struct_ty.clone(), "#drop_glue");
+            if( is_upstream_glue(drop_glue_path) )
+            {
+                m_of << "void " << Trans_Mangle(drop_glue_path) << "(struct e_" << Trans_Mangle(p) << "* rv);\n";
+                m_mir_res = nullptr;
+                return ;
+            }
             auto struct_ty_ptr = ::HIR::TypeRef::new_borrow(::HIR::BorrowType::Owned, struct_ty.clone());
             auto drop_impl_path = (item.m_markings.has_drop_impl ? ::HIR::Path(struct_ty.clone(), m_resolve.m_lang_Drop, "drop") : ::HIR::Path(::HIR::SimplePath()));
             ::MIR::TypeResolve  mir_res { sp, m_resolve, FMT_CB(ss, ss << drop_glue_path;), struct_ty_ptr, {}, *(::MIR::Function*)nullptr };
@@ -1142,7 +1390,8 @@ namespace {
                 m_of << "tUNIT " << Trans_Mangle(drop_impl_path) << "(struct e_" << Trans_Mangle(p) << "*rv);\n";
             }
 
-            m_of << "static void " << Trans_Mangle(drop_glue_path) << "(struct e_" << Trans_Mangle(p) << "* rv) {\n";
+            emit_glue_linkage(true);
+            m_of << "void " << Trans_Mangle(drop_glue_path) << "(struct e_" << Trans_Mangle(p) << "* rv) {\n";
 
             // If this type has an impl of Drop, call that impl
             if( item.m_markings.has_drop_impl )
@@ -1151,16 +1400,28 @@ namespace {
             }
             auto self = ::MIR::LValue::make_Deref({ box$(::MIR::LValue::make_Return({})) });
 
-            if( nonzero_path.size() > 0 )
+            if( repr.kind == TargetEnumRepr::Kind::Niche )
             {
                 auto fld_lv = ::MIR::LValue::make_Field({ box$(self), 0 });
-                // TODO: Fat pointers?
-                m_of << "\tif( ! (*rv)"; emit_nonzero_path(nonzero_path); m_of << " ) {\n";
-                for(const auto& fld : item.m_variants[1].second.as_Tuple())
-                {
-                    emit_destructor_call(fld_lv, monomorph(fld.ent), false, 2);
-                    fld_lv.as_Field().field_index ++;
-                }
+                m_of << "\tif( "; emit_niche_is_data(repr, [&](){ m_of << "(*rv)"; }); m_of << " ) {\n";
+                TU_MATCH_DEF( ::HIR::Enum::Variant, (item.m_variants[repr.data_variant].second), (e),
+                (
+                    ),
+                (Tuple,
+                    for(const auto& fld : e)
+                    {
+                        emit_destructor_call(fld_lv, monomorph(fld.ent), false, 2);
+                        fld_lv.as_Field().field_index ++;
+                    }
+                    ),
+                (Struct,
+                    for(const auto& fld : e)
+                    {
+                        emit_destructor_call(fld_lv, monomorph(fld.second.ent), false, 2);
+                        fld_lv.as_Field().field_index ++;
+                    }
+                    )
+                )
                 m_of << "\t}\n";
             }
             else if( item.m_repr != ::HIR::Enum::Repr::Rust || ::std::all_of(item.m_variants.begin(), item.m_variants.end(), [](const auto& x){return x.second.is_Unit() || x.second.is_Value();}) )
@@ -1209,11 +1470,6 @@ namespace {
             }
             m_of << "}\n";
             m_mir_res = nullptr;
-
-            if( nonzero_path.size() )
-            {
-                m_enum_repr_cache.insert( ::std::make_pair( p.clone(), mv$(nonzero_path) ) );
-            }
         }
 
         void emit_constructor_enum(const Span& sp, const ::HIR::GenericPath& path, const ::HIR::Enum& item, size_t var_idx) override
@@ -1246,10 +1502,25 @@ namespace {
                 emit_ctype( monomorph(e[i].ent), FMT_CB(ss, ss << "_" << i;) );
             }
             m_of << ") {\n";
-            auto it = m_enum_repr_cache.find(p);
-            if( it != m_enum_repr_cache.end() )
+            const auto& repr = Target_GetEnumRepr(sp, m_resolve, p, item);
+            if( repr.kind == TargetEnumRepr::Kind::Niche )
             {
-                m_of << "\tstruct e_" << Trans_Mangle(p) << " rv = { ._0 = _0 };\n";
+                if( var_idx == repr.data_variant )
+                {
+                    m_of << "\tstruct e_" << Trans_Mangle(p) << " rv = {";
+                    for(unsigned int i = 0; i < e.size(); i ++)
+                    {
+                        if(i != 0)
+                            m_of << ",";
+                        m_of << " ._" << i << " = _" << i;
+                    }
+                    m_of << " };\n";
+                }
+                else
+                {
+                    m_of << "\tstruct e_" << Trans_Mangle(p) << " rv;\n";
+                    m_of << "\t"; emit_niche_slot(repr, [&](){ m_of << "rv"; }); m_of << " = " << repr.niche_value(var_idx) << ";\n";
+                }
             }
             else
             {
@@ -1273,7 +1544,7 @@ namespace {
                     {
                         if(i != 0)
                         m_of << ",";
-                        m_of << "\n\t\t_" << i;
+                        m_of << "\n\t\t._" << i << " = _" << i;
                     }
                     m_of << "\n\t\t}";
                 }
@@ -1311,7 +1582,7 @@ namespace {
             {
                 if(i != 0)
                     m_of << ",";
-                m_of << "\n\t\t_" << i;
+                m_of << "\n\t\t._" << i << " = _" << i;
             }
             m_of << "\n\t\t};\n";
             m_of << "\treturn rv;\n";
@@ -1396,6 +1667,68 @@ namespace {
                 m_of << ::std::scientific << v;
             }
         }
+        /// Emit an integer constant of the given (primitive or pointer) type
+        void emit_integer_literal(const ::HIR::TypeRef& ty, uint64_t e)
+        {
+            if( ty.m_data.is_Primitive() )
+            {
+                switch(ty.m_data.as_Primitive())
+                {
+                case ::HIR::CoreType::Bool:
+                    m_of << (e ? "true" : "false");
+                    break;
+                case ::HIR::CoreType::U8:
+                    m_of << ::std::hex << "0x" << (e & 0xFF) << ::std::dec;
+                    break;
+                case ::HIR::CoreType::U16:
+                    m_of << ::std::hex << "0x" << (e & 0xFFFF) << ::std::dec;
+                    break;
+                case ::HIR::CoreType::U32:
+                    m_of << ::std::hex << "0x" << (e & 0xFFFFFFFF) << ::std::dec;
+                    break;
+                case ::HIR::CoreType::U64:
+                case ::HIR::CoreType::Usize:
+                    m_of << ::std::hex << "0x" << e << ::std::dec;
+                    break;
+                case ::HIR::CoreType::U128:
+                    m_of << ::std::hex << "0x" << e << ::std::dec;
+                    break;
+                case ::HIR::CoreType::I8:
+                    m_of << static_cast<uint16_t>( static_cast<int8_t>(e) );
+                    break;
+                case ::HIR::CoreType::I16:
+                    m_of << static_cast<int16_t>(e);
+                    break;
+                case ::HIR::CoreType::I32:
+                    m_of << static_cast<int32_t>(e);
+                    break;
+                case ::HIR::CoreType::I64:
+                case ::HIR::CoreType::I128:
+                case ::HIR::CoreType::Isize:
+                    m_of << static_cast<int64_t>(e);
+                    break;
+                case ::HIR::CoreType::Char:
+                    assert(0 <= e && e <= 0x10FFFF);
+                    if( e < 256 ) {
+                        m_of << e;
+                    }
+                    else {
+                        m_of << ::std::hex << "0x" << e << ::std::dec;
+                    }
+                    break;
+                default:
+                    MIR_TODO(*m_mir_res, "Handle intger literal of type " << ty);
+                }
+            }
+            else if( ty.m_data.is_Pointer() )
+            {
+                m_of << ::std::hex << "(void*)0x" << e << ::std::dec;
+            }
+            else
+            {
+                MIR_BUG(*m_mir_res, "Integer literal for invalid type - " << ty);
+            }
+        }
         void emit_literal(const ::HIR::TypeRef& ty, const ::HIR::Literal& lit, const Trans_Params& params) {
             TRACE_FUNCTION_F("ty=" << ty << ", lit=" << lit);
             ::HIR::TypeRef  tmp;
@@ -1470,6 +1803,9 @@ namespace {
                 for(unsigned int i = 0; i < e.size(); i ++) {
                     if(i != 0)  m_of << ",";
                     m_of << " ";
+                    // NOTE: Struct/tuple fields may be reordered, so use designated initialisers
+                    if( !ty.m_data.is_Array() )
+                        m_of << "._" << i << " = ";
                     emit_literal(get_inner_type(0, i), e[i], params);
                 }
                 if(ty.m_data.is_Path() && e.size() == 0 && m_options.disallow_empty_structs)
@@ -1478,20 +1814,37 @@ namespace {
                 if( ty.m_data.is_Array() )
                     m_of << "}";
                 ),
+            (Packed,
+                MIR_ASSERT(*m_mir_res, ty.m_data.is_Array(), "Packed literal for non-array - " << ty);
+                const auto& inner_ty = *ty.m_data.as_Array().inner;
+                m_of << "{{";
+                for(size_t i = 0; i < e.size(); i ++) {
+                    if(i != 0)  m_of << ",";
+                    m_of << " ";
+                    emit_integer_literal(inner_ty, e.get(i));
+                }
+                m_of << " }}";
+                ),
             (Variant,
                 MIR_ASSERT(*m_mir_res, ty.m_data.is_Path(), "");
                 MIR_ASSERT(*m_mir_res, ty.m_data.as_Path().binding.is_Enum(), "");
                 const auto& enm = *ty.m_data.as_Path().binding.as_Enum();
-                auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                if( it != m_enum_repr_cache.end() )
+                if( const auto* repr = get_niche_repr(sp, ty) )
                 {
-                    if( e.idx == 0 ) {
-                        m_of << "{0}";
+                    if( e.idx == repr->data_variant ) {
+                        m_of << "{";
+                        for(unsigned int i = 0; i < e.vals.size(); i ++) {
+                            if(i != 0)  m_of << ",";
+                            m_of << " ._" << i << " = ";
+                            emit_literal(get_inner_type(e.idx, i), e.vals[i], params);
+                        }
+                        m_of << " }";
+                    }
+                    else if( repr->niche_is_byte ) {
+                        m_of << "{ .RAW = { [offsetof("; emit_ctype(ty); m_of << ", " << get_niche_path(*repr).substr(1) << ")] = " << repr->niche_value(e.idx) << " } }";
                     }
                     else {
-                        m_of << "{";
-                        emit_literal(get_inner_type(e.idx, 0), e.vals[0], params);
-                        m_of << "}";
+                        m_of << "{ " << get_niche_path(*repr) << " = " << repr->niche_value(e.idx) << " }";
                     }
                 }
                 else if( enm.is_value() )
@@ -1514,7 +1867,7 @@ namespace {
                         m_of << ", { .var_" << e.idx << " = {";
                         for(unsigned int i = 0; i < e.vals.size(); i ++) {
                             if(i != 0)  m_of << ",";
-                            m_of << " ";
+                            m_of << " ._" << i << " = ";
                             emit_literal(get_inner_type(e.idx, i), e.vals[i], params);
                         }
                         m_of << "} }";
@@ -1523,64 +1876,7 @@ namespace {
                 }
                 ),
             (Integer,
-                if( ty.m_data.is_Primitive() )
-                {
-                    switch(ty.m_data.as_Primitive())
-                    {
-                    case ::HIR::CoreType::Bool:
-                        m_of << (e ? "true" : "false");
-                        break;
-                    case ::HIR::CoreType::U8:
-                        m_of << ::std::hex << "0x" << (e & 0xFF) << ::std::dec;
-                        break;
-                    case ::HIR::CoreType::U16:
-                        m_of << ::std::hex << "0x" << (e & 0xFFFF) << ::std::dec;
-                        break;
-                    case ::HIR::CoreType::U32:
-                        m_of << ::std::hex << "0x" << (e & 0xFFFFFFFF) << ::std::dec;
-                        break;
-                    case ::HIR::CoreType::U64:
-                    case ::HIR::CoreType::Usize:
-                        m_of << ::std::hex << "0x" << e << ::std::dec;
-                        break;
-                    case ::HIR::CoreType::U128:
-                        m_of << ::std::hex << "0x" << e << ::std::dec;
-                        break;
-                    case ::HIR::CoreType::I8:
-                        m_of << static_cast<uint16_t>( static_cast<int8_t>(e) );
-                        break;
-                    case ::HIR::CoreType::I16:
-                        m_of << static_cast<int16_t>(e);
-                        break;
-                    case ::HIR::CoreType::I32:
-                        m_of << static_cast<int32_t>(e);
-                        break;
-                    case ::HIR::CoreType::I64:
-                    case ::HIR::CoreType::I128:
-                    case ::HIR::CoreType::Isize:
-                        m_of << static_cast<int64_t>(e);
-                        break;
-                    case ::HIR::CoreType::Char:
-                        assert(0 <= e && e <= 0x10FFFF);
-                        if( e < 256 ) {
-                            m_of << e;
-                        }
-                        else {
-                            m_of << ::std::hex << "0x" << e << ::std::dec;
-                        }
-                        break;
-                    default:
-                        MIR_TODO(*m_mir_res, "Handle intger literal of type " << ty);
-                    }
-                }
-                else if( ty.m_data.is_Pointer() )
-                {
-                    m_of << ::std::hex << "(void*)0x" << e << ::std::dec;
-                }
-                else
-                {
-                    MIR_BUG(*m_mir_res, "Integer literal for invalid type - " << ty);
-                }
+                emit_integer_literal(ty, e);
                 ),
             (Float,
                 this->emit_float(e);
@@ -1684,6 +1980,26 @@ namespace {
             const auto& trait_path = p.m_data.as_UfcsKnown().trait;
             const auto& type = *p.m_data.as_UfcsKnown().type;
 
+            auto vtable_sp = trait_path.m_path;
+            vtable_sp.m_components.back() += "#vtable";
+            auto vtable_params = trait_path.m_params.clone();
+            for(const auto& ty : trait.m_type_indexes) {
+                auto aty = ::HIR::TypeRef( ::HIR::Path( type.clone(), trait_path.clone(), ty.first ) );
+                m_resolve.expand_associated_types(sp, aty);
+                vtable_params.m_types.push_back( mv$(aty) );
+            }
+            const auto& vtable_ref = m_crate.get_struct_by_path(sp, vtable_sp);
+            ::HIR::TypeRef  vtable_ty( ::HIR::GenericPath(mv$(vtable_sp), mv$(vtable_params)), &vtable_ref );
+
+            // Already defined by an upstream object, just reference it
+            if( m_upstream_glue.count( FMT(Trans_Mangle(p)) ) > 0 )
+            {
+                m_reused_vtables ++;
+                m_of << "extern "; emit_ctype(vtable_ty); m_of << " " << Trans_Mangle(p) << ";\n";
+                m_mir_res = nullptr;
+                return ;
+            }
+
             // TODO: Hack in fn pointer VTable handling
             if( const auto* te = type.m_data.opt_Function() )
             {
@@ -1701,6 +2017,7 @@ namespace {
                 {
                     auto fcn_p = p.clone();
                     fcn_p.m_data.as_UfcsKnown().item = call_fcn_name;
+                    emit_glue_linkage(true);
                     emit_ctype(*te->m_rettype);
                     auto  arg_ty = ::HIR::TypeRef::new_unit();
                     for(const auto& ty : te->m_arg_types)
@@ -1717,27 +2034,18 @@ namespace {
                 }
             }
 
+            // Weak link for vtables (any crate that needs one emits it)
+            switch(m_compiler)
             {
-                auto vtable_sp = trait_path.m_path;
-                vtable_sp.m_components.back() += "#vtable";
-                auto vtable_params = trait_path.m_params.clone();
-                for(const auto& ty : trait.m_type_indexes) {
-                    auto aty = ::HIR::TypeRef( ::HIR::Path( type.clone(), trait_path.clone(), ty.first ) );
-                    m_resolve.expand_associated_types(sp, aty);
-                    vtable_params.m_types.push_back( mv$(aty) );
-                }
-                const auto& vtable_ref = m_crate.get_struct_by_path(sp, vtable_sp);
-                ::HIR::TypeRef  vtable_ty( ::HIR::GenericPath(mv$(vtable_sp), mv$(vtable_params)), &vtable_ref );
-
-                if( m_compiler == Compiler::Msvc )
-                {
-                    // Weak link for vtables
-                    m_of << "__declspec(selectany) ";
-                }
-
-                emit_ctype(vtable_ty);
-                m_of << " " << Trans_Mangle(p) << " = {\n";
-            }
+            case Compiler::Gcc:
+                m_of << "__attribute__((weak)) ";
+                break;
+            case Compiler::Msvc:
+                m_of << "__declspec(selectany) ";
+                break;
+            }
+            emit_ctype(vtable_ty);
+            m_of << " " << Trans_Mangle(p) << " = {\n";
 
             auto monomorph_cb_trait = monomorphise_type_get_cb(sp, &type, &trait_path.m_params, nullptr);
 
@@ -1745,7 +2053,7 @@ namespace {
             m_of << "\t{ ";
             m_of << "sizeof("; emit_ctype(type); m_of << "),";
             m_of << "ALIGNOF("; emit_ctype(type); m_of << "),";
-            if( type.m_data.is_Borrow() || m_resolve.type_is_copy(sp, type) )
+            if( type.m_data.is_Borrow() || !m_resolve.type_needs_drop_glue(sp, type) )
             {
                 m_of << "noop_drop,";
             }
@@ -1801,6 +2109,7 @@ namespace {
 
             m_of << "// EXTERN extern \"" << item.m_abi << "\" " << p << "\n";
             m_of << "extern ";
+            emit_function_attrs(p, item, params, nullptr);
             emit_function_header(p, item, params);
             if( item.m_linkage.name != "" && m_compiler == Compiler::Gcc)
             {
@@ -1823,8 +2132,9 @@ namespace {
             }
             if( is_extern_def )
             {
-                m_of << "static ";
+                emit_extern_def_linkage(p, false);
             }
+            emit_function_attrs(p, item, params, nullptr);
             emit_function_header(p, item, params);
             m_of << ";\n";
 
@@ -1846,18 +2156,31 @@ namespace {
 
             m_of << "// " << p << "\n";
             if( is_extern_def ) {
-                m_of << "static ";
+                emit_extern_def_linkage(p, true);
             }
+            emit_function_attrs(p, item, params, &*code);
             emit_function_header(p, item, params);
             m_of << "\n";
             m_of << "{\n";
+
+            auto liveness = get_local_liveness(*code);
+            find_inline_temporaries(mir_res, liveness);
+            ::std::vector<bool> labels;
+            ::std::vector<Node> nodes;
+            ::std::vector<bool> local_is_scoped( code->locals.size() );
+            if( m_options.structured_c )
+            {
+                nodes = MIR_To_Structured(*code, labels);
+                local_is_scoped = place_scoped_locals(mir_res, liveness, nodes, labels);
+            }
+
             // Variables
             m_of << "\t"; emit_ctype(ret_type, FMT_CB(ss, ss << "rv";)); m_of << ";\n";
             for(unsigned int i = 0; i < code->locals.size(); i ++) {
                 DEBUG("var" << i << " : " << code->locals[i]);
-                m_of << "\t"; emit_ctype(code->locals[i], FMT_CB(ss, ss << "var" << i;)); m_of << ";";
-                m_of << "\t// " << code->locals[i];
-                m_of << "\n";
+                if( m_local_is_inline[i] || local_is_scoped[i] )
+                    continue ;
+                emit_local_decl(i, 1);
             }
             for(unsigned int i = 0; i < code->drop_flags.size(); i ++) {
                 m_of << "\tbool df" << i << " = " << code->drop_flags[i] << ";\n";
@@ -1896,15 +2219,64 @@ namespace {
                 )
             }
 
-            if( false )
+            // Blocks that unconditionally end in a panic, unwind, or call to a `#[cold]`/diverging function (used to mark unlikely branches)
+            auto is_cold_call = [&](const ::MIR::Terminator::Data_Call& te)->bool {
+                if( const auto* pe = te.fcn.opt_Path() )
+                {
+                    MonomorphState  unused;
+                    auto v = m_resolve.get_value(mir_res.sp, *pe, unused, /*signature_only=*/true);
+                    if( const auto* fe = v.opt_Function() )
+                        return (*fe)->m_cold || (*fe)->m_return.m_data.is_Diverge();
+                }
+                return false;
+                };
+            ::std::vector<bool> bb_is_cold( code->blocks.size() );
+            for(bool changed = true; changed; )
+            {
+                changed = false;
+                for(unsigned int i = 0; i < code->blocks.size(); i ++)
+                {
+                    if( bb_is_cold[i] )
+                        continue ;
+                    bool is_cold = false;
+                    TU_MATCH_DEF(::MIR::Terminator, (code->blocks[i].terminator), (te),
+                    (
+                        ),
+                    (Diverge,
+                        is_cold = true;
+                        ),
+                    (Panic,
+                        is_cold = true;
+                        ),
+                    (Goto,
+                        is_cold = bb_is_cold[te];
+                        ),
+                    (If,
+                        is_cold = bb_is_cold[te.bb0] && bb_is_cold[te.bb1];
+                        ),
+                    (Call,
+                        is_cold = bb_is_cold[te.ret_block] || is_cold_call(te);
+                        )
+                    )
+                    if( is_cold )
+                    {
+                        bb_is_cold[i] = true;
+                        changed = true;
+                    }
+                }
+            }
+
+            if( m_options.structured_c )
             {
-                m_of << "#if 0\n";
-                auto nodes = MIR_To_Structured(*code);
                 for(const auto& node : nodes)
                 {
-                    emit_fcn_node(mir_res, node, 1);
+                    emit_fcn_node(mir_res, node, 1, labels, bb_is_cold);
                 }
-                m_of << "#endif\n";
+                m_of << "}\n";
+                m_of.flush();
+                finish_function_locals(mir_res);
+                m_mir_res = nullptr;
+                return ;
             }
 
             for(unsigned int i = 0; i < code->blocks.size(); i ++)
@@ -1985,7 +2357,16 @@ namespace {
                     m_of << "\tgoto bb" << e << "; /* panic */\n";
                     ),
                 (If,
-                    m_of << "\tif("; emit_lvalue(e.cond); m_of << ") goto bb" << e.bb0 << "; else goto bb" << e.bb1 << ";\n";
+                    m_of << "\tif(";
+                    if( m_compiler == Compiler::Gcc && bb_is_cold[e.bb0] != bb_is_cold[e.bb1] )
+                    {
+                        m_of << "__builtin_expect("; emit_lvalue(e.cond); m_of << ", " << (bb_is_cold[e.bb0] ? 0 : 1) << ")";
+                    }
+                    else
+                    {
+                        emit_lvalue(e.cond);
+                    }
+                    m_of << ") goto bb" << e.bb0 << "; else goto bb" << e.bb1 << ";\n";
                     ),
                 (Switch,
                     ::HIR::TypeRef  tmp;
@@ -1993,14 +2374,27 @@ namespace {
                     MIR_ASSERT(mir_res, ty.m_data.is_Path(), "");
                     MIR_ASSERT(mir_res, ty.m_data.as_Path().binding.is_Enum(), "");
                     const auto* enm = ty.m_data.as_Path().binding.as_Enum();
-                    auto it = m_enum_repr_cache.find( ty.m_data.as_Path().path.m_data.as_Generic() );
-                    if( it != m_enum_repr_cache.end() )
+                    if( const auto* repr = get_niche_repr(mir_res.sp, ty) )
                     {
-                        MIR_ASSERT(mir_res, e.targets.size() == 2, "Non-zero optimised type a variant count that isn't 2");
-                        m_of << "\tif("; emit_lvalue(e.val); emit_nonzero_path(it->second); m_of << ")\n";
-                        m_of << "\t\tgoto bb" << e.targets[1] << ";\n";
-                        m_of << "\telse\n";
-                        m_of << "\t\tgoto bb" << e.targets[0] << ";\n";
+                        MIR_ASSERT(mir_res, e.targets.size() == enm->m_variants.size(), "Niche enum switch with wrong target count");
+                        if( repr->niche_count == 1 )
+                        {
+                            m_of << "\tif("; emit_niche_is_data(*repr, [&](){ emit_lvalue(e.val); }); m_of << ")\n";
+                            m_of << "\t\tgoto bb" << e.targets[repr->data_variant] << ";\n";
+                            m_of << "\telse\n";
+                            m_of << "\t\tgoto bb" << e.targets[repr->data_variant == 0 ? 1 : 0] << ";\n";
+                        }
+                        else
+                        {
+                            m_of << "\tswitch("; emit_niche_slot(*repr, [&](){ emit_lvalue(e.val); }); m_of << ") {\n";
+                            for(unsigned int j = 0; j < e.targets.size(); j ++)
+                            {
+                                if( j != repr->data_variant )
+                                    m_of << "\t\tcase " << repr->niche_value(j) << ": goto bb" << e.targets[j] << ";\n";
+                            }
+                            m_of << "\t\tdefault: goto bb" << e.targets[repr->data_variant] << ";\n";
+                            m_of << "\t}\n";
+                        }
                     }
                     else if( enm->is_value() )
                     {
@@ -2040,103 +2434,770 @@ namespace {
             }
             m_of << "}\n";
             m_of.flush();
+            finish_function_locals(mir_res);
             m_mir_res = nullptr;
         }
 
-        void emit_fcn_node(::MIR::TypeResolve& mir_res, const Node& node, unsigned indent_level)
+        void emit_local_decl(unsigned idx, unsigned indent_level)
+        {
+            const auto& ty = m_mir_res->m_fcn.locals.at(idx);
+            m_of << RepeatLitStr { "\t", static_cast<int>(indent_level) };
+            emit_ctype(ty, FMT_CB(ss, ss << "var" << idx;)); m_of << ";";
+            m_of << "\t// " << ty;
+            m_of << "\n";
+        }
+        void finish_function_locals(const ::MIR::TypeResolve& mir_res)
+        {
+            for(unsigned i = 0; i < m_inline_pending.size(); i ++)
+                MIR_ASSERT(mir_res, !m_inline_pending[i], "Inline temporary var" << i << " was never used");
+            m_inline_defs.clear();
+            m_inline_pending.clear();
+            m_local_is_inline.clear();
+            m_scope_locals.clear();
+        }
+
+        /// Can `src` be emitted as a C expression of type `dst_ty` (with no side-effects, and reading each operand once)
+        bool is_inlinable_rvalue(const ::MIR::TypeResolve& mir_res, const ::HIR::TypeRef& dst_ty, const ::MIR::RValue& src) const
+        {
+            if( !dst_ty.m_data.is_Primitive() || type_is_emulated_i128(dst_ty) )
+                return false;
+            ::HIR::TypeRef  tmp, tmp_r;
+            if( const auto* e = src.opt_BinOp() )
+            {
+                switch(e->op)
+                {
+                case ::MIR::eBinOp::ADD_OV:
+                case ::MIR::eBinOp::SUB_OV:
+                case ::MIR::eBinOp::MUL_OV:
+                case ::MIR::eBinOp::DIV_OV:
+                    return false;
+                default:
+                    break;
+                }
+                const auto& ty = mir_res.get_param_type(tmp, e->val_l);
+                const auto& ty_r = mir_res.get_param_type(tmp_r, e->val_r);
+                if( !ty.m_data.is_Primitive() || type_is_emulated_i128(ty) || type_is_emulated_i128(ty_r) )
+                    return false;
+                // Float remainder is a libm call
+                if( e->op == ::MIR::eBinOp::MOD && (ty == ::HIR::CoreType::F32 || ty == ::HIR::CoreType::F64) )
+                    return false;
+                return true;
+            }
+            else if( src.is_UniOp() )
+            {
+                return true;
+            }
+            else if( const auto* e = src.opt_Cast() )
+            {
+                const auto& ty = mir_res.get_lvalue_type(tmp, e->val);
+                return ty.m_data.is_Primitive() && !type_is_emulated_i128(ty) && e->type == dst_ty;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        void emit_inline_rvalue(const ::MIR::TypeResolve& mir_res, const ::HIR::TypeRef& ty, const ::MIR::RValue& src)
+        {
+            // Comparisons are already 0/1
+            if( const auto* e = src.opt_BinOp() )
+            {
+                switch(e->op)
+                {
+                case ::MIR::eBinOp::EQ: case ::MIR::eBinOp::NE:
+                case ::MIR::eBinOp::GT: case ::MIR::eBinOp::GE:
+                case ::MIR::eBinOp::LT: case ::MIR::eBinOp::LE:
+                    m_of << "("; emit_binop_prim(mir_res, *e); m_of << ")";
+                    return ;
+                default:
+                    break;
+                }
+            }
+            // NOTE: The cast truncates the result like the assignment would have (C promotes small integers to `int`)
+            m_of << "(("; emit_ctype(ty); m_of << ")(";
+            if( const auto* e = src.opt_BinOp() )
+                emit_binop_prim(mir_res, *e);
+            else if( const auto* e = src.opt_UniOp() )
+                emit_uniop_prim(*e, ty);
+            else if( const auto* e = src.opt_Cast() )
+                emit_lvalue(e->val);
+            else
+                MIR_BUG(mir_res, "Unexpected inline temporary value " << src);
+            m_of << "))";
+        }
+
+        static void get_successors(const ::MIR::Terminator& term, ::std::vector<size_t>& out)
+        {
+            TU_MATCHA( (term), (te),
+            (Incomplete, ),
+            (Return, ),
+            (Diverge, ),
+            (Goto,
+                out.push_back(te);
+                ),
+            (Panic,
+                out.push_back(te.dst);
+                ),
+            (If,
+                out.push_back(te.bb0);
+                out.push_back(te.bb1);
+                ),
+            (Switch,
+                out.insert(out.end(), te.targets.begin(), te.targets.end());
+                ),
+            (SwitchValue,
+                out.insert(out.end(), te.targets.begin(), te.targets.end());
+                out.push_back(te.def_target);
+                ),
+            (Call,
+                out.push_back(te.ret_block);
+                out.push_back(te.panic_block);
+                )
+            )
+        }
+        /// Locals that are live on entry to each basic block (bitsets indexed by local)
+        struct LocalLiveness
+        {
+            size_t  n_words;
+            ::std::vector<uint64_t> live_in;
+
+            bool is_live_in(size_t bb_idx, unsigned idx) const {
+                return (live_in[bb_idx * n_words + idx / 64] >> (idx % 64)) & 1;
+            }
+        };
+        static LocalLiveness get_local_liveness(const ::MIR::Function& fcn)
+        {
+            const size_t n_words = (fcn.locals.size() + 63) / 64;
+            ::std::vector<uint64_t> bs_use( fcn.blocks.size() * n_words );
+            ::std::vector<uint64_t> bs_def( fcn.blocks.size() * n_words );
+            ::std::vector<uint64_t> bs_live_in( fcn.blocks.size() * n_words );
+            auto bs_test = [&](const ::std::vector<uint64_t>& bs, size_t bb_idx, unsigned idx) { return (bs[bb_idx * n_words + idx / 64] >> (idx % 64)) & 1; };
+            auto bs_set = [&](::std::vector<uint64_t>& bs, size_t bb_idx, unsigned idx) { bs[bb_idx * n_words + idx / 64] |= uint64_t(1) << (idx % 64); };
+
+            for(size_t bb_idx = 0; bb_idx < fcn.blocks.size(); bb_idx ++)
+            {
+                const auto& bb = fcn.blocks[bb_idx];
+                auto cb_use = [&](const ::MIR::LValue& lv, ::MIR::visit::ValUsage ) {
+                    if( lv.is_Local() && !bs_test(bs_def, bb_idx, lv.as_Local()) )
+                        bs_set(bs_use, bb_idx, lv.as_Local());
+                    return false;
+                    };
+                // Only a write to the whole local kills its value
+                auto assigned = [&](const ::MIR::LValue& lv) {
+                    if( lv.is_Local() ) {
+                        if( !bs_test(bs_use, bb_idx, lv.as_Local()) )
+                            bs_set(bs_def, bb_idx, lv.as_Local());
+                    }
+                    else {
+                        ::MIR::visit::visit_mir_lvalue(lv, ::MIR::visit::ValUsage::Write, cb_use);
+                    }
+                    };
+                for(const auto& stmt : bb.statements)
+                {
+                    if( const auto* se = stmt.opt_Assign() ) {
+                        ::MIR::visit::visit_mir_lvalues(se->src, cb_use);
+                        assigned(se->dst);
+                    }
+                    else {
+                        ::MIR::visit::visit_mir_lvalues(stmt, cb_use);
+                    }
+                }
+                if( const auto* te = bb.terminator.opt_Call() ) {
+                    if( te->fcn.is_Value() )
+                        ::MIR::visit::visit_mir_lvalue(te->fcn.as_Value(), ::MIR::visit::ValUsage::Read, cb_use);
+                    for(const auto& v : te->args)
+                        ::MIR::visit::visit_mir_lvalue(v, ::MIR::visit::ValUsage::Read, cb_use);
+                    assigned(te->ret_val);
+                }
+                else {
+                    ::MIR::visit::visit_mir_lvalues(bb.terminator, cb_use);
+                }
+            }
+
+            ::std::vector<size_t>   succs;
+            ::std::vector<uint64_t> live_out( n_words );
+            for(bool changed = true; changed; )
+            {
+                changed = false;
+                for(size_t bb_idx = fcn.blocks.size(); bb_idx --; )
+                {
+                    succs.clear();
+                    get_successors(fcn.blocks[bb_idx].terminator, succs);
+                    ::std::fill(live_out.begin(), live_out.end(), 0);
+                    for(auto s : succs)
+                        for(size_t w = 0; w < n_words; w ++)
+                            live_out[w] |= bs_live_in[s * n_words + w];
+                    for(size_t w = 0; w < n_words; w ++)
+                    {
+                        size_t ofs = bb_idx * n_words + w;
+                        uint64_t v = bs_use[ofs] | (live_out[w] & ~bs_def[ofs]);
+                        if( v != bs_live_in[ofs] ) {
+                            bs_live_in[ofs] = v;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+            return LocalLiveness { n_words, mv$(bs_live_in) };
+        }
+
+        /// Locate temporaries that are assigned a simple expression and then immediately read once.
+        /// These are emitted as part of the using expression instead of being stored.
+        void find_inline_temporaries(const ::MIR::TypeResolve& mir_res, const LocalLiveness& liveness)
+        {
+            const auto& fcn = mir_res.m_fcn;
+            m_inline_defs.clear();
+            m_inline_pending.assign( fcn.locals.size(), nullptr );
+
+            // Number of statements (and terminators) that refer to each local
+            ::std::vector<unsigned> n_mentions( fcn.locals.size() );
+            ::std::vector<unsigned> n_inlined( fcn.locals.size() );
+            ::std::vector<unsigned> mentioned;
+            auto cb_mention = [&](const ::MIR::LValue& lv, ::MIR::visit::ValUsage ) {
+                if( lv.is_Local() )
+                    mentioned.push_back(lv.as_Local());
+                return false;
+                };
+            auto count_mentions = [&]() {
+                ::std::sort(mentioned.begin(), mentioned.end());
+                mentioned.erase( ::std::unique(mentioned.begin(), mentioned.end()), mentioned.end() );
+                for(auto idx : mentioned)
+                    n_mentions[idx] ++;
+                mentioned.clear();
+                };
+            for(const auto& bb : fcn.blocks)
+            {
+                for(const auto& stmt : bb.statements)
+                {
+                    ::MIR::visit::visit_mir_lvalues(stmt, cb_mention);
+                    count_mentions();
+                }
+                ::MIR::visit::visit_mir_lvalues(bb.terminator, cb_mention);
+                count_mentions();
+            }
+
+            ::std::vector<size_t>   succs;
+            // Locals with a pending value (a run of inline definitions is only emitted at the end of the run)
+            ::std::vector<unsigned> pending;
+            auto mark_inline = [&](const ::MIR::Statement& stmt) {
+                DEBUG("Inline temporary " << stmt);
+                auto idx = stmt.as_Assign().dst.as_Local();
+                m_inline_defs.insert(&stmt);
+                pending.push_back(idx);
+                n_inlined[idx] ++;
+                };
+            for(size_t bb_idx = 0; bb_idx < fcn.blocks.size(); bb_idx ++)
+            {
+                const auto& bb = fcn.blocks[bb_idx];
+                pending.clear();
+                for(size_t i = 0; i < bb.statements.size(); i ++)
+                {
+                    if( i > 0 )
+                    {
+                        const auto& prev = bb.statements[i-1];
+                        if( !m_inline_defs.count(&prev) && !prev.is_ScopeEnd() && !prev.is_SetDropFlag() )
+                            pending.clear();
+                    }
+                    const auto* se = bb.statements[i].opt_Assign();
+                    if( !se || !se->dst.is_Local() )
+                        continue ;
+                    auto idx = se->dst.as_Local();
+                    if( !is_inlinable_rvalue(mir_res, fcn.locals[idx], se->src) )
+                        continue ;
+                    if( ::std::find(pending.begin(), pending.end(), idx) != pending.end() )
+                        continue ;
+                    unsigned n_reads = 0, n_other = 0;
+                    auto cb_use = [&](const ::MIR::LValue& lv, ::MIR::visit::ValUsage vu) {
+                        if( lv == se->dst ) {
+                            if( vu == ::MIR::visit::ValUsage::Read )
+                                n_reads ++;
+                            else if( vu != ::MIR::visit::ValUsage::Move )
+                                n_other ++;
+                        }
+                        return false;
+                        };
+                    ::MIR::visit::visit_mir_lvalues(se->src, cb_use);
+                    if( n_reads > 0 )
+                        continue ;
+
+                    // The value must be read exactly once, by the next statement (or the terminator)
+                    size_t j = i + 1;
+                    while( j < bb.statements.size() && (bb.statements[j].is_ScopeEnd() || bb.statements[j].is_SetDropFlag()) )
+                        j ++;
+                    if( j < bb.statements.size() )
+                    {
+                        // Only statements that emit each operand exactly once
+                        const auto* ue = bb.statements[j].opt_Assign();
+                        if( !ue )
+                            continue ;
+                        if( const auto* ce = ue->src.opt_Cast() ) {
+                            if( !ce->type.m_data.is_Primitive() )
+                                continue ;
+                        }
+                        else if( !(ue->src.is_Use() || ue->src.is_BinOp() || ue->src.is_UniOp()) ) {
+                            continue ;
+                        }
+                        ::MIR::visit::visit_mir_lvalues(bb.statements[j], cb_use);
+                    }
+                    else
+                    {
+                        if( !bb.terminator.is_If() )
+                            continue ;
+                        ::MIR::visit::visit_mir_lvalues(bb.terminator, cb_use);
+                    }
+                    if( n_reads != 1 || n_other != 0 )
+                        continue ;
+
+                    // - and then be dead (next reference is an overwrite, or not live out of the block)
+                    bool is_mentioned = false;
+                    auto cb_any = [&](const ::MIR::LValue& lv, ::MIR::visit::ValUsage ) {
+                        is_mentioned |= (lv == se->dst);
+                        return false;
+                        };
+                    bool is_dead = false;
+                    size_t k = j + 1;
+                    for(; k < bb.statements.size(); k ++)
+                    {
+                        const auto& stmt = bb.statements[k];
+                        if( const auto* ae = stmt.opt_Assign() )
+                        {
+                            ::MIR::visit::visit_mir_lvalues(ae->src, cb_any);
+                            if( !is_mentioned && ae->dst == se->dst ) {
+                                is_dead = true;
+                                break;
+                            }
+                        }
+                        ::MIR::visit::visit_mir_lvalues(stmt, cb_any);
+                        if( is_mentioned )
+                            break;
+                    }
+                    if( k >= bb.statements.size() )
+                    {
+                        if( j < bb.statements.size() )
+                        {
+                            if( const auto* te = bb.terminator.opt_Call() ) {
+                                if( te->fcn.is_Value() )
+                                    ::MIR::visit::visit_mir_lvalue(te->fcn.as_Value(), ::MIR::visit::ValUsage::Read, cb_any);
+                                for(const auto& v : te->args)
+                                    ::MIR::visit::visit_mir_lvalue(v, ::MIR::visit::ValUsage::Read, cb_any);
+                                is_dead = !is_mentioned && te->ret_val == se->dst;
+                            }
+                            ::MIR::visit::visit_mir_lvalues(bb.terminator, cb_any);
+                        }
+                        if( !is_mentioned && !is_dead )
+                        {
+                            succs.clear();
+                            get_successors(bb.terminator, succs);
+                            is_dead = true;
+                            for(auto s : succs)
+                                is_dead &= !liveness.is_live_in(s, idx);
+                        }
+                    }
+                    if( is_dead )
+                        mark_inline(bb.statements[i]);
+                }
+            }
+
+            // Locals that are only used as inline temporaries don't need to be declared
+            m_local_is_inline.resize( fcn.locals.size() );
+            for(size_t idx = 0; idx < fcn.locals.size(); idx ++)
+                m_local_is_inline[idx] = (n_inlined[idx] > 0 && n_mentions[idx] == 2 * n_inlined[idx]);
+        }
+
+
+        // Shapes of structured nodes (shared between the emitter and `place_scoped_locals`)
+        enum class IfLayout {
+            Negated,    // `if(!c) { false arm }` (true arm just falls through)
+            JumpTrue,   // `if(c) jump;` followed by the false arm
+            JumpFalse,  // `if(!c) jump;` followed by the true arm
+            Full,   // `if(c) { true arm } else { false arm }` (no `else` if the false arm just falls through)
+        };
+        // An arm that is only a jump (no code of its own)
+        static bool is_bare_jump(const NodeRef& arm, NodeExit exit)
+        {
+            const auto& b = arm.node->as_Block();
+            return b.nodes.empty() && b.next_exit == exit;
+        }
+        static bool is_bare_nonlocal_jump(const NodeRef& arm)
+        {
+            const auto& b = arm.node->as_Block();
+            return b.nodes.empty() && b.next_exit != NodeExit::Fallthrough;
+        }
+        static IfLayout get_if_layout(const Node::Data_If& e)
+        {
+            if( is_bare_jump(e.arm_true, NodeExit::Fallthrough) && !is_bare_jump(e.arm_false, NodeExit::Fallthrough) )
+                return IfLayout::Negated;
+            // An arm that just jumps elsewhere doesn't need the other arm nested in an `else`
+            if( is_bare_nonlocal_jump(e.arm_true) )
+                return IfLayout::JumpTrue;
+            if( is_bare_nonlocal_jump(e.arm_false) )
+                return IfLayout::JumpFalse;
+            return IfLayout::Full;
+        }
+        /// `for(;;) { if(c) {...} else break; }` (with no code before the condition) becomes `while(c) {...}`
+        /// - Returns the `if` at the head of the loop if this applies
+        const Node::Data_If* get_while_head(const ::MIR::Function& fcn, const Node::Data_Block& body, bool& exit_on_true) const
+        {
+            if( body.nodes.size() != 2 || body.next_bb != SIZE_MAX || body.nodes[0].node || !body.nodes[1].node )
+                return nullptr;
+            const auto* head_if = body.nodes[1].node->opt_If();
+            if( !head_if )
+                return nullptr;
+            // Inline temporaries become part of the condition
+            for(const auto& stmt : fcn.blocks.at(body.nodes[0].bb_idx).statements)
+            {
+                if( m_inline_defs.count(&stmt) == 0 )
+                    return nullptr;
+            }
+            if( is_bare_jump(head_if->arm_true, NodeExit::Break) )
+                exit_on_true = true;
+            else if( is_bare_jump(head_if->arm_false, NodeExit::Break) )
+                exit_on_true = false;
+            else
+                return nullptr;
+            return head_if;
+        }
+
+        /// Pick the innermost C block that each local can be declared in (instead of the top of the function)
+        /// - Returns the set of locals that have been placed (in `m_scope_locals`)
+        ::std::vector<bool> place_scoped_locals(const ::MIR::TypeResolve& mir_res, const LocalLiveness& liveness, const ::std::vector<Node>& nodes, const ::std::vector<bool>& labels)
+        {
+            TRACE_FUNCTION;
+            const auto& fcn = mir_res.m_fcn;
+            m_scope_locals.clear();
+
+            // Tree of braced blocks in the emitted function (index 0 is the function body)
+            struct Scope {
+                size_t  parent;
+                unsigned int    depth;
+                const Node* node;
+                // Blocks where control can enter the scope (the first one emitted, and any with a label)
+                ::std::vector<size_t>   entries;
+            };
+            ::std::vector<Scope>    scopes;
+            scopes.push_back(Scope { SIZE_MAX, 0, nullptr, {} });
+            ::std::vector<size_t>   bb_scope( fcn.blocks.size(), SIZE_MAX );
+
+            auto add_leaf = [&](size_t bb_idx, size_t scope) {
+                bb_scope[bb_idx] = scope;
+                for(size_t s = scope; s != SIZE_MAX; s = scopes[s].parent)
+                {
+                    if( scopes[s].entries.empty() || labels[bb_idx] )
+                        scopes[s].entries.push_back(bb_idx);
+                }
+                };
+            ::std::function<void(const Node&, size_t)>  walk;
+            auto open_scope = [&](const NodeRef& nr, size_t parent) {
+                scopes.push_back(Scope { parent, scopes[parent].depth + 1, nr.node.get(), {} });
+                walk(*nr.node, scopes.size() - 1);
+                };
+            walk = [&](const Node& node, size_t scope) {
+                TU_MATCHA( (node), (e),
+                (Block,
+                    for(const auto& snr : e.nodes)
+                    {
+                        if( snr.node )
+                            walk(*snr.node, scope);
+                        else
+                            add_leaf(snr.bb_idx, scope);
+                    }
+                    ),
+                (If,
+                    switch( get_if_layout(e) )
+                    {
+                    case IfLayout::Negated:
+                        open_scope(e.arm_false, scope);
+                        break;
+                    case IfLayout::JumpTrue:
+                        walk(*e.arm_false.node, scope);
+                        break;
+                    case IfLayout::JumpFalse:
+                        walk(*e.arm_true.node, scope);
+                        break;
+                    case IfLayout::Full:
+                        open_scope(e.arm_true, scope);
+                        if( !is_bare_jump(e.arm_false, NodeExit::Fallthrough) )
+                            open_scope(e.arm_false, scope);
+                        break;
+                    }
+                    ),
+                (Switch,
+                    for(const auto& arm : e.arms)
+                    {
+                        if( !arm.node->as_Block().nodes.empty() )
+                            open_scope(arm, scope);
+                    }
+                    ),
+                (Loop,
+                    const auto& body = e.code.node->as_Block();
+                    bool exit_on_true = false;
+                    if( const auto* head_if = get_while_head(fcn, body, exit_on_true) )
+                    {
+                        add_leaf(body.nodes[0].bb_idx, scope);
+                        open_scope(exit_on_true ? head_if->arm_false : head_if->arm_true, scope);
+                    }
+                    else
+                    {
+                        open_scope(e.code, scope);
+                    }
+                    )
+                )
+                };
+            for(const auto& node : nodes)
+                walk(node, 0);
+
+            // Locals that are borrowed (or used by asm) are kept at the top, as pointers to them can outlive any use.
+            ::std::vector<bool> is_pinned( fcn.locals.size() );
+            for(const auto& bb : fcn.blocks)
+            {
+                for(const auto& stmt : bb.statements)
+                {
+                    if( const auto* se = stmt.opt_Asm() )
+                    {
+                        for(const auto& v : se->inputs)
+                            ::MIR::visit::visit_mir_lvalue(v.second, ::MIR::visit::ValUsage::Read, [&](const auto& lv, auto ){ if(lv.is_Local()) is_pinned[lv.as_Local()] = true; return false; });
+                        for(const auto& v : se->outputs)
+                            ::MIR::visit::visit_mir_lvalue(v.second, ::MIR::visit::ValUsage::Write, [&](const auto& lv, auto ){ if(lv.is_Local()) is_pinned[lv.as_Local()] = true; return false; });
+                    }
+                    else if( stmt.is_Assign() && stmt.as_Assign().src.is_Borrow() )
+                    {
+                        const auto* lv = &stmt.as_Assign().src.as_Borrow().val;
+                        for(;;)
+                        {
+                            if( const auto* le = lv->opt_Field() )
+                                lv = &*le->val;
+                            else if( const auto* le = lv->opt_Index() )
+                                lv = &*le->val;
+                            else if( const auto* le = lv->opt_Downcast() )
+                                lv = &*le->val;
+                            else
+                                break;
+                        }
+                        if( lv->is_Local() )
+                            is_pinned[lv->as_Local()] = true;
+                    }
+                }
+            }
+
+            // Innermost scope containing every access to each local
+            ::std::vector<size_t>   local_scope( fcn.locals.size(), SIZE_MAX );
+            for(size_t bb_idx = 0; bb_idx < fcn.blocks.size(); bb_idx ++)
+            {
+                if( bb_scope[bb_idx] == SIZE_MAX )
+                    continue ;
+                auto cb = [&](const ::MIR::LValue& lv, ::MIR::visit::ValUsage ) {
+                    if( !lv.is_Local() )
+                        return false;
+                    size_t a = bb_scope[bb_idx];
+                    size_t b = local_scope[lv.as_Local()];
+                    if( b != SIZE_MAX )
+                    {
+                        while( scopes[a].depth > scopes[b].depth )  a = scopes[a].parent;
+                        while( scopes[b].depth > scopes[a].depth )  b = scopes[b].parent;
+                        while( a != b ) {
+                            a = scopes[a].parent;
+                            b = scopes[b].parent;
+                        }
+                    }
+                    local_scope[lv.as_Local()] = a;
+                    return false;
+                    };
+                for(const auto& stmt : fcn.blocks[bb_idx].statements)
+                    ::MIR::visit::visit_mir_lvalues(stmt, cb);
+                ::MIR::visit::visit_mir_lvalues(fcn.blocks[bb_idx].terminator, cb);
+            }
+
+            // Move each local out to a scope that it isn't live on entry to
+            ::std::vector<bool> rv( fcn.locals.size() );
+            for(unsigned idx = 0; idx < fcn.locals.size(); idx ++)
+            {
+                if( m_local_is_inline[idx] || is_pinned[idx] )
+                    continue ;
+                size_t s = local_scope[idx];
+                while( s != 0 && s != SIZE_MAX )
+                {
+                    bool is_live = false;
+                    for(auto bb_idx : scopes[s].entries)
+                        is_live |= liveness.is_live_in(bb_idx, idx);
+                    if( !is_live )
+                        break;
+                    s = scopes[s].parent;
+                }
+                if( s != 0 && s != SIZE_MAX )
+                {
+                    DEBUG("var" << idx << " declared in scope " << s);
+                    m_scope_locals[scopes[s].node].push_back(idx);
+                    rv[idx] = true;
+                }
+            }
+            return rv;
+        }
+
+        void emit_fcn_node(::MIR::TypeResolve& mir_res, const Node& node, unsigned indent_level, const ::std::vector<bool>& labels, const ::std::vector<bool>& bb_is_cold)
         {
             auto indent = RepeatLitStr { "\t", static_cast<int>(indent_level) };
+            // Condition of an `if`, with a branch hint if only one arm is cold
+            auto emit_cond = [&](const ::MIR::Terminator::Data_If& te, bool negate) {
+                if( negate )
+                    m_of << "!";
+                if( m_compiler == Compiler::Gcc && bb_is_cold[te.bb0] != bb_is_cold[te.bb1] )
+                {
+                    m_of << "__builtin_expect("; emit_lvalue(te.cond); m_of << ", " << (bb_is_cold[te.bb0] ? 0 : 1) << ")";
+                }
+                else
+                {
+                    emit_lvalue(te.cond);
+                }
+                };
+            auto emit_exit = [&](const Node::Data_Block& b) {
+                switch(b.next_exit)
+                {
+                case NodeExit::None:
+                case NodeExit::Fallthrough:
+                    break;
+                case NodeExit::Continue:
+                    m_of << "continue;";
+                    break;
+                case NodeExit::Break:
+                    m_of << "break;";
+                    break;
+                case NodeExit::Goto:
+                    m_of << "goto bb" << b.next_bb << ";";
+                    break;
+                }
+                };
+            // Locals only used within this block
+            auto it = m_scope_locals.find(&node);
+            if( it != m_scope_locals.end() )
+            {
+                for(auto idx : it->second)
+                    emit_local_decl(idx, indent_level);
+            }
             TU_MATCHA( (node), (e),
             (Block,
                 for(size_t i = 0; i < e.nodes.size(); i ++)
                 {
                     const auto& snr = e.nodes[i];
                     if( snr.node ) {
-                        emit_fcn_node(mir_res, *snr.node, indent_level);
+                        emit_fcn_node(mir_res, *snr.node, indent_level, labels, bb_is_cold);
+                        continue ;
+                    }
+                    DEBUG(mir_res << "BB" << snr.bb_idx);
+                    if( labels[snr.bb_idx] ) {
+                        m_of << indent << "bb" << snr.bb_idx << ": ;\n";
+                    }
+                    const auto& bb = mir_res.m_fcn.blocks.at(snr.bb_idx);
+                    for(const auto& stmt : bb.statements)
+                    {
+                        mir_res.set_cur_stmt(snr.bb_idx, (&stmt - &bb.statements.front()));
+                        this->emit_statement(mir_res, stmt, indent_level);
                     }
-                    else {
-                        DEBUG(mir_res << "BB" << snr.bb_idx);
-                        m_of << indent << "bb" << snr.bb_idx << ":\n";
-                        const auto& bb = mir_res.m_fcn.blocks.at(snr.bb_idx);
-                        for(const auto& stmt : bb.statements)
-                        {
-                            mir_res.set_cur_stmt(snr.bb_idx, (&stmt - &bb.statements.front()));
-                            this->emit_statement(mir_res, stmt, indent_level);
-                        }
 
-                        TU_MATCHA( (bb.terminator), (te),
-                        (Incomplete, ),
-                        (Return,
-                            assert(i == e.nodes.size()-1 && "Return");
-                            m_of << indent << "return;\n";
-                            ),
-                        (Goto,
-                            // Ignore (handled by caller)
-                            ),
-                        (Diverge,
-                            ),
-                        (Panic,
-                            ),
-                        (If,
-                            //assert(i == e.nodes.size()-1 && "If");
-                            ),
-                        (Call,
-                            // TODO: Emit call
-                            emit_term_call(mir_res, te, indent_level);
-                            ),
-                        (Switch,
-                            //assert(i == e.nodes.size()-1 && "Switch");
-                            ),
-                        (SwitchValue,
-                            //assert(i == e.nodes.size()-1 && "Switch");
-                            )
+                    mir_res.set_cur_stmt_term(snr.bb_idx);
+                    TU_MATCHA( (bb.terminator), (te),
+                    (Incomplete,
+                        m_of << indent << "for(;;);\n";
+                        ),
+                    (Return,
+                        m_of << indent << "return rv;\n";
+                        ),
+                    (Diverge,
+                        m_of << indent << "_Unwind_Resume();\n";
+                        ),
+                    (Goto,
+                        // Handled by the containing node
+                        ),
+                    (Panic,
+                        ),
+                    (If,
+                        ),
+                    (Call,
+                        emit_term_call(mir_res, te, indent_level);
+                        ),
+                    (Switch,
+                        ),
+                    (SwitchValue,
+                        MIR_TODO(mir_res, "SwitchValue in C codegen");
                         )
-                    }
+                    )
+                }
+                if( e.next_exit != NodeExit::None && e.next_exit != NodeExit::Fallthrough )
+                {
+                    m_of << indent; emit_exit(e); m_of << "\n";
                 }
                 ),
             (If,
-                m_of << indent << "if("; emit_lvalue(*e.val); m_of << ") {\n";
-                if( e.arm_true.node ) {
-                    emit_fcn_node(mir_res, *e.arm_true.node, indent_level+1);
-                }
-                else {
-                    m_of << indent << "\tgoto bb" << e.arm_true.bb_idx << ";\n";
+                auto layout = get_if_layout(e);
+                if( layout == IfLayout::Negated )
+                {
+                    m_of << indent << "if("; emit_cond(*e.te, true); m_of << ") {\n";
+                    emit_fcn_node(mir_res, *e.arm_false.node, indent_level+1, labels, bb_is_cold);
+                    m_of << indent << "}\n";
                 }
-                m_of << indent << "}\n";
-                m_of << indent << "else {\n";
-                if( e.arm_false.node ) {
-                    emit_fcn_node(mir_res, *e.arm_false.node, indent_level+1);
+                else if( layout == IfLayout::JumpTrue || layout == IfLayout::JumpFalse )
+                {
+                    bool jump_on_true = (layout == IfLayout::JumpTrue);
+                    const auto& jump_arm = (jump_on_true ? e.arm_true : e.arm_false).node->as_Block();
+                    m_of << indent << "if("; emit_cond(*e.te, !jump_on_true); m_of << ") "; emit_exit(jump_arm); m_of << "\n";
+                    emit_fcn_node(mir_res, *(jump_on_true ? e.arm_false : e.arm_true).node, indent_level, labels, bb_is_cold);
                 }
-                else {
-                    m_of << indent << "\tgoto bb" << e.arm_false.bb_idx << ";\n";
+                else
+                {
+                    m_of << indent << "if("; emit_cond(*e.te, false); m_of << ") {\n";
+                    emit_fcn_node(mir_res, *e.arm_true.node, indent_level+1, labels, bb_is_cold);
+                    if( is_bare_jump(e.arm_false, NodeExit::Fallthrough) )
+                    {
+                        m_of << indent << "}\n";
+                    }
+                    else
+                    {
+                        m_of << indent << "}\n";
+                        m_of << indent << "else {\n";
+                        emit_fcn_node(mir_res, *e.arm_false.node, indent_level+1, labels, bb_is_cold);
+                        m_of << indent << "}\n";
+                    }
                 }
-                m_of << indent << "}\n";
                 ),
             (Switch,
-                this->emit_term_switch(mir_res, *e.val, e.arms.size(), indent_level, [&](auto idx) {
-                    const auto& arm = e.arms.at(idx);
-                    if( arm.node ) {
-                        m_of << "{\n";
-                        this->emit_fcn_node(mir_res, *arm.node, indent_level+1);
-                        m_of << indent  << "\t} ";
-                        if( arm.has_target() && arm.target() != e.next_bb ) {
-                            m_of << "goto bb" << arm.target() << ";";
-                        }
-                        else {
-                            m_of << "break;";
-                        }
+                this->emit_term_switch(mir_res, e.te->val, e.arms.size(), indent_level, [&](auto idx) {
+                    const auto& arm = e.arms.at(idx).node->as_Block();
+                    if( arm.nodes.empty() ) {
+                        MIR_ASSERT(mir_res, arm.next_exit != NodeExit::None && arm.next_exit != NodeExit::Fallthrough, "Empty switch arm without a jump");
+                        emit_exit(arm);
                     }
                     else {
-                        m_of << "goto bb" << arm.bb_idx << ";";
+                        m_of << "{\n";
+                        this->emit_fcn_node(mir_res, *e.arms.at(idx).node, indent_level+1, labels, bb_is_cold);
+                        m_of << indent << "\t}";
                     }
                     });
                 ),
             (Loop,
-                m_of << indent << "for(;;) {\n";
-                assert(e.code.node);
-                assert(e.code.node->is_Block());
-                this->emit_fcn_node(mir_res, *e.code.node, indent_level+1);
-                m_of << indent << "}\n";
+                const auto& body = e.code.node->as_Block();
+                bool exit_on_true = false;
+                if( const auto* head_if = get_while_head(mir_res.m_fcn, body, exit_on_true) )
+                {
+                    size_t head = body.nodes[0].bb_idx;
+                    if( labels[head] ) {
+                        m_of << indent << "bb" << head << ": ;\n";
+                    }
+                    const auto& head_bb = mir_res.m_fcn.blocks.at(head);
+                    for(const auto& stmt : head_bb.statements)
+                    {
+                        mir_res.set_cur_stmt(head, (&stmt - &head_bb.statements.front()));
+                        this->emit_statement(mir_res, stmt, indent_level);
+                    }
+                    mir_res.set_cur_stmt_term(head);
+                    m_of << indent << "while("; emit_cond(*head_if->te, exit_on_true); m_of << ") {\n";
+                    this->emit_fcn_node(mir_res, *(exit_on_true ? head_if->arm_false : head_if->arm_true).node, indent_level+1, labels, bb_is_cold);
+                    m_of << indent << "}\n";
+                }
+                else
+                {
+                    m_of << indent << "for(;;) {\n";
+                    this->emit_fcn_node(mir_res, *e.code.node, indent_level+1, labels, bb_is_cold);
+                    m_of << indent << "}\n";
+                }
                 )
             )
         }
@@ -2168,6 +3229,9 @@ namespace {
                 const auto& e = stmt.as_Drop();
                 ::HIR::TypeRef  tmp;
                 const auto& ty = mir_res.get_lvalue_type(tmp, e.slot);
+                // Nothing to do (not even a flag check) if the type has no drop glue
+                if( e.kind == ::MIR::eDropKind::DEEP && !m_resolve.type_needs_drop_glue(sp, ty) )
+                    break;
 
                 if( e.flag_idx != ~0u )
                     m_of << indent << "if( df" << e.flag_idx << " ) {\n";
@@ -2209,6 +3273,12 @@ namespace {
             case ::MIR::Statement::TAG_Assign: {
                 const auto& e = stmt.as_Assign();
                 DEBUG("- " << e.dst << " = " << e.src);
+                if( m_inline_defs.count(&stmt) )
+                {
+                    // Emitted at the single use
+                    m_inline_pending[e.dst.as_Local()] = &e.src;
+                    break;
+                }
                 m_of << indent;
                 TU_MATCHA( (e.src), (ve),
                 (Use,
@@ -2392,11 +3462,14 @@ namespace {
                             m_of << "("; emit_param(ve.val_r); m_of << ", "; emit_param(ve.val_l); m_of << ")";
                             break;
 
-                        case ::MIR::eBinOp::ADD_OV:
-                        case ::MIR::eBinOp::SUB_OV:
-                        case ::MIR::eBinOp::MUL_OV:
-                        case ::MIR::eBinOp::DIV_OV:
-                            MIR_TODO(mir_res, "Overflowing binops for emulated i128");
+                        // Checked arithmetic (aborts on overflow)
+                        case ::MIR::eBinOp::ADD_OV:    m_of << "add128";    if(0)
+                        case ::MIR::eBinOp::SUB_OV:    m_of << "sub128";    if(0)
+                        case ::MIR::eBinOp::MUL_OV:    m_of << "mul128";    if(0)
+                        case ::MIR::eBinOp::DIV_OV:    m_of << "div128";
+                            if( ty == ::HIR::CoreType::I128 )
+                                m_of << "s";
+                            m_of << "_ov("; emit_param(ve.val_l); m_of << ", "; emit_param(ve.val_r); m_of << ")";
                             break;
                         }
                         break;
@@ -2404,35 +3477,7 @@ namespace {
                     else {
                     }
 
-                    emit_param(ve.val_l);
-                    switch(ve.op)
-                    {
-                    case ::MIR::eBinOp::ADD:   m_of << " + ";    break;
-                    case ::MIR::eBinOp::SUB:   m_of << " - ";    break;
-                    case ::MIR::eBinOp::MUL:   m_of << " * ";    break;
-                    case ::MIR::eBinOp::DIV:   m_of << " / ";    break;
-                    case ::MIR::eBinOp::MOD:   m_of << " % ";    break;
-
-                    case ::MIR::eBinOp::BIT_OR:    m_of << " | ";    break;
-                    case ::MIR::eBinOp::BIT_AND:   m_of << " & ";    break;
-                    case ::MIR::eBinOp::BIT_XOR:   m_of << " ^ ";    break;
-                    case ::MIR::eBinOp::BIT_SHR:   m_of << " >> ";   break;
-                    case ::MIR::eBinOp::BIT_SHL:   m_of << " << ";   break;
-                    case ::MIR::eBinOp::EQ:    m_of << " == ";   break;
-                    case ::MIR::eBinOp::NE:    m_of << " != ";   break;
-                    case ::MIR::eBinOp::GT:    m_of << " > " ;   break;
-                    case ::MIR::eBinOp::GE:    m_of << " >= ";   break;
-                    case ::MIR::eBinOp::LT:    m_of << " < " ;   break;
-                    case ::MIR::eBinOp::LE:    m_of << " <= ";   break;
-
-                    case ::MIR::eBinOp::ADD_OV:
-                    case ::MIR::eBinOp::SUB_OV:
-                    case ::MIR::eBinOp::MUL_OV:
-                    case ::MIR::eBinOp::DIV_OV:
-                        MIR_TODO(mir_res, "Overflow");
-                        break;
-                    }
-                    emit_param(ve.val_r);
+                    emit_binop_prim(mir_res, ve);
                     if( type_is_emulated_i128(ty_r) )
                     {
                         m_of << ".lo";
@@ -2447,10 +3492,9 @@ namespace {
                         switch (ve.op)
                         {
                         case ::MIR::eUniOp::NEG:
+                            MIR_ASSERT(mir_res, ty == ::HIR::CoreType::I128, "Negation of unsigned " << ty);
                             emit_lvalue(e.dst);
-                            m_of << ".lo = -"; emit_lvalue(ve.val); m_of << ".lo; ";
-                            emit_lvalue(e.dst);
-                            m_of << ".hi = -"; emit_lvalue(ve.val); m_of << ".hi";
+                            m_of << " = neg128s("; emit_lvalue(ve.val); m_of << ")";
                             break;
                         case ::MIR::eUniOp::INV:
                             emit_lvalue(e.dst);
@@ -2465,17 +3509,7 @@ namespace {
 
                     emit_lvalue(e.dst);
                     m_of << " = ";
-                    switch(ve.op)
-                    {
-                    case ::MIR::eUniOp::NEG:    m_of << "-";    break;
-                    case ::MIR::eUniOp::INV:
-                        if( ty == ::HIR::CoreType::Bool )
-                            m_of << "!";
-                        else
-                            m_of << "~";
-                        break;
-                    }
-                    emit_lvalue(ve.val);
+                    emit_uniop_prim(ve, ty);
                     ),
                 (DstMeta,
                     emit_lvalue(e.dst);
@@ -2536,27 +3570,22 @@ namespace {
                     ),
                 (Struct,
                     bool is_val_enum = false;
+                    bool is_niche_data = false;
                     if(ve.variant_idx != ~0u)
                     {
                         ::HIR::TypeRef  tmp;
                         const auto& ty = mir_res.get_lvalue_type(tmp, e.dst);
                         const auto* enm_p = ty.m_data.as_Path().binding.as_Enum();
 
-                        auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                        if( it != m_enum_repr_cache.end() )
+                        if( const auto* repr = get_niche_repr(mir_res.sp, ty) )
                         {
-                            if( ve.variant_idx == 0 ) {
-                                // TODO: Use nonzero_path
-                                m_of << "memset(&"; emit_lvalue(e.dst); m_of << ", 0, sizeof("; emit_ctype(ty); m_of << "))";
-                            }
-                            else if( ve.variant_idx == 1 ) {
-                                emit_lvalue(e.dst);
-                                m_of << "._0 = ";
-                                emit_param(ve.vals[0]);
-                            }
-                            else {
+                            if( ve.variant_idx != repr->data_variant ) {
+                                emit_niche_slot(*repr, [&](){ emit_lvalue(e.dst); });
+                                m_of << " = " << repr->niche_value(ve.variant_idx);
+                                break;
                             }
-                            break;
+                            // Data variant's fields are stored directly in the enum
+                            is_niche_data = true;
                         }
                         else if( enm_p->is_value() )
                         {
@@ -2571,7 +3600,7 @@ namespace {
                             emit_lvalue(e.dst);
                             m_of << ".TAG = " << ve.variant_idx;
                         }
-                        if(ve.vals.size() > 0)
+                        if(ve.vals.size() > 0 && !is_niche_data)
                             m_of << ";\n" << indent;
                     }
 
@@ -2598,7 +3627,7 @@ namespace {
 
                             if( j != 0 )    m_of << ";\n" << indent;
                             emit_lvalue(e.dst);
-                            if(ve.variant_idx != ~0u)
+                            if(ve.variant_idx != ~0u && !is_niche_data)
                                 m_of << ".DATA.var_" << ve.variant_idx;
                             m_of << "._" << j << " = ";
                             emit_param(ve.vals[j]);
@@ -2612,6 +3641,53 @@ namespace {
                 break; }
             }
         }
+        // `a OP b` for primitive (non-emulated) operands
+        void emit_binop_prim(const ::MIR::TypeResolve& mir_res, const ::MIR::RValue::Data_BinOp& ve)
+        {
+            emit_param(ve.val_l);
+            switch(ve.op)
+            {
+            case ::MIR::eBinOp::ADD:   m_of << " + ";    break;
+            case ::MIR::eBinOp::SUB:   m_of << " - ";    break;
+            case ::MIR::eBinOp::MUL:   m_of << " * ";    break;
+            case ::MIR::eBinOp::DIV:   m_of << " / ";    break;
+            case ::MIR::eBinOp::MOD:   m_of << " % ";    break;
+
+            case ::MIR::eBinOp::BIT_OR:    m_of << " | ";    break;
+            case ::MIR::eBinOp::BIT_AND:   m_of << " & ";    break;
+            case ::MIR::eBinOp::BIT_XOR:   m_of << " ^ ";    break;
+            case ::MIR::eBinOp::BIT_SHR:   m_of << " >> ";   break;
+            case ::MIR::eBinOp::BIT_SHL:   m_of << " << ";   break;
+            case ::MIR::eBinOp::EQ:    m_of << " == ";   break;
+            case ::MIR::eBinOp::NE:    m_of << " != ";   break;
+            case ::MIR::eBinOp::GT:    m_of << " > " ;   break;
+            case ::MIR::eBinOp::GE:    m_of << " >= ";   break;
+            case ::MIR::eBinOp::LT:    m_of << " < " ;   break;
+            case ::MIR::eBinOp::LE:    m_of << " <= ";   break;
+
+            case ::MIR::eBinOp::ADD_OV:
+            case ::MIR::eBinOp::SUB_OV:
+            case ::MIR::eBinOp::MUL_OV:
+            case ::MIR::eBinOp::DIV_OV:
+                MIR_TODO(mir_res, "Overflow");
+                break;
+            }
+            emit_param(ve.val_r);
+        }
+        void emit_uniop_prim(const ::MIR::RValue::Data_UniOp& ve, const ::HIR::TypeRef& ty)
+        {
+            switch(ve.op)
+            {
+            case ::MIR::eUniOp::NEG:    m_of << "-";    break;
+            case ::MIR::eUniOp::INV:
+                if( ty == ::HIR::CoreType::Bool )
+                    m_of << "!";
+                else
+                    m_of << "~";
+                break;
+            }
+            emit_lvalue(ve.val);
+        }
         void emit_rvalue_cast(const ::MIR::TypeResolve& mir_res, const ::MIR::LValue& dst, const ::MIR::RValue::Data_Cast& ve)
         {
             if (m_resolve.is_type_phantom_data(ve.type)) {
@@ -2658,6 +3734,15 @@ namespace {
                         emit_lvalue(ve.val);
                         m_of << ".hi";
                     }
+                    else if( ty.m_data.as_Primitive() == ::HIR::CoreType::I8 || ty.m_data.as_Primitive() == ::HIR::CoreType::I16
+                          || ty.m_data.as_Primitive() == ::HIR::CoreType::I32 || ty.m_data.as_Primitive() == ::HIR::CoreType::I64
+                          || ty.m_data.as_Primitive() == ::HIR::CoreType::Isize ) {
+                        // Cast from small signed to u128 (sign extends)
+                        emit_lvalue(dst);
+                        m_of << " = u128_from_s(make128s(";
+                        emit_lvalue(ve.val);
+                        m_of << "))";
+                    }
                     else {
                         // Cast from small to u128
                         emit_lvalue(dst);
@@ -2680,14 +3765,23 @@ namespace {
                         emit_lvalue(ve.val);
                         m_of << ".hi";
                     }
+                    else if( ty.m_data.as_Primitive() == ::HIR::CoreType::I8 || ty.m_data.as_Primitive() == ::HIR::CoreType::I16
+                          || ty.m_data.as_Primitive() == ::HIR::CoreType::I32 || ty.m_data.as_Primitive() == ::HIR::CoreType::I64
+                          || ty.m_data.as_Primitive() == ::HIR::CoreType::Isize ) {
+                        // Cast from small signed to i128
+                        emit_lvalue(dst);
+                        m_of << " = make128s(";
+                        emit_lvalue(ve.val);
+                        m_of << ")";
+                    }
                     else {
-                        // Cast from small to i128
+                        // Cast from small unsigned to i128
                         emit_lvalue(dst);
                         m_of << ".lo = ";
                         emit_lvalue(ve.val);
                         m_of << "; ";
                         emit_lvalue(dst);
-                        m_of << ".hi = 0";  // TODO: Sign
+                        m_of << ".hi = 0";
                     }
                     break;
                 case ::HIR::CoreType::I8:
@@ -2779,19 +3873,37 @@ namespace {
             MIR_ASSERT(mir_res, ty.m_data.as_Path().binding.is_Enum(), "Switch over non-enum");
             const auto* enm = ty.m_data.as_Path().binding.as_Enum();
 
-            auto it = m_enum_repr_cache.find( ty.m_data.as_Path().path.m_data.as_Generic() );
-            if( it != m_enum_repr_cache.end() )
+            if( const auto* repr = get_niche_repr(mir_res.sp, ty) )
             {
-                //MIR_ASSERT(mir_res, e.targets.size() == 2, "NonZero optimised representation for an enum without two variants");
-                MIR_ASSERT(mir_res, n_arms == 2, "NonZero optimised switch without two arms");
-                m_of << indent << "if("; emit_lvalue(val); emit_nonzero_path(it->second); m_of << ")\n";
-                m_of << indent;
-                cb(1);
-                m_of << "\n";
-                m_of << indent << "else\n";
-                m_of << indent;
-                cb(0);
-                m_of << "\n";
+                MIR_ASSERT(mir_res, n_arms == enm->m_variants.size(), "Niche enum switch with wrong arm count");
+                if( repr->niche_count == 1 )
+                {
+                    // NOTE: Emitted as a `switch` (not `if`) so arms can `break` out to the following code
+                    m_of << indent << "switch("; emit_niche_is_data(*repr, [&](){ emit_lvalue(val); }); m_of << ") {\n";
+                    m_of << indent << "case 1: ";
+                    cb(repr->data_variant);
+                    m_of << "\n";
+                    m_of << indent << "default: ";
+                    cb(repr->data_variant == 0 ? 1 : 0);
+                    m_of << "\n";
+                    m_of << indent << "}\n";
+                }
+                else
+                {
+                    m_of << indent << "switch("; emit_niche_slot(*repr, [&](){ emit_lvalue(val); }); m_of << ") {\n";
+                    for(size_t j = 0; j < n_arms; j ++)
+                    {
+                        if( j == repr->data_variant )
+                            continue ;
+                        m_of << indent << "case " << repr->niche_value(j) << ": ";
+                        cb(j);
+                        m_of << "\n";
+                    }
+                    m_of << indent << "default: ";
+                    cb(repr->data_variant);
+                    m_of << "\n";
+                    m_of << indent << "}\n";
+                }
             }
             else if( enm->is_value() )
             {
@@ -3079,6 +4191,95 @@ namespace {
             }
         }
 
+        /// Emit C attributes from `#[inline]`/`#[cold]` and a diverging return type
+        /// - `code` is only set for the definition (inline requests are only meaningful there)
+        void emit_function_attrs(const ::HIR::Path& p, const ::HIR::Function& item, const Trans_Params& params, const ::MIR::Function* code)
+        {
+            ::HIR::TypeRef  tmp;
+            const auto& ret_ty = monomorphise_fcn_return(tmp, item, params);
+
+            auto inline_hint = item.m_inline;
+            if( code && inline_hint == ::HIR::Function::Inline::Always )
+            {
+                // gcc refuses to compile a recursive always_inline function
+                for(const auto& blk : code->blocks)
+                {
+                    if( TU_TEST2(blk.terminator, Call, .fcn, Path, == p) )
+                        inline_hint = ::HIR::Function::Inline::Hint;
+                }
+            }
+            // A weak definition can't also be inline (gcc would emit it as a strong symbol)
+            if( (inline_hint == ::HIR::Function::Inline::Hint || inline_hint == ::HIR::Function::Inline::Always)
+                && !m_exported_instances.empty() && m_exported_instances.count( FMT(Trans_Mangle(p)) ) > 0 )
+            {
+                inline_hint = ::HIR::Function::Inline::Auto;
+            }
+
+            switch(m_compiler)
+            {
+            case Compiler::Gcc:
+                if( ret_ty.m_data.is_Diverge() )
+                    m_of << "__attribute__((noreturn)) ";
+                if( item.m_cold )
+                    m_of << "__attribute__((cold)) ";
+                switch(inline_hint)
+                {
+                case ::HIR::Function::Inline::Auto:
+                    break;
+                case ::HIR::Function::Inline::Hint:
+                    if( code )
+                        m_of << "inline ";
+                    break;
+                case ::HIR::Function::Inline::Always:
+                    if( code )
+                        m_of << "inline __attribute__((always_inline)) ";
+                    break;
+                case ::HIR::Function::Inline::Never:
+                    m_of << "__attribute__((noinline)) ";
+                    break;
+                }
+                break;
+            case Compiler::Msvc:
+                if( ret_ty.m_data.is_Diverge() )
+                    m_of << "__declspec(noreturn) ";
+                switch(inline_hint)
+                {
+                case ::HIR::Function::Inline::Auto:
+                    break;
+                case ::HIR::Function::Inline::Hint:
+                    if( code )
+                        m_of << "__inline ";
+                    break;
+                case ::HIR::Function::Inline::Always:
+                    if( code )
+                        m_of << "__forceinline ";
+                    break;
+                case ::HIR::Function::Inline::Never:
+                    m_of << "__declspec(noinline) ";
+                    break;
+                }
+                break;
+            }
+        }
+        /// Returns true if `ty` is a thin borrow that no other pointer can access (or modify) while it's live
+        bool borrow_is_noalias(const ::HIR::TypeRef& ty)
+        {
+            if( !ty.m_data.is_Borrow() )
+                return false;
+            const auto& te = ty.m_data.as_Borrow();
+            if( is_dst(*te.inner) )
+                return false;
+            switch(te.type)
+            {
+            case ::HIR::BorrowType::Unique:
+                return true;
+            case ::HIR::BorrowType::Shared:
+                return !m_resolve.type_is_interior_mutable(sp, *te.inner);
+            case ::HIR::BorrowType::Owned:
+                return false;
+            }
+            return false;
+        }
         void emit_function_header(const ::HIR::Path& p, const ::HIR::Function& item, const Trans_Params& params)
         {
             ::HIR::TypeRef  tmp;
@@ -3100,7 +4301,16 @@ namespace {
                     {
                         if( i != 0 )    m_of << ",";
                         ss << "\n\t\t";
-                        this->emit_ctype( params.monomorph(m_resolve, item.m_args[i].second), FMT_CB(os, os << "arg" << i;) );
+                        auto arg_ty = params.monomorph(m_resolve, item.m_args[i].second);
+                        if( m_options.emit_restrict && borrow_is_noalias(arg_ty) )
+                        {
+                            const char* restrict_kw = (m_compiler == Compiler::Msvc ? "__restrict" : "restrict");
+                            this->emit_ctype( arg_ty, FMT_CB(os, os << restrict_kw << " arg" << i;) );
+                        }
+                        else
+                        {
+                            this->emit_ctype( arg_ty, FMT_CB(os, os << "arg" << i;) );
+                        }
                     }
 
                     if( item.m_variadic )
@@ -3157,6 +4367,13 @@ namespace {
                     }
                     throw "";
                 };
+            // Name of the overflow-checking helper for `op` (e.g. `__builtin_add_overflow`)
+            auto overflow_fcn = [&](const char* op)->::std::string {
+                const auto& ty = params.m_types.at(0);
+                if( type_is_emulated_i128(ty) )
+                    return ::std::string(op) + (ty == ::HIR::CoreType::I128 ? "128s_o" : "128_o");
+                return ::std::string("__builtin_") + op + "_overflow";
+                };
             auto emit_msvc_atomic_op = [&](const char* name, const char* ordering) {
                 switch (params.m_types.at(0).m_data.as_Primitive())
                 {
@@ -3500,13 +4717,29 @@ namespace {
                 const auto& ty = params.m_types.at(0);
                 emit_lvalue(e.ret_val); m_of << " = ";
                 if( ty.m_data.is_Path() && ty.m_data.as_Path().binding.is_Enum() ) {
-                    auto it = m_enum_repr_cache.find( ty.m_data.as_Path().path.m_data.as_Generic() );
-                    if( it != m_enum_repr_cache.end() )
+                    if( const auto* repr = get_niche_repr(mir_res.sp, ty) )
                     {
-                        emit_param(e.args.at(0)); emit_nonzero_path(it->second); m_of << " != 0";
+                        auto emit_val = [&](){ m_of << "(*"; emit_param(e.args.at(0)); m_of << ")"; };
+                        if( repr->niche_count == 1 )
+                        {
+                            unsigned other_var = (repr->data_variant == 0 ? 1 : 0);
+                            m_of << "("; emit_niche_is_data(*repr, emit_val); m_of << " ? " << repr->data_variant << " : " << other_var << ")";
+                        }
+                        else
+                        {
+                            // Offset into the niche range, adjusted to skip the data variant
+                            auto emit_ofs = [&](){ m_of << "((uint64_t)"; emit_niche_slot(*repr, emit_val); m_of << " - " << repr->niche_start << "ull)"; };
+                            m_of << "("; emit_ofs(); m_of << " < " << repr->niche_count << "ull"
+                                << " ? "; emit_ofs(); m_of << " + ("; emit_ofs(); m_of << " >= " << repr->data_variant << ")"
+                                << " : " << repr->data_variant << ")";
+                        }
                     }
                     else
                     {
+                        // Rust/C-repr discriminants are signed (stored in an `unsigned int` tag), so sign-extend them
+                        const auto& enm = *ty.m_data.as_Path().binding.as_Enum();
+                        if( enm.m_repr == ::HIR::Enum::Repr::Rust || enm.m_repr == ::HIR::Enum::Repr::C )
+                            m_of << "(int64_t)(int)";
                         emit_param(e.args.at(0)); m_of << "->TAG";
                     }
                 }
@@ -3528,32 +4761,32 @@ namespace {
             // Overflowing Arithmatic
             // HACK: Uses GCC intrinsics
             else if( name == "add_with_overflow" ) {
-                emit_lvalue(e.ret_val); m_of << "._1 = __builtin_add_overflow("; emit_param(e.args.at(0));
+                emit_lvalue(e.ret_val); m_of << "._1 = " << overflow_fcn("add") << "("; emit_param(e.args.at(0));
                     m_of << ", "; emit_param(e.args.at(1));
                     m_of << ", &"; emit_lvalue(e.ret_val); m_of << "._0)";
             }
             else if( name == "sub_with_overflow" ) {
-                emit_lvalue(e.ret_val); m_of << "._1 = __builtin_sub_overflow("; emit_param(e.args.at(0));
+                emit_lvalue(e.ret_val); m_of << "._1 = " << overflow_fcn("sub") << "("; emit_param(e.args.at(0));
                     m_of << ", "; emit_param(e.args.at(1));
                     m_of << ", &"; emit_lvalue(e.ret_val); m_of << "._0)";
             }
             else if( name == "mul_with_overflow" ) {
-                emit_lvalue(e.ret_val); m_of << "._1 = __builtin_mul_overflow("; emit_param(e.args.at(0));
+                emit_lvalue(e.ret_val); m_of << "._1 = " << overflow_fcn("mul") << "("; emit_param(e.args.at(0));
                     m_of << ", "; emit_param(e.args.at(1));
                     m_of << ", &"; emit_lvalue(e.ret_val); m_of << "._0)";
             }
             else if( name == "overflowing_add" ) {
-                m_of << "__builtin_add_overflow("; emit_param(e.args.at(0));
+                m_of << overflow_fcn("add") << "("; emit_param(e.args.at(0));
                     m_of << ", "; emit_param(e.args.at(1));
                     m_of << ", &"; emit_lvalue(e.ret_val); m_of << ")";
             }
             else if( name == "overflowing_sub" ) {
-                m_of << "__builtin_sub_overflow("; emit_param(e.args.at(0));
+                m_of << overflow_fcn("sub") << "("; emit_param(e.args.at(0));
                     m_of << ", "; emit_param(e.args.at(1));
                     m_of << ", &"; emit_lvalue(e.ret_val); m_of << ")";
             }
             else if( name == "overflowing_mul" ) {
-                m_of << "__builtin_mul_overflow("; emit_param(e.args.at(0));
+                m_of << overflow_fcn("mul") << "("; emit_param(e.args.at(0));
                     m_of << ", "; emit_param(e.args.at(1));
                     m_of << ", &"; emit_lvalue(e.ret_val); m_of << ")";
             }
@@ -3635,13 +4868,15 @@ namespace {
                 auto emit_arg0 = [&](){ emit_param(e.args.at(0)); };
                 const auto& ty = params.m_types.at(0);
                 emit_lvalue(e.ret_val); m_of << " = (";
-                if( ty == ::HIR::CoreType::U128 )
+                if( ty == ::HIR::CoreType::U128 || ty == ::HIR::CoreType::I128 )
                 {
+                    // NOTE: The native helpers take either type (via an implicit conversion)
+                    const char* sfx = (type_is_emulated_i128(ty) && ty == ::HIR::CoreType::I128 ? "i128" : "u128");
                     if( name == "ctlz" || name == "ctlz_nonzero" ) {
-                        m_of << "intrinsic_ctlz_u128("; emit_param(e.args.at(0)); m_of << ")";
+                        m_of << "intrinsic_ctlz_" << sfx << "("; emit_param(e.args.at(0)); m_of << ")";
                     }
                     else {
-                        m_of << "intrinsic_cttz_u128("; emit_param(e.args.at(0)); m_of << ")";
+                        m_of << "intrinsic_cttz_" << sfx << "("; emit_param(e.args.at(0)); m_of << ")";
                     }
                     m_of << ");";
                     return ;
@@ -3672,12 +4907,17 @@ namespace {
             else if( name == "ctpop" ) {
                 emit_lvalue(e.ret_val); m_of << " = ";
 
-                if( type_is_emulated_i128(params.m_types.at(0)) )
+                const auto& ty = params.m_types.at(0);
+                if( ty == ::HIR::CoreType::U128 || ty == ::HIR::CoreType::I128 )
                 {
                     m_of << "popcount128";
-                    if(params.m_types.at(0) == ::HIR::CoreType::I128)
+                    if( type_is_emulated_i128(ty) && ty == ::HIR::CoreType::I128 )
                         m_of << "s";
                 }
+                else if( ty == ::HIR::CoreType::U64 || ty == ::HIR::CoreType::I64 || ty == ::HIR::CoreType::Usize || ty == ::HIR::CoreType::Isize )
+                {
+                    m_of << "__builtin_popcountll";
+                }
                 else
                 {
                     m_of << "__builtin_popcount";
@@ -3881,14 +5121,391 @@ namespace {
             else if( name == "atomic_singlethreadfence" || name.compare(0, 7+18, "atomic_singlethreadfence_") == 0 ) {
                 // TODO: Does this matter?
             }
+            // `platform-intrinsic` SIMD operations
+            else if( name.compare(0, 5, "simd_") == 0 ) {
+                emit_intrinsic_simd(name, params, e);
+            }
             else {
                 MIR_BUG(mir_res, "Unknown intrinsic '" << name << "'");
             }
             m_of << ";\n";
         }
 
+        /// Get the lane type and count of a `repr(simd)` struct
+        bool get_simd_lanes(const ::HIR::TypeRef& ty, ::HIR::TypeRef& out_lane_ty, unsigned& out_count)
+        {
+            if( !ty.m_data.is_Path() || !ty.m_data.as_Path().binding.is_Struct() )
+                return false;
+            const auto& str = *ty.m_data.as_Path().binding.as_Struct();
+            if( str.m_repr != ::HIR::Struct::Repr::Simd )
+                return false;
+            const auto& gp = ty.m_data.as_Path().path.m_data.as_Generic();
+            const ::HIR::TypeRef* fld_ty = nullptr;
+            TU_MATCHA( (str.m_data), (se),
+            (Unit,
+                return false;
+                ),
+            (Tuple,
+                if( se.empty() )
+                    return false;
+                fld_ty = &se.front().ent;
+                out_count = se.size();
+                ),
+            (Named,
+                if( se.empty() )
+                    return false;
+                fld_ty = &se.front().second.ent;
+                out_count = se.size();
+                )
+            )
+            out_lane_ty = monomorphise_type(sp, str.m_params, gp.m_params, *fld_ty);
+            m_resolve.expand_associated_types(sp, out_lane_ty);
+            return true;
+        }
+        /// Emit a `simd_*` intrinsic
+        /// - Lane-wise arithmetic uses the gcc vector (`.v`) if the type has one, everything else works on the lanes directly.
+        void emit_intrinsic_simd(const ::std::string& name, const ::HIR::PathParams& params, const ::MIR::Terminator::Data_Call& e)
+        {
+            const auto& mir_res = *m_mir_res;
+            const auto& ty = params.m_types.at(0);
+            ::HIR::TypeRef  lane_ty;
+            unsigned    n_lanes = 0;
+            MIR_ASSERT(mir_res, get_simd_lanes(ty, lane_ty, n_lanes), "`" << name << "` on a non-SIMD type - " << ty);
+            bool has_vector = Target_GetStructRepr(mir_res.sp, m_resolve, ty)->simd_vector;
+            bool is_float = (lane_ty == ::HIR::CoreType::F32 || lane_ty == ::HIR::CoreType::F64);
+
+            // Lane `idx` of the named local (or of the return value)
+            auto emit_lane = [&](const char* var, const ::HIR::TypeRef& lty, const ::std::string& idx) {
+                m_of << "((";  emit_ctype(lty); m_of << "*)&";
+                if( var )
+                    m_of << var;
+                else
+                    emit_lvalue(e.ret_val);
+                m_of << ")[" << idx << "]";
+                };
+            // Copy the arguments into locals (they may be constants)
+            static const char* names[] = { "a", "b", "c" };
+            auto emit_args = [&](const ::HIR::TypeRef& arg_ty, unsigned count) {
+                m_of << "{ ";
+                for(unsigned i = 0; i < count; i ++)
+                {
+                    emit_ctype(arg_ty, FMT_CB(ss, ss << names[i];)); m_of << " = "; emit_param(e.args.at(i)); m_of << "; ";
+                }
+                };
+
+            const char* binop = nullptr;
+            const char* cmpop = nullptr;
+            if( name == "simd_add" )    binop = "+";
+            else if( name == "simd_sub" )   binop = "-";
+            else if( name == "simd_mul" )   binop = "*";
+            else if( name == "simd_div" )   binop = "/";
+            else if( name == "simd_rem" )   binop = "%";
+            else if( name == "simd_shl" )   binop = "<<";
+            else if( name == "simd_shr" )   binop = ">>";
+            else if( name == "simd_and" )   binop = "&";
+            else if( name == "simd_or"  )   binop = "|";
+            else if( name == "simd_xor" )   binop = "^";
+            else if( name == "simd_eq" )    cmpop = "==";
+            else if( name == "simd_ne" )    cmpop = "!=";
+            else if( name == "simd_lt" )    cmpop = "<";
+            else if( name == "simd_le" )    cmpop = "<=";
+            else if( name == "simd_gt" )    cmpop = ">";
+            else if( name == "simd_ge" )    cmpop = ">=";
+            // Lane-wise libm calls (`f` suffix for f32 lanes)
+            const char* mathfcn = nullptr;
+            unsigned    mathfcn_args = 1;
+            if( name == "simd_fsqrt" )  mathfcn = "sqrt";
+            else if( name == "simd_fabs" )  mathfcn = "fabs";
+            else if( name == "simd_fsin" )  mathfcn = "sin";
+            else if( name == "simd_fcos" )  mathfcn = "cos";
+            else if( name == "simd_fexp" )  mathfcn = "exp";
+            else if( name == "simd_fexp2" ) mathfcn = "exp2";
+            else if( name == "simd_flog" )  mathfcn = "log";
+            else if( name == "simd_flog2" ) mathfcn = "log2";
+            else if( name == "simd_flog10" )    mathfcn = "log10";
+            else if( name == "simd_floor" ) mathfcn = "floor";
+            else if( name == "simd_ceil" )  mathfcn = "ceil";
+            else if( name == "simd_round" ) mathfcn = "round";
+            else if( name == "simd_trunc" ) mathfcn = "trunc";
+            else if( name == "simd_fpow" )  mathfcn = "pow",  mathfcn_args = 2;
+            else if( name == "simd_fmin" )  mathfcn = "fmin", mathfcn_args = 2;
+            else if( name == "simd_fmax" )  mathfcn = "fmax", mathfcn_args = 2;
+            else if( name == "simd_fma" )   mathfcn = "fma",  mathfcn_args = 3;
+
+            if( binop )
+            {
+                bool is_frem = is_float && name == "simd_rem";
+                if( has_vector && !is_frem )
+                {
+                    emit_lvalue(e.ret_val); m_of << ".v = ";
+                    emit_param(e.args.at(0)); m_of << ".v " << binop << " "; emit_param(e.args.at(1)); m_of << ".v";
+                }
+                else
+                {
+                    emit_args(ty, 2);
+                    m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                    emit_lane(nullptr, lane_ty, "i"); m_of << " = ";
+                    if( is_frem ) {
+                        m_of << (lane_ty == ::HIR::CoreType::F32 ? "fmodf(" : "fmod(");
+                        emit_lane("a", lane_ty, "i"); m_of << ", "; emit_lane("b", lane_ty, "i"); m_of << ")";
+                    }
+                    else {
+                        emit_lane("a", lane_ty, "i"); m_of << " " << binop << " "; emit_lane("b", lane_ty, "i");
+                    }
+                    m_of << "; }";
+                }
+            }
+            else if( cmpop )
+            {
+                // Result lanes are all-ones for true, zero for false
+                const auto& ret_ty = params.m_types.at(1);
+                ::HIR::TypeRef  ret_lane_ty;
+                unsigned    ret_lanes = 0;
+                MIR_ASSERT(mir_res, get_simd_lanes(ret_ty, ret_lane_ty, ret_lanes), "`" << name << "` returning a non-SIMD type - " << ret_ty);
+                MIR_ASSERT(mir_res, ret_lanes == n_lanes, "`" << name << "` lane count mismatch - " << ty << " to " << ret_ty);
+                if( has_vector && Target_GetStructRepr(mir_res.sp, m_resolve, ret_ty)->simd_vector
+                    && Target_GetStructRepr(mir_res.sp, m_resolve, ret_ty)->size == Target_GetStructRepr(mir_res.sp, m_resolve, ty)->size )
+                {
+                    emit_lvalue(e.ret_val); m_of << ".v = (__typeof__("; emit_lvalue(e.ret_val); m_of << ".v))(";
+                    emit_param(e.args.at(0)); m_of << ".v " << cmpop << " "; emit_param(e.args.at(1)); m_of << ".v)";
+                }
+                else
+                {
+                    emit_args(ty, 2);
+                    m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                    emit_lane(nullptr, ret_lane_ty, "i"); m_of << " = ";
+                    emit_lane("a", lane_ty, "i"); m_of << " " << cmpop << " "; emit_lane("b", lane_ty, "i"); m_of << " ? -1 : 0; }";
+                }
+            }
+            else if( name == "simd_extract" )
+            {
+                emit_args(ty, 1);
+                m_of << "unsigned i = "; emit_param(e.args.at(1)); m_of << "; ";
+                emit_lvalue(e.ret_val); m_of << " = "; emit_lane("a", lane_ty, "i"); m_of << "; }";
+            }
+            else if( name == "simd_insert" )
+            {
+                emit_args(ty, 1);
+                m_of << "unsigned i = "; emit_param(e.args.at(1)); m_of << "; ";
+                emit_lane("a", lane_ty, "i"); m_of << " = "; emit_param(e.args.at(2)); m_of << "; ";
+                emit_lvalue(e.ret_val); m_of << " = a; }";
+            }
+            else if( name.compare(0, 12, "simd_shuffle") == 0 )
+            {
+                // simd_shuffleN<T, U>(a: T, b: T, idx: [u32; N]) -> U - indexes past the end of `a` select from `b`
+                const auto& ret_ty = params.m_types.at(1);
+                ::HIR::TypeRef  ret_lane_ty;
+                unsigned    ret_lanes = 0;
+                MIR_ASSERT(mir_res, get_simd_lanes(ret_ty, ret_lane_ty, ret_lanes), "`" << name << "` returning a non-SIMD type - " << ret_ty);
+                emit_args(ty, 2);
+                // The indexes have to be constant, so unroll using their values if they're known here
+                const ::HIR::Literal* idx_lit = nullptr;
+                if( const auto* c = e.args.at(2).opt_Constant() )
+                {
+                    if( const auto* ce = c->opt_Const() )
+                    {
+                        ::HIR::TypeRef  idx_ty;
+                        idx_lit = &get_literal_for_const(ce->p, idx_ty);
+                        size_t  count = idx_lit->is_Packed() ? idx_lit->as_Packed().size() : (idx_lit->is_List() ? idx_lit->as_List().size() : 0);
+                        if( count != ret_lanes )
+                            idx_lit = nullptr;
+                    }
+                }
+                if( idx_lit )
+                {
+                    for(unsigned i = 0; i < ret_lanes; i ++)
+                    {
+                        uint64_t j;
+                        if( idx_lit->is_Packed() ) {
+                            j = idx_lit->as_Packed().get(i);
+                        }
+                        else {
+                            MIR_ASSERT(mir_res, idx_lit->as_List()[i].is_Integer(), "`" << name << "` index isn't an integer - " << idx_lit->as_List()[i]);
+                            j = idx_lit->as_List()[i].as_Integer();
+                        }
+                        emit_lane(nullptr, ret_lane_ty, ::std::to_string(i)); m_of << " = ";
+                        if( j < n_lanes )
+                            emit_lane("a", lane_ty, ::std::to_string(j));
+                        else
+                            emit_lane("b", lane_ty, ::std::to_string(j - n_lanes));
+                        m_of << "; ";
+                    }
+                    m_of << "}";
+                }
+                else
+                {
+                    // Copy the index array into a local (so constants can be indexed)
+                    ::HIR::TypeRef  tmp;
+                    const auto& idx_ty = mir_res.get_param_type(tmp, e.args.at(2));
+                    emit_ctype(idx_ty, FMT_CB(ss, ss << "idx";)); m_of << " = "; emit_param(e.args.at(2)); m_of << "; ";
+                    m_of << "for(unsigned i = 0; i < " << ret_lanes << "; i ++) { unsigned j = idx.DATA[i]; ";
+                    emit_lane(nullptr, ret_lane_ty, "i"); m_of << " = j < " << n_lanes << " ? ";
+                    emit_lane("a", lane_ty, "j"); m_of << " : "; emit_lane("b", lane_ty, "j - " + ::std::to_string(n_lanes)); m_of << "; } }";
+                }
+            }
+            else if( name == "simd_cast" )
+            {
+                const auto& ret_ty = params.m_types.at(1);
+                ::HIR::TypeRef  ret_lane_ty;
+                unsigned    ret_lanes = 0;
+                MIR_ASSERT(mir_res, get_simd_lanes(ret_ty, ret_lane_ty, ret_lanes), "`" << name << "` returning a non-SIMD type - " << ret_ty);
+                MIR_ASSERT(mir_res, ret_lanes == n_lanes, "`" << name << "` lane count mismatch - " << ty << " to " << ret_ty);
+                emit_args(ty, 1);
+                m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                emit_lane(nullptr, ret_lane_ty, "i"); m_of << " = "; emit_lane("a", lane_ty, "i"); m_of << "; }";
+            }
+            else if( name == "simd_select" )
+            {
+                // simd_select<M, T>(mask: M, a: T, b: T) -> T
+                const auto& val_ty = params.m_types.at(1);
+                ::HIR::TypeRef  val_lane_ty;
+                unsigned    val_lanes = 0;
+                MIR_ASSERT(mir_res, get_simd_lanes(val_ty, val_lane_ty, val_lanes), "`" << name << "` on a non-SIMD type - " << val_ty);
+                m_of << "{ ";
+                emit_ctype(ty, FMT_CB(ss, ss << "m";)); m_of << " = "; emit_param(e.args.at(0)); m_of << "; ";
+                emit_ctype(val_ty, FMT_CB(ss, ss << "a";)); m_of << " = "; emit_param(e.args.at(1)); m_of << "; ";
+                emit_ctype(val_ty, FMT_CB(ss, ss << "b";)); m_of << " = "; emit_param(e.args.at(2)); m_of << "; ";
+                m_of << "for(unsigned i = 0; i < " << val_lanes << "; i ++) ";
+                emit_lane(nullptr, val_lane_ty, "i"); m_of << " = "; emit_lane("m", lane_ty, "i"); m_of << " ? ";
+                emit_lane("a", val_lane_ty, "i"); m_of << " : "; emit_lane("b", val_lane_ty, "i"); m_of << "; }";
+            }
+            else if( name.compare(0, 12, "simd_reduce_") == 0 )
+            {
+                auto op = name.substr(12);
+                emit_args(ty, 1);
+                if( op == "all" || op == "any" )
+                {
+                    emit_lvalue(e.ret_val); m_of << " = " << (op == "all" ? "1" : "0") << "; ";
+                    m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                    emit_lvalue(e.ret_val); m_of << (op == "all" ? " &= " : " |= "); emit_lane("a", lane_ty, "i"); m_of << " != 0; }";
+                }
+                else
+                {
+                    // `_ordered` variants take an initial accumulator, the unordered ones start from lane 0
+                    bool has_acc = (op == "add_ordered" || op == "mul_ordered");
+                    const char* fmt_op = nullptr;
+                    if( op == "add_ordered" || op == "add_unordered" )  fmt_op = "+";
+                    else if( op == "mul_ordered" || op == "mul_unordered" ) fmt_op = "*";
+                    else if( op == "and" )  fmt_op = "&";
+                    else if( op == "or" )   fmt_op = "|";
+                    else if( op == "xor" )  fmt_op = "^";
+                    else if( op == "min" || op == "max" || op == "fmin" || op == "fmax" )   fmt_op = nullptr;
+                    else
+                        MIR_TODO(mir_res, "SIMD intrinsic '" << name << "'");
+                    emit_lvalue(e.ret_val); m_of << " = ";
+                    if( has_acc ) {
+                        emit_param(e.args.at(1));
+                    }
+                    else {
+                        emit_lane("a", lane_ty, "0");
+                    }
+                    m_of << "; for(unsigned i = " << (has_acc ? 0 : 1) << "; i < " << n_lanes << "; i ++) ";
+                    if( fmt_op ) {
+                        emit_lvalue(e.ret_val); m_of << " = "; emit_lvalue(e.ret_val); m_of << " " << fmt_op << " "; emit_lane("a", lane_ty, "i");
+                    }
+                    else {
+                        m_of << "if( "; emit_lane("a", lane_ty, "i"); m_of << (op == "min" || op == "fmin" ? " < " : " > "); emit_lvalue(e.ret_val); m_of << " ) ";
+                        emit_lvalue(e.ret_val); m_of << " = "; emit_lane("a", lane_ty, "i");
+                    }
+                    m_of << "; }";
+                }
+            }
+            else if( mathfcn )
+            {
+                MIR_ASSERT(mir_res, is_float, "`" << name << "` on non-float lanes - " << ty);
+                emit_args(ty, mathfcn_args);
+                m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                emit_lane(nullptr, lane_ty, "i"); m_of << " = " << mathfcn << (lane_ty == ::HIR::CoreType::F32 ? "f" : "") << "(";
+                for(unsigned i = 0; i < mathfcn_args; i ++)
+                {
+                    if(i != 0)  m_of << ", ";
+                    emit_lane(names[i], lane_ty, "i");
+                }
+                m_of << "); }";
+            }
+            else if( name == "simd_neg" )
+            {
+                if( has_vector )
+                {
+                    emit_lvalue(e.ret_val); m_of << ".v = -"; emit_param(e.args.at(0)); m_of << ".v";
+                }
+                else
+                {
+                    emit_args(ty, 1);
+                    m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                    emit_lane(nullptr, lane_ty, "i"); m_of << " = -"; emit_lane("a", lane_ty, "i"); m_of << "; }";
+                }
+            }
+            else if( name == "simd_saturating_add" || name == "simd_saturating_sub" )
+            {
+                bool is_add = (name == "simd_saturating_add");
+                MIR_ASSERT(mir_res, lane_ty.m_data.is_Primitive() && !is_float, "`" << name << "` on non-integer lanes - " << ty);
+                bool is_signed = false;
+                switch(lane_ty.m_data.as_Primitive())
+                {
+                case ::HIR::CoreType::I8:   case ::HIR::CoreType::I16:
+                case ::HIR::CoreType::I32:  case ::HIR::CoreType::I64:
+                case ::HIR::CoreType::Isize:
+                    is_signed = true;
+                    break;
+                default:
+                    break;
+                }
+                emit_args(ty, 2);
+                m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                m_of << "if( __builtin_" << (is_add ? "add" : "sub") << "_overflow("; emit_lane("a", lane_ty, "i"); m_of << ", "; emit_lane("b", lane_ty, "i");
+                m_of << ", &"; emit_lane(nullptr, lane_ty, "i"); m_of << ") ) ";
+                emit_lane(nullptr, lane_ty, "i"); m_of << " = ";
+                if( is_signed )
+                {
+                    // Clamp towards the sign of the overflow (MAX is all-ones shifted down to the lane's size)
+                    auto emit_max = [&]() { m_of << "(~(uint64_t)0 >> (65 - sizeof("; emit_ctype(lane_ty); m_of << ")*8))"; };
+                    emit_lane("b", lane_ty, "i"); m_of << (is_add ? " < 0" : " > 0") << " ? ";
+                    m_of << "("; emit_ctype(lane_ty); m_of << ")(-(int64_t)"; emit_max(); m_of << " - 1) : ";
+                    m_of << "("; emit_ctype(lane_ty); m_of << ")"; emit_max();
+                }
+                else
+                {
+                    m_of << "("; emit_ctype(lane_ty); m_of << ")" << (is_add ? "~(uint64_t)0" : "0");
+                }
+                m_of << "; }";
+            }
+            else if( name == "simd_gather" || name == "simd_scatter" )
+            {
+                // simd_gather<T, P, M>(values: T, pointers: P, mask: M) -> T - masked-out lanes keep `values`
+                // simd_scatter<T, P, M>(values: T, pointers: P, mask: M) - writes the masked-in lanes
+                const auto& ptr_ty = params.m_types.at(1);
+                const auto& mask_ty = params.m_types.at(2);
+                ::HIR::TypeRef  ptr_lane_ty, mask_lane_ty;
+                unsigned    ptr_lanes = 0, mask_lanes = 0;
+                MIR_ASSERT(mir_res, get_simd_lanes(ptr_ty, ptr_lane_ty, ptr_lanes), "`" << name << "` with non-SIMD pointers - " << ptr_ty);
+                MIR_ASSERT(mir_res, get_simd_lanes(mask_ty, mask_lane_ty, mask_lanes), "`" << name << "` with a non-SIMD mask - " << mask_ty);
+                MIR_ASSERT(mir_res, ptr_lanes == n_lanes && mask_lanes == n_lanes, "`" << name << "` lane count mismatch");
+                m_of << "{ ";
+                emit_ctype(ty, FMT_CB(ss, ss << "a";)); m_of << " = "; emit_param(e.args.at(0)); m_of << "; ";
+                emit_ctype(ptr_ty, FMT_CB(ss, ss << "p";)); m_of << " = "; emit_param(e.args.at(1)); m_of << "; ";
+                emit_ctype(mask_ty, FMT_CB(ss, ss << "m";)); m_of << " = "; emit_param(e.args.at(2)); m_of << "; ";
+                m_of << "for(unsigned i = 0; i < " << n_lanes << "; i ++) ";
+                if( name == "simd_gather" ) {
+                    emit_lane(nullptr, lane_ty, "i"); m_of << " = "; emit_lane("m", mask_lane_ty, "i"); m_of << " ? *";
+                    emit_lane("p", ptr_lane_ty, "i"); m_of << " : "; emit_lane("a", lane_ty, "i");
+                }
+                else {
+                    m_of << "if( "; emit_lane("m", mask_lane_ty, "i"); m_of << " ) *"; emit_lane("p", ptr_lane_ty, "i"); m_of << " = "; emit_lane("a", lane_ty, "i");
+                }
+                m_of << "; }";
+            }
+            else
+            {
+                MIR_TODO(mir_res, "SIMD intrinsic '" << name << "'");
+            }
+        }
+
         void emit_destructor_call(const ::MIR::LValue& slot, const ::HIR::TypeRef& ty, bool unsized_valid, unsigned indent_level)
         {
+            // Types without drop glue have nothing to call (and no glue emitted)
+            if( !m_resolve.type_needs_drop_glue(sp, ty) )
+                return ;
             auto indent = RepeatLitStr { "\t", static_cast<int>(indent_level) };
             TU_MATCHA( (ty.m_data), (te),
             // Impossible
@@ -3915,7 +5532,6 @@ namespace {
                 ),
             (Path,
                 // Call drop glue
-                // - TODO: If the destructor is known to do nothing, don't call it.
                 auto p = ::HIR::Path(ty.clone(), "#drop_glue");
                 const char* make_fcn = nullptr;
                 switch( metadata_type(ty) )
@@ -4099,19 +5715,29 @@ namespace {
                     }
                 }
                 ),
+            (Packed,
+                MIR_ASSERT(*m_mir_res, ty.m_data.is_Array(), "Packed literal for non-array - " << ty);
+                for(size_t i = 0; i < e.size(); i ++) {
+                    if(i != 0)  m_of << ";\n\t";
+                    emit_dst(); m_of << ".DATA[" << i << "] = ";
+                    emit_integer_literal(*ty.m_data.as_Array().inner, e.get(i));
+                }
+                ),
             (Variant,
                 MIR_ASSERT(*m_mir_res, ty.m_data.is_Path(), "");
                 MIR_ASSERT(*m_mir_res, ty.m_data.as_Path().binding.is_Enum(), "");
                 const auto& enm = *ty.m_data.as_Path().binding.as_Enum();
-                auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                if( it != m_enum_repr_cache.end() )
+                if( const auto* repr = get_niche_repr(sp, ty) )
                 {
-                    if( e.idx == 0 ) {
-                        emit_nonzero_path(it->second);
-                        m_of << " = 0";
+                    if( e.idx == repr->data_variant ) {
+                        for(unsigned int i = 0; i < e.vals.size(); i ++) {
+                            if(i != 0)  m_of << ";\n\t";
+                            assign_from_literal([&](){ emit_dst(); m_of << "._" << i; }, get_inner_type(e.idx, i), e.vals[i]);
+                        }
                     }
                     else {
-                        assign_from_literal([&](){ emit_dst(); m_of << "._0"; }, get_inner_type(e.idx, 0), e.vals[0]);
+                        emit_niche_slot(*repr, emit_dst);
+                        m_of << " = " << repr->niche_value(e.idx);
                     }
                 }
                 else if( enm.is_value() )
@@ -4205,6 +5831,12 @@ namespace {
             (Local,
                 if( e == ~0u )
                     m_of << "i";
+                else if( e < m_inline_pending.size() && m_inline_pending[e] )
+                {
+                    const auto& src = *m_inline_pending[e];
+                    m_inline_pending[e] = nullptr;
+                    emit_inline_rvalue(*m_mir_res, m_mir_res->m_fcn.locals[e], src);
+                }
                 else
                     m_of << "var" << e;
                 ),
@@ -4299,10 +5931,9 @@ namespace {
                 MIR_ASSERT(*m_mir_res, ty.m_data.is_Path(), "Downcast on non-Path type - " << ty);
                 if( ty.m_data.as_Path().binding.is_Enum() )
                 {
-                    auto it = m_enum_repr_cache.find(ty.m_data.as_Path().path.m_data.as_Generic());
-                    if( it != m_enum_repr_cache.end() )
+                    if( const auto* repr = get_niche_repr(m_mir_res->sp, ty) )
                     {
-                        MIR_ASSERT(*m_mir_res, e.variant_index == 1, "");
+                        MIR_ASSERT(*m_mir_res, e.variant_index == repr->data_variant, "Downcast to a niche-encoded variant");
                         // NOTE: Downcast returns a magic tuple
                         //m_of << "._0";
                         break ;
@@ -4320,7 +5951,9 @@ namespace {
         {
             TU_MATCHA( (ve), (c),
             (Int,
-                if( c.v == INT64_MIN )
+                if( c.v == INT64_MIN && c.t == ::HIR::CoreType::I128 && m_options.emulated_i128 )
+                    m_of << "make128s(INT64_MIN)";
+                else if( c.v == INT64_MIN )
                     m_of << "INT64_MIN";
                 else
                 {
@@ -4727,7 +6360,7 @@ namespace {
     Span CodeGenerator_C::sp;
 }
 
-::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile)
+::std::unique_ptr<CodeGenerator> Trans_Codegen_GetGeneratorC(const ::HIR::Crate& crate, const ::std::string& outfile, const TransOptions& opt)
 {
-    return ::std::unique_ptr<CodeGenerator>(new CodeGenerator_C(crate, outfile));
+    return ::std::unique_ptr<CodeGenerator>(new CodeGenerator_C(crate, outfile, opt));
 }
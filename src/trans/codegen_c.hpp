@@ -6,6 +6,16 @@
 
 class Node;
 
+/// How control leaves the end of a structured block
+enum class NodeExit
+{
+    None,   // Never reaches the end (return/diverge/infinite loop)
+    Fallthrough,    // The next statement is the target
+    Continue,   // Target is the head of the innermost loop
+    Break,  // Target follows the innermost loop/switch
+    Goto,   // Explicit jump to a labeled block
+};
+
 struct NodeRef
 {
     ::std::unique_ptr<Node>    node;
@@ -13,29 +23,25 @@ struct NodeRef
 
     NodeRef(size_t idx): bb_idx(idx) {}
     NodeRef(Node node);
-
-    bool has_target() const;
-    size_t target() const;
-
-    bool operator==(size_t idx) const {
-        return !node && bb_idx == idx;
-    }
 };
 
 TAGGED_UNION(Node, Block,
+// Sequence of basic blocks (bare `bb_idx` refs) and nested constructs, then a jump to `next_bb`
 (Block, struct {
     size_t  next_bb;
     ::std::vector<NodeRef>  nodes;
+    NodeExit    next_exit;
     }),
+// `next_bb` is the block that follows the construct (SIZE_MAX if control never leaves the end)
 (If, struct {
     size_t  next_bb;
-    const ::MIR::LValue* val;
+    const ::MIR::Terminator::Data_If* te;
     NodeRef arm_false;
     NodeRef arm_true;
     }),
 (Switch, struct {
     size_t  next_bb;
-    const ::MIR::LValue* val;
+    const ::MIR::Terminator::Data_Switch* te;
     ::std::vector<NodeRef>  arms;
     }),
 (Loop, struct {
@@ -44,4 +50,6 @@ TAGGED_UNION(Node, Block,
     })
 );
 
-extern ::std::vector<Node> MIR_To_Structured(const ::MIR::Function& fcn);
+/// Convert a function's CFG into nested blocks/loops/ifs/switches
+/// - `out_labels` is set for every block that is still the target of a `goto`
+extern ::std::vector<Node> MIR_To_Structured(const ::MIR::Function& fcn, ::std::vector<bool>& out_labels);
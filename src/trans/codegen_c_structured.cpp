@@ -8,291 +8,407 @@
 #include <common.hpp>
 #include <mir/mir.hpp>
 #include <algorithm>
+#include <set>
+#include <map>
 #include "codegen_c.hpp"
 
-NodeRef::NodeRef(Node node_data):
-    node(new Node(mv$(node_data))),
-    bb_idx(SIZE_MAX)
-{
-}
-bool NodeRef::has_target() const
-{
-    if( node ) {
-        TU_MATCHA( (*this->node), (e),
-        (Block,
-            return e.next_bb != SIZE_MAX;
+namespace {
+    // Limit on construct nesting (MSVC gives up on blocks nested past ~128 levels)
+    const unsigned MAX_NEST_DEPTH = 48;
+
+    ::std::vector<size_t> get_successors(const ::MIR::Terminator& term)
+    {
+        ::std::vector<size_t>   rv;
+        TU_MATCHA( (term), (te),
+        (Incomplete,
             ),
-        (If,
-            return e.next_bb != SIZE_MAX;
+        (Return,
             ),
-        (Switch,
-            return e.next_bb != SIZE_MAX;
+        (Diverge,
             ),
-        (Loop,
-            return e.next_bb != SIZE_MAX;
-            )
-        )
-        throw "";
-    }
-    else {
-        return true;
-    }
-}
-size_t NodeRef::target() const
-{
-    if( node ) {
-        TU_MATCHA( (*this->node), (e),
-        (Block,
-            return e.next_bb;
+        (Goto,
+            rv.push_back(te);
+            ),
+        (Panic,
+            rv.push_back(te.dst);
             ),
         (If,
-            return e.next_bb;
+            rv.push_back(te.bb0);
+            rv.push_back(te.bb1);
             ),
         (Switch,
-            return e.next_bb;
+            rv.insert(rv.end(), te.targets.begin(), te.targets.end());
             ),
-        (Loop,
-            return e.next_bb;
+        (SwitchValue,
+            rv.insert(rv.end(), te.targets.begin(), te.targets.end());
+            rv.push_back(te.def_target);
+            ),
+        (Call,
+            // NOTE: The panic block isn't reachable from generated C
+            rv.push_back(te.ret_block);
             )
         )
-        throw "";
-    }
-    else {
-        return bb_idx;
+        return rv;
     }
 }
 
+NodeRef::NodeRef(Node node_data):
+    node(new Node(mv$(node_data))),
+    bb_idx(SIZE_MAX)
+{
+}
+
 class Converter
 {
     const ::MIR::Function& m_fcn;
+
+    // Edges that close a loop (found by a DFS from the entry block)
+    ::std::set< ::std::pair<size_t,size_t> >    m_back_edges;
+    // Per loop head, the blocks in the loop body
+    ::std::vector< ::std::vector<bool> >    m_loop_bodies;
+    // Number of non-loop edges to each block, and the number of those that have been converted
+    ::std::vector<unsigned> m_fwd_preds;
+    ::std::vector<unsigned> m_fwd_seen;
+
+    ::std::vector<bool> m_loop_entered;
+    ::std::vector<size_t>   m_loop_stack;
+    unsigned    m_depth = 0;
+
+    // Targets of every jump created (in order), used to pick the block following a construct
+    ::std::vector<size_t>   m_jumps;
 public:
-    ::std::vector<unsigned> m_block_ref_count;
+    ::std::vector<bool> m_reachable;
     ::std::vector<bool> m_blocks_used;
+    ::std::vector<bool> m_labels;
 
     Converter(const ::MIR::Function& fcn):
-        m_fcn(fcn)
-    {
-
-    }
-
-    // Returns true if the passed block is the start of a self-contained sequence of blocks
-    bool bb_is_opening(size_t bb_idx)
-    {
-        if( m_blocks_used[bb_idx] ) {
-            return false;
-        }
-        else if( m_block_ref_count[bb_idx] > 1 ) {
-            // TODO: Determine if these multiple references are from the block looping back on itself
-            return false;
-        }
-        else {
-            return true;
-        }
-    }
-    NodeRef process_node_ref(size_t bb_idx)
+        m_fcn(fcn),
+        m_loop_bodies(fcn.blocks.size()),
+        m_fwd_preds(fcn.blocks.size()),
+        m_fwd_seen(fcn.blocks.size()),
+        m_loop_entered(fcn.blocks.size()),
+        m_reachable(fcn.blocks.size()),
+        m_blocks_used(fcn.blocks.size()),
+        m_labels(fcn.blocks.size())
     {
-        if( bb_is_opening(bb_idx) ) {
-            return NodeRef( process_node(bb_idx) );
-        }
-        else {
-            return NodeRef(bb_idx);
-        }
+        enumerate_edges();
     }
 
     Node process_node(size_t bb_idx)
     {
         TRACE_FUNCTION_F(bb_idx);
         ::std::vector<NodeRef> refs;
+        size_t  next_bb = SIZE_MAX;
+        m_depth ++;
         for(;;)
         {
             DEBUG("bb_idx = " << bb_idx);
-            bool stop = false;
+            // Loop heads are wrapped in a `for(;;)`, with the body starting at the head
+            if( !m_loop_bodies[bb_idx].empty() && !m_loop_entered[bb_idx] )
+            {
+                m_loop_entered[bb_idx] = true;
+                auto first_jump = m_jumps.size();
+                m_loop_stack.push_back(bb_idx);
+                auto body = process_node(bb_idx);
+                m_loop_stack.pop_back();
+                auto exit_bb = pick_following(first_jump);
+                DEBUG("Loop " << bb_idx << " exit " << exit_bb);
+                refs.push_back(Node::make_Loop({ exit_bb, NodeRef(mv$(body)) }));
+                if( exit_bb == SIZE_MAX )
+                    break;
+                bb_idx = exit_bb;
+                continue ;
+            }
+
             assert( !m_blocks_used[bb_idx] );
             m_blocks_used[bb_idx] = true;
-
             refs.push_back( NodeRef(bb_idx) );
 
             const auto& blk = m_fcn.blocks.at(bb_idx);
             DEBUG("> " << blk.terminator);
+            size_t  goto_bb = SIZE_MAX;
+            size_t  following_bb = SIZE_MAX;
             TU_MATCHA( (blk.terminator), (te),
             (Incomplete,
-                stop = true;
+                ),
+            (Return,
+                ),
+            (Diverge,
                 ),
             (Goto,
-                bb_idx = te;
+                goto_bb = te;
                 ),
             (Panic,
-                TODO(Span(), "Panic");
+                goto_bb = te.dst;
                 ),
-            (Diverge,
-                stop = true;
-                ),
-            (Return,
-                stop = true;
+            (Call,
+                goto_bb = te.ret_block;
                 ),
             (If,
-                auto arm0 = process_node_ref(te.bb0);
-                auto arm1 = process_node_ref(te.bb1);
-                if( arm0.has_target() && arm1.has_target() ) {
-                    if( arm0.target() == arm1.target() ) {
-                        bb_idx = arm0.target();
-                    }
-                    else {
-                        stop = true;
-                    }
-                }
-                else if( arm0.has_target() ) {
-                    bb_idx = arm0.target();
-                }
-                else if( arm1.has_target() ) {
-                    bb_idx = arm1.target();
-                }
-                else {
-                    // No target from either arm
-                    stop = false;
-                }
-                refs.push_back(Node::make_If({ bb_idx, &te.cond, mv$(arm0), mv$(arm1) }));
+                visit_edge(bb_idx, te.bb0);
+                visit_edge(bb_idx, te.bb1);
+                auto first_jump = m_jumps.size();
+                auto arm_true = process_arm(te.bb0);
+                auto arm_false = process_arm(te.bb1);
+                following_bb = pick_following(first_jump);
+                refs.push_back(Node::make_If({ following_bb, &te, mv$(arm_false), mv$(arm_true) }));
                 ),
             (Switch,
+                for(auto tgt : te.targets)
+                    visit_edge(bb_idx, tgt);
+                auto first_jump = m_jumps.size();
                 ::std::vector<NodeRef>  arms;
-                ::std::vector<size_t>   next_blocks;
-                for(auto& tgt : te.targets)
-                {
-                    arms.push_back( process_node_ref(tgt) );
-                    if( arms.back().has_target() )
-                    {
-                        next_blocks.push_back( arms.back().target() );
-                    }
-                }
-                ::std::sort(next_blocks.begin(), next_blocks.end());
-                size_t  exit_bb = SIZE_MAX;
-                if(!next_blocks.empty())
-                {
-                    size_t  cur = next_blocks[0];
-                    size_t  cur_count = 0;
-                    size_t  max_count = 0;
-                    for(auto b : next_blocks)
-                    {
-                        if(cur == b) {
-                            cur_count ++;
-                        }
-                        else {
-                            if( cur_count > max_count ) {
-                                exit_bb = cur;
-                            }
-                            cur = b;
-                            cur_count = 1;
-                        }
-                    }
-                    if( cur_count > max_count ) {
-                        exit_bb = cur;
-                    }
-                }
-                refs.push_back(Node::make_Switch({ exit_bb, &te.val, mv$(arms) }));
-                stop = true;
+                for(auto tgt : te.targets)
+                    arms.push_back( process_arm(tgt) );
+                following_bb = pick_following(first_jump);
+                refs.push_back(Node::make_Switch({ following_bb, &te, mv$(arms) }));
                 ),
             (SwitchValue,
                 TODO(Span(), "SwitchValue");
-                ),
-            (Call,
-                // NOTE: Let the panic arm just be a goto
-                bb_idx = te.ret_block;
                 )
             )
 
-            if( stop )
+            if( goto_bb != SIZE_MAX )
             {
-                break;
-            }
-
-            // If `bb_idx` is in `refs` as a NodeRef
-            auto it = ::std::find(refs.begin(), refs.end(), bb_idx);
-            if( it != refs.end() )
-            {
-                // Wrap ibb_idxms from `it` to `refs.end()` in a `loop` block
-                ::std::vector<NodeRef> loop_blocks;
-                loop_blocks.reserve(refs.end() - it);
-                for(auto it2 = it; it2 != refs.end(); ++it2)
-                    loop_blocks.push_back( mv$(*it2) );
-                auto loop_node = NodeRef( Node::make_Block({ SIZE_MAX, mv$(loop_blocks) }) );
-
-                refs.push_back( Node::make_Loop({ SIZE_MAX, mv$(loop_node) }) );
-                // TODO: If there is only one `goto` in the above loop, assume it's the target
-                DEBUG("Loop");
-                break;
+                visit_edge(bb_idx, goto_bb);
+                if( is_single_entry(goto_bb) && is_ready(goto_bb) ) {
+                    bb_idx = goto_bb;
+                }
+                else {
+                    m_jumps.push_back(goto_bb);
+                    next_bb = goto_bb;
+                    break;
+                }
             }
-            else if( bb_is_opening(bb_idx) )
+            else if( following_bb != SIZE_MAX )
             {
-                DEBUG("Destination " << bb_idx << " is unreferenced+unvisited");
+                bb_idx = following_bb;
             }
             else
             {
                 break;
             }
         }
+        m_depth --;
 
-        return Node::make_Block({ bb_idx, mv$(refs) });
+        return Node::make_Block({ next_bb, mv$(refs), NodeExit::None });
     }
-};
 
-::std::vector<Node> MIR_To_Structured(const ::MIR::Function& fcn)
-{
-    Converter   conv(fcn);
-    conv.m_block_ref_count.resize( fcn.blocks.size() );
-    conv.m_block_ref_count[0] += 1;
-    for(const auto& blk : fcn.blocks)
+    /// Determine how each block's trailing jump is emitted, and which blocks need labels
+    struct JumpContext {
+        size_t  fallthrough;
+        size_t  cont;
+        size_t  brk;
+    };
+    void resolve_jumps(Node& node, const JumpContext& ctx)
     {
-        TU_MATCHA( (blk.terminator), (te),
-        (Incomplete,
-            ),
-        (Goto,
-            conv.m_block_ref_count[te] += 1;
+        TU_MATCHA( (node), (e),
+        (Block,
+            for(size_t i = 0; i < e.nodes.size(); i ++)
+            {
+                auto& nr = e.nodes[i];
+                if( !nr.node )
+                    continue ;
+                // The block following a construct is the next node, unless the construct ends this block
+                JumpContext sub_ctx = ctx;
+                size_t following = get_next_bb(*nr.node);
+                if( following != SIZE_MAX )
+                    sub_ctx.fallthrough = following;
+                else if( i != e.nodes.size() - 1 || e.next_bb != SIZE_MAX )
+                    sub_ctx.fallthrough = SIZE_MAX;
+                resolve_jumps(*nr.node, sub_ctx);
+            }
+            if( e.next_bb == SIZE_MAX ) {
+                e.next_exit = NodeExit::None;
+            }
+            else if( e.next_bb == ctx.fallthrough ) {
+                e.next_exit = NodeExit::Fallthrough;
+            }
+            else if( e.next_bb == ctx.cont ) {
+                e.next_exit = NodeExit::Continue;
+            }
+            else if( e.next_bb == ctx.brk ) {
+                e.next_exit = NodeExit::Break;
+            }
+            else {
+                e.next_exit = NodeExit::Goto;
+                m_labels[e.next_bb] = true;
+            }
             ),
-        (Panic,
-            conv.m_block_ref_count[te.dst] += 1;
+        (If,
+            resolve_jumps(*e.arm_true.node, ctx);
+            resolve_jumps(*e.arm_false.node, ctx);
             ),
-        (Diverge,
+        (Switch,
+            // Falling off a `case` runs the next one, `break` leaves the switch
+            JumpContext sub_ctx { SIZE_MAX, ctx.cont, ctx.fallthrough };
+            for(auto& arm : e.arms)
+                resolve_jumps(*arm.node, sub_ctx);
             ),
-        (Return,
+        (Loop,
+            const auto& body = e.code.node->as_Block();
+            assert( !body.nodes.empty() && !body.nodes.front().node );
+            size_t head = body.nodes.front().bb_idx;
+            JumpContext sub_ctx { head, head, ctx.fallthrough };
+            resolve_jumps(*e.code.node, sub_ctx);
+            )
+        )
+    }
+
+private:
+    void enumerate_edges()
+    {
+        const size_t n_blocks = m_fcn.blocks.size();
+        ::std::vector< ::std::vector<size_t> >  preds(n_blocks);
+
+        // Iterative DFS from the entry, edges to a block on the stack are loop back-edges
+        enum class State { Unvisited, OnStack, Done };
+        ::std::vector<State>    state(n_blocks, State::Unvisited);
+        ::std::vector< ::std::pair<size_t, ::std::vector<size_t>> >  stack;
+        ::std::vector< ::std::pair<size_t,size_t> > back_edges;
+        stack.push_back(::std::make_pair( 0, get_successors(m_fcn.blocks[0].terminator) ));
+        state[0] = State::OnStack;
+        m_reachable[0] = true;
+        while( !stack.empty() )
+        {
+            auto& ent = stack.back();
+            if( ent.second.empty() ) {
+                state[ent.first] = State::Done;
+                stack.pop_back();
+                continue ;
+            }
+            size_t src = ent.first;
+            size_t dst = ent.second.front();
+            ent.second.erase(ent.second.begin());
+            preds[dst].push_back(src);
+            switch(state[dst])
+            {
+            case State::OnStack:
+                back_edges.push_back(::std::make_pair(src, dst));
+                m_back_edges.insert(::std::make_pair(src, dst));
+                break;
+            case State::Done:
+                m_fwd_preds[dst] ++;
+                break;
+            case State::Unvisited:
+                m_fwd_preds[dst] ++;
+                state[dst] = State::OnStack;
+                m_reachable[dst] = true;
+                stack.push_back(::std::make_pair( dst, get_successors(m_fcn.blocks[dst].terminator) ));
+                break;
+            }
+        }
+
+        // Loop bodies: blocks that reach the back-edge source without passing through the head
+        for(const auto& be : back_edges)
+        {
+            auto& body = m_loop_bodies[be.second];
+            if( body.empty() ) {
+                body.resize(n_blocks);
+                body[be.second] = true;
+            }
+            ::std::vector<size_t>   todo;
+            todo.push_back(be.first);
+            while( !todo.empty() )
+            {
+                auto bb = todo.back();
+                todo.pop_back();
+                if( body[bb] )
+                    continue ;
+                body[bb] = true;
+                for(auto p : preds[bb])
+                    todo.push_back(p);
+            }
+        }
+    }
+
+    void visit_edge(size_t src, size_t dst)
+    {
+        if( m_back_edges.count(::std::make_pair(src, dst)) == 0 )
+            m_fwd_seen[dst] ++;
+    }
+    // A block can be placed inline once every non-loop edge to it has been converted
+    bool is_ready(size_t bb_idx) const
+    {
+        if( m_blocks_used[bb_idx] )
+            return false;
+        if( m_fwd_seen[bb_idx] != m_fwd_preds[bb_idx] )
+            return false;
+        // Keep loop bodies within their loop (exits are placed after the loop)
+        if( !m_loop_stack.empty() && !m_loop_bodies[m_loop_stack.back()][bb_idx] )
+            return false;
+        return true;
+    }
+    // Blocks with only one entry are placed where they're reached, joins are placed after the construct that completes them
+    bool is_single_entry(size_t bb_idx) const
+    {
+        return m_fwd_preds[bb_idx] == 1;
+    }
+    NodeRef process_arm(size_t bb_idx)
+    {
+        if( m_depth < MAX_NEST_DEPTH && is_single_entry(bb_idx) && is_ready(bb_idx) ) {
+            return NodeRef( process_node(bb_idx) );
+        }
+        else {
+            m_jumps.push_back(bb_idx);
+            return NodeRef( Node::make_Block({ bb_idx, {}, NodeExit::None }) );
+        }
+    }
+    // Select a block that can follow the just-converted construct
+    // - Only blocks where every entry is a jump from within the construct (since `first_jump`)
+    size_t pick_following(size_t first_jump) const
+    {
+        ::std::map<size_t, unsigned>    counts;
+        for(size_t i = first_jump; i < m_jumps.size(); i ++)
+            counts[m_jumps[i]] ++;
+        for(size_t i = first_jump; i < m_jumps.size(); i ++)
+        {
+            auto bb = m_jumps[i];
+            if( counts[bb] == m_fwd_preds[bb] && is_ready(bb) )
+                return bb;
+        }
+        return SIZE_MAX;
+    }
+    static size_t get_next_bb(const Node& node)
+    {
+        TU_MATCHA( (node), (e),
+        (Block,
+            // Blocks only appear as arms/loop bodies
+            return SIZE_MAX;
             ),
         (If,
-            conv.m_block_ref_count[te.bb0] += 1;
-            conv.m_block_ref_count[te.bb1] += 1;
+            return e.next_bb;
             ),
         (Switch,
-            for(auto tgt : te.targets)
-                conv.m_block_ref_count[tgt] += 1;
-            ),
-        (SwitchValue,
-            for(auto tgt : te.targets)
-                conv.m_block_ref_count[tgt] += 1;
-            conv.m_block_ref_count[te.def_target] += 1;
+            return e.next_bb;
             ),
-        (Call,
-            conv.m_block_ref_count[te.ret_block] += 1;
-            conv.m_block_ref_count[te.panic_block] += 1;
+        (Loop,
+            return e.next_bb;
             )
         )
+        throw "";
     }
+};
 
-    // First Block: Becomes a block in structured output
-    // - Terminator selects what the next block will be
-    // - 
+::std::vector<Node> MIR_To_Structured(const ::MIR::Function& fcn, ::std::vector<bool>& out_labels)
+{
+    Converter   conv(fcn);
 
-    // Find next unvisited block
-    conv.m_blocks_used.resize( fcn.blocks.size() );
+    // Convert starting from the entry, then any blocks that couldn't be placed inline
     ::std::vector<Node> nodes;
     for(size_t bb_idx = 0; bb_idx < fcn.blocks.size(); bb_idx ++)
     {
-        if( conv.m_blocks_used[bb_idx] )
+        if( conv.m_blocks_used[bb_idx] || !conv.m_reachable[bb_idx] )
             continue;
 
         nodes.push_back( conv.process_node(bb_idx) );
     }
 
+    for(auto& node : nodes)
+    {
+        conv.resolve_jumps(node, { SIZE_MAX, SIZE_MAX, SIZE_MAX });
+    }
 
-    // Return.
+    out_labels = mv$(conv.m_labels);
     return nodes;
 }
-
-
@@ -14,10 +14,126 @@
 #include <hir_typeck/common.hpp>    // monomorph
 #include <hir_typeck/static.hpp>    // StaticTraitResolve
 #include <hir/item_path.hpp>
+#include "mangling.hpp"
+#include "target.hpp"
+#include <hir/main_bindings.hpp>    // HIR_Serialise_PathsTypes
+#include <hir/serialise_lowlevel.hpp>
+#include <hir_conv/main_bindings.hpp>   // ConvertHIR_Bind_*
 #include <deque>
 #include <algorithm>
+#include <fstream>
+#include <cstring>  // strlen
 
 namespace {
+    /// Whether a monomorphised path only refers to items from extern crates
+    /// - Nothing in the current crate can then change what it uses (coherence keeps impls for it upstream)
+    bool path_is_upstream_only(const ::HIR::Crate& crate, const ::HIR::Path& path)
+    {
+        auto is_local = [&](const ::HIR::SimplePath& p) {
+            return p.m_crate_name == crate.m_crate_name;
+            };
+        auto ty_is_local = [&](const ::HIR::TypeRef& ty)->bool {
+            return visit_ty_with(ty, [&](const ::HIR::TypeRef& t)->bool {
+                TU_MATCH_DEF(::HIR::TypeRef::Data, (t.m_data), (te),
+                (
+                    return false;
+                    ),
+                (Path,
+                    if( const auto* pe = te.path.m_data.opt_Generic() )
+                        return is_local(pe->m_path);
+                    if( const auto* pe = te.path.m_data.opt_UfcsKnown() )
+                        return is_local(pe->trait.m_path);
+                    return true;
+                    ),
+                (TraitObject,
+                    if( is_local(te.m_trait.m_path.m_path) )
+                        return true;
+                    for(const auto& m : te.m_markers)
+                        if( is_local(m.m_path) )
+                            return true;
+                    return false;
+                    ),
+                // Not monomorphic, never cached
+                (Generic,
+                    return true;
+                    ),
+                (Infer,
+                    return true;
+                    ),
+                (ErasedType,
+                    return true;
+                    ),
+                (Closure,
+                    return true;
+                    )
+                )
+                });
+            };
+        auto params_are_local = [&](const ::HIR::PathParams& pp) {
+            for(const auto& ty : pp.m_types)
+                if( ty_is_local(ty) )
+                    return true;
+            return false;
+            };
+        TU_MATCHA( (path.m_data), (pe),
+        (Generic,
+            return !is_local(pe.m_path) && !params_are_local(pe.m_params);
+            ),
+        (UfcsKnown,
+            return !ty_is_local(*pe.type) && !is_local(pe.trait.m_path) && !params_are_local(pe.trait.m_params) && !params_are_local(pe.params);
+            ),
+        (UfcsInherent,
+            return !ty_is_local(*pe.type) && !params_are_local(pe.params) && !params_are_local(pe.impl_params);
+            ),
+        (UfcsUnknown,
+            return false;
+            )
+        )
+        throw "";
+    }
+
+    /// Enumeration results for monomorphised functions that only refer to upstream items, saved between runs
+    /// - These enumerate the same way until an upstream crate changes, so the file is keyed on a hash of the
+    ///   upstream metadata. Re-linking a changed leaf crate then skips walking (and loading) their MIR.
+    struct EnumCache
+    {
+        struct Entry
+        {
+            bool    filled = false; // `paths` and `typeids` are complete
+            bool    typed = false;  // `types` is complete
+            // Items used by the body, in the order they were passed to `Trans_Enumerate_FillFrom_Path` (indexes into `paths`)
+            ::std::vector<unsigned int> paths;
+            ::std::vector<unsigned int> typeids;
+            // Types visited for the signature and body by `Trans_Enumerate_Types` (indexes into `types`)
+            ::std::vector<unsigned int> types;
+        };
+        template<typename T>
+        struct PtrLess {
+            bool operator()(const T* a, const T* b) const { return *a < *b; }
+        };
+
+        ::std::string   filename;
+        uint64_t    key = 0;
+        bool    dirty = false;
+
+        // Paths and types referenced by entries (deques so the index maps can point into them)
+        ::std::deque< ::HIR::Path>  paths;
+        ::std::deque< ::HIR::TypeRef>   types;
+        ::std::map<const ::HIR::Path*, unsigned int, PtrLess< ::HIR::Path> >   path_indexes;
+        ::std::map<const ::HIR::TypeRef*, unsigned int, PtrLess< ::HIR::TypeRef> >    type_indexes;
+        // Keyed by the index of the function's path
+        ::std::map<unsigned int, Entry> entries;
+
+        unsigned int intern(const ::HIR::Path& p);
+        unsigned int intern(const ::HIR::TypeRef& t);
+        Entry& get(const ::HIR::Path& fcn_path) {
+            return entries[intern(fcn_path)];
+        }
+
+        void load(const ::HIR::Crate& crate, ::std::string filename);
+        void save() const;
+    };
+
     struct EnumState
     {
         const ::HIR::Crate& crate;
@@ -27,18 +143,53 @@ namespace {
         ::std::deque<TransList_Function*>  fcn_queue;
         ::std::vector<TransList_Function*> fcns_to_type_visit;
 
-        EnumState(const ::HIR::Crate& crate):
+        // Monomorphised functions already defined by upstream objects (see `HIR::Crate::m_exported_instances`)
+        ::std::set< ::std::string>  upstream_instances;
+        unsigned int    upstream_count = 0;
+
+        // Persisted enumeration (disabled if the filename is empty)
+        EnumCache   cache;
+        ::std::map<const TransList_Function*, EnumCache::Entry*>   cached_fcns;
+        // Entry receiving the items used by the function currently being filled from
+        EnumCache::Entry*   recording = nullptr;
+        unsigned int    cache_hits = 0;
+
+        EnumState(const ::HIR::Crate& crate, const ::std::string& cache_file):
             crate(crate)
-        {}
+        {
+            for(const auto& ec : crate.m_ext_crates)
+                upstream_instances.insert( ec.second.m_data->m_exported_instances.begin(), ec.second.m_data->m_exported_instances.end() );
+            if( cache_file != "" )
+                cache.load(crate, cache_file);
+        }
 
         void enum_fcn(::HIR::Path p, const ::HIR::Function& fcn, Trans_Params pp)
         {
+            // Only functions with MIR would be emitted locally, and so can be taken from upstream
+            // - `#[inline]` functions are always emitted locally (so they can still be inlined)
+            bool is_upstream = fcn.m_code.m_mir && fcn.m_inline != ::HIR::Function::Inline::Hint && fcn.m_inline != ::HIR::Function::Inline::Always
+                && !upstream_instances.empty() && upstream_instances.count( FMT(Trans_Mangle(p)) ) > 0;
+            EnumCache::Entry* cache_ent = nullptr;
+            if( cache.filename != "" && fcn.m_code.m_mir && rv.m_functions.count(p) == 0 && path_is_upstream_only(crate, p) )
+            {
+                cache_ent = &cache.get(p);
+            }
             if(auto* e = rv.add_function(mv$(p)))
             {
                 fcns_to_type_visit.push_back(e);
                 e->ptr = &fcn;
                 e->pp = mv$(pp);
-                fcn_queue.push_back(e);
+                if( cache_ent ) {
+                    cached_fcns[e] = cache_ent;
+                }
+                // Upstream functions just need their signature, don't enumerate (or load) their body
+                if( is_upstream ) {
+                    e->upstream = true;
+                    upstream_count ++;
+                }
+                else {
+                    fcn_queue.push_back(e);
+                }
             }
         }
     };
@@ -54,11 +205,11 @@ void Trans_Enumerate_FillFrom_Literal(EnumState& state, const ::HIR::Literal& li
 void Trans_Enumerate_FillFrom_MIR(EnumState& state, const ::MIR::Function& code, const Trans_Params& pp);
 
 /// Enumerate trans items starting from `::main` (binary crate)
-TransList Trans_Enumerate_Main(const ::HIR::Crate& crate)
+TransList Trans_Enumerate_Main(const ::HIR::Crate& crate, const ::std::string& cache_file)
 {
     static Span sp;
 
-    EnumState   state { crate };
+    EnumState   state { crate, cache_file };
 
     auto c_start_path = crate.get_lang_item_path_opt("mrustc-start");
     if( c_start_path == ::HIR::SimplePath() )
@@ -151,10 +302,10 @@ namespace {
 }
 
 /// Enumerate trans items for all public non-generic items (library crate)
-TransList Trans_Enumerate_Public(::HIR::Crate& crate)
+TransList Trans_Enumerate_Public(::HIR::Crate& crate, const ::std::string& cache_file)
 {
     static Span sp;
-    EnumState   state { crate };
+    EnumState   state { crate, cache_file };
 
     Trans_Enumerate_Public_Mod(state, crate.m_root_module,  ::HIR::SimplePath(crate.m_crate_name,{}), true);
 
@@ -318,6 +469,39 @@ TransList Trans_Enumerate_Public(::HIR::Crate& crate)
             ++ it;
         }
     }
+
+    // Record the vtables and drop glue that codegen will define, so downstream crates can link to them
+    crate.m_exported_glue.clear();
+    for(const auto& ent : rv.m_vtables)
+    {
+        crate.m_exported_glue.push_back( FMT(Trans_Mangle(ent.first)) );
+    }
+    for(const auto& ent : rv.m_types)
+    {
+        const auto& ty = ent.first;
+        if( ent.second || !(ty.m_data.is_Tuple() || ty.m_data.is_Path()) )
+            continue ;
+        if( resolve.type_needs_drop_glue(sp, ty) )
+            crate.m_exported_glue.push_back( FMT(Trans_Mangle(::HIR::Path(ty.clone(), "#drop_glue"))) );
+    }
+    // Record the functions that downstream crates could otherwise monomorphise themselves (i.e. ones with saved MIR)
+    // - Upstream functions are emitted `static` unless they can be made weak (see codegen_c)
+    // - `#[inline]` functions are not exported: gcc ignores `weak` on inline definitions, and downstream crates should
+    //   keep their own copy to inline.
+    const bool weak_upstream = Target_GetCurSpec().m_codegen_mode == CodegenMode::Gnu11;
+    crate.m_exported_instances.clear();
+    for(const auto& ent : rv.m_functions)
+    {
+        const auto& fcn = *ent.second->ptr;
+        if( ent.second->upstream || !fcn.m_code.m_mir )
+            continue ;
+        if( fcn.m_inline == ::HIR::Function::Inline::Hint || fcn.m_inline == ::HIR::Function::Inline::Always )
+            continue ;
+        bool is_extern = ! static_cast<bool>(fcn.m_code);
+        if( is_extern ? !weak_upstream : !(fcn.m_save_code || fcn.m_const) )
+            continue ;
+        crate.m_exported_instances.push_back( FMT(Trans_Mangle(ent.first)) );
+    }
     return rv;
 }
 
@@ -333,7 +517,35 @@ void Trans_Enumerate_CommonPost_Run(EnumState& state)
 
         TRACE_FUNCTION_F("Function " << ::std::find_if(state.rv.m_functions.begin(), state.rv.m_functions.end(), [&](const auto&x){ return x.second.get() == &fcn_out; })->first);
 
-        Trans_Enumerate_FillFrom(state, *fcn_out.ptr, fcn_out.pp);
+        auto it = state.cached_fcns.find(&fcn_out);
+        if( it == state.cached_fcns.end() )
+        {
+            Trans_Enumerate_FillFrom(state, *fcn_out.ptr, fcn_out.pp);
+        }
+        else if( it->second->filled )
+        {
+            // Replay the items the body used last time (the paths are already monomorphised)
+            // - Ones that are already enumerated would be looked up only to be ignored, so are skipped
+            DEBUG("Cached");
+            for(auto idx : it->second->paths)
+            {
+                const auto& path = state.cache.paths[idx];
+                if( state.rv.m_functions.count(path) || state.rv.m_statics.count(path) || state.rv.m_vtables.count(path) )
+                    continue ;
+                Trans_Enumerate_FillFrom_Path(state, path, {});
+            }
+            for(auto idx : it->second->typeids)
+                state.rv.m_typeids.insert( state.cache.types[idx].clone() );
+            state.cache_hits ++;
+        }
+        else
+        {
+            state.recording = it->second;
+            Trans_Enumerate_FillFrom(state, *fcn_out.ptr, fcn_out.pp);
+            state.recording = nullptr;
+            it->second->filled = true;
+            state.cache.dirty = true;
+        }
     }
 }
 TransList Trans_Enumerate_CommonPost(EnumState& state)
@@ -341,9 +553,181 @@ TransList Trans_Enumerate_CommonPost(EnumState& state)
     Trans_Enumerate_CommonPost_Run(state);
     Trans_Enumerate_Types(state);
 
+    if( state.upstream_count > 0 )
+    {
+        ::std::cout << "Trans Enumerate: Using " << state.upstream_count << " monomorphised functions from upstream crates" << ::std::endl;
+    }
+    if( state.cache_hits > 0 )
+    {
+        ::std::cout << "Trans Enumerate: Reused the cached enumeration of " << state.cache_hits << " upstream functions" << ::std::endl;
+    }
+    if( state.cache.dirty )
+    {
+        state.cache.save();
+    }
+
     return mv$(state.rv);
 }
 
+namespace {
+    /// Hash (FNV-1a) of the metadata of every loaded extern crate, the key for `EnumCache`
+    uint64_t hash_ext_crates(const ::HIR::Crate& crate)
+    {
+        // Change this when the enumeration or the cache format changes
+        const char* CACHE_VERSION = "tenum-1";
+
+        uint64_t    rv = 0xcbf29ce484222325;
+        auto add = [&](const char* data, size_t len) {
+            for(size_t i = 0; i < len; i ++)
+            {
+                rv ^= static_cast<uint8_t>(data[i]);
+                rv *= 0x100000001b3;
+            }
+            };
+        add(CACHE_VERSION, strlen(CACHE_VERSION)+1);
+
+        // Visit in a fixed order (the map is unordered)
+        ::std::vector<const ::std::pair<const ::std::string, ::HIR::ExternCrate>*>   ext_crates;
+        for(const auto& ec : crate.m_ext_crates)
+            ext_crates.push_back(&ec);
+        ::std::sort(ext_crates.begin(), ext_crates.end(), [](const auto* a, const auto* b){ return a->first < b->first; });
+        for(const auto* ec : ext_crates)
+        {
+            add(ec->first.c_str(), ec->first.size()+1);
+            for(const auto& filename : { ec->second.m_path, ec->second.m_path + ".mir" })
+            {
+                ::std::ifstream is(filename, ::std::ios_base::binary);
+                char    buf[64*1024];
+                while( is.read(buf, sizeof(buf)) || is.gcount() > 0 )
+                    add(buf, is.gcount());
+                add("", 1);
+            }
+        }
+        return rv;
+    }
+}
+
+unsigned int EnumCache::intern(const ::HIR::Path& p)
+{
+    auto it = path_indexes.find(&p);
+    if( it != path_indexes.end() )
+        return it->second;
+    paths.push_back( p.clone() );
+    unsigned int idx = paths.size() - 1;
+    path_indexes.insert( ::std::make_pair(&paths.back(), idx) );
+    return idx;
+}
+unsigned int EnumCache::intern(const ::HIR::TypeRef& t)
+{
+    auto it = type_indexes.find(&t);
+    if( it != type_indexes.end() )
+        return it->second;
+    types.push_back( t.clone() );
+    unsigned int idx = types.size() - 1;
+    type_indexes.insert( ::std::make_pair(&types.back(), idx) );
+    return idx;
+}
+
+void EnumCache::load(const ::HIR::Crate& crate, ::std::string filename)
+{
+    this->filename = mv$(filename);
+    this->key = hash_ext_crates(crate);
+    try
+    {
+        ::HIR::serialise::Reader    in { this->filename };
+        if( in.read_string() != "mrustc-tenum" || in.read_u64() != key )
+        {
+            DEBUG("Stale enumeration cache " << this->filename);
+            return ;
+        }
+        ::std::vector< ::HIR::Path> in_paths;
+        ::std::vector< ::HIR::TypeRef>  in_types;
+        HIR_Deserialise_PathsTypes(in, in_paths, in_types);
+        auto read_indexes = [&](size_t limit) {
+            ::std::vector<unsigned int>    rv;
+            rv.resize( in.read_u64c() );
+            for(auto& v : rv)
+            {
+                v = in.read_u64c();
+                if( v >= limit )
+                    throw ::std::runtime_error("Index out of range");
+            }
+            return rv;
+            };
+        ::std::map<unsigned int, Entry> in_entries;
+        for(size_t n = in.read_u64c(); n --; )
+        {
+            unsigned int idx = in.read_u64c();
+            if( idx >= in_paths.size() )
+                throw ::std::runtime_error("Index out of range");
+            auto& e = in_entries[idx];
+            uint8_t flags = in.read_u8();
+            e.filled = (flags & 1) != 0;
+            e.typed = (flags & 2) != 0;
+            e.paths = read_indexes(in_paths.size());
+            e.typeids = read_indexes(in_types.size());
+            e.types = read_indexes(in_types.size());
+        }
+
+        for(auto& p : in_paths)
+        {
+            ConvertHIR_Bind_Path(crate, p);
+            paths.push_back( mv$(p) );
+            path_indexes.insert( ::std::make_pair(&paths.back(), paths.size() - 1) );
+        }
+        for(auto& t : in_types)
+        {
+            ConvertHIR_Bind_Type(crate, t);
+            types.push_back( mv$(t) );
+            type_indexes.insert( ::std::make_pair(&types.back(), types.size() - 1) );
+        }
+        entries = mv$(in_entries);
+        DEBUG("Loaded " << entries.size() << " cached functions from " << this->filename);
+    }
+    catch(const ::std::runtime_error& e)
+    {
+        // Missing or unreadable, start afresh
+        DEBUG("Enumeration cache " << this->filename << " not used: " << e.what());
+    }
+}
+void EnumCache::save() const
+{
+    try
+    {
+        ::HIR::serialise::Writer    out { filename };
+        out.write_string("mrustc-tenum");
+        out.write_u64(key);
+
+        ::std::vector<const ::HIR::Path*>  path_ptrs;
+        for(const auto& p : paths)
+            path_ptrs.push_back(&p);
+        ::std::vector<const ::HIR::TypeRef*>   type_ptrs;
+        for(const auto& t : types)
+            type_ptrs.push_back(&t);
+        HIR_Serialise_PathsTypes(out, path_ptrs, type_ptrs);
+
+        auto write_indexes = [&](const ::std::vector<unsigned int>& v) {
+            out.write_u64c(v.size());
+            for(auto idx : v)
+                out.write_u64c(idx);
+            };
+        out.write_u64c(entries.size());
+        for(const auto& e : entries)
+        {
+            out.write_u64c(e.first);
+            out.write_u8( (e.second.filled ? 1 : 0) | (e.second.typed ? 2 : 0) );
+            write_indexes(e.second.paths);
+            write_indexes(e.second.typeids);
+            write_indexes(e.second.types);
+        }
+    }
+    catch(const ::std::runtime_error& e)
+    {
+        // Only a cache, carry on without it
+        ::std::cerr << "Unable to write enumeration cache " << filename << ": " << e.what() << ::std::endl;
+    }
+}
+
 namespace {
     struct PtrComp
     {
@@ -360,6 +744,9 @@ namespace {
         ::std::map< ::HIR::TypeRef, bool > visited;
         ::std::set< const ::HIR::TypeRef*, PtrComp> active_set;
 
+        // While set, top-level visits are appended to this (for `EnumCache`)
+        ::std::vector< ::HIR::TypeRef>*    m_record = nullptr;
+
         TypeVisitor(const ::HIR::Crate& crate, ::std::vector< ::std::pair< ::HIR::TypeRef, bool > >& out_list):
             m_crate(crate),
             m_resolve(crate),
@@ -451,6 +838,16 @@ namespace {
 
         void visit_type(const ::HIR::TypeRef& ty, Mode mode = Mode::Normal)
         {
+            if( m_record )
+            {
+                // Only the outer type is recorded, visiting it again finds the rest
+                auto* record = m_record;
+                m_record = nullptr;
+                record->push_back( ty.clone() );
+                visit_type(ty, mode);
+                m_record = record;
+                return ;
+            }
             // If the type has already been visited, AND either this is a shallow visit, or the previous wasn't
             {
                 auto it = visited.find(ty);
@@ -606,6 +1003,21 @@ void Trans_Enumerate_Types(EnumState& state)
             const auto& fcn = *p->ptr;
             const auto& pp = p->pp;
 
+            auto cache_it = state.cached_fcns.find(p);
+            auto* cache_ent = (cache_it != state.cached_fcns.end() ? cache_it->second : nullptr);
+            if( cache_ent && cache_ent->typed )
+            {
+                DEBUG("Cached");
+                for(auto idx : cache_ent->types)
+                    tv.visit_type(state.cache.types[idx]);
+                continue ;
+            }
+            ::std::vector< ::HIR::TypeRef>  recorded_types;
+            if( cache_ent )
+            {
+                tv.m_record = &recorded_types;
+            }
+
             ::HIR::TypeRef   tmp;
             auto monomorph = [&](const auto& ty)->const auto& {
                 return monomorphise_type_needed(ty) ? tmp = pp.monomorph(tv.m_resolve, ty) : ty;
@@ -636,7 +1048,7 @@ void Trans_Enumerate_Types(EnumState& state)
             for(const auto& arg : fcn.m_args)
                 tv.visit_type( monomorph(arg.second) );
 
-            if( fcn.m_code.m_mir )
+            if( fcn.m_code.m_mir && !p->upstream )
             {
                 const auto& mir = *fcn.m_code.m_mir;
                 for(const auto& ty : mir.locals)
@@ -969,6 +1381,21 @@ void Trans_Enumerate_Types(EnumState& state)
                     )
                 }
             }
+
+            if( cache_ent )
+            {
+                tv.m_record = nullptr;
+                // Later visits of an already-visited type do nothing, so only the first is kept
+                ::std::set<unsigned int>    seen;
+                for(const auto& ty : recorded_types)
+                {
+                    auto idx = state.cache.intern(ty);
+                    if( seen.insert(idx).second )
+                        cache_ent->types.push_back(idx);
+                }
+                cache_ent->typed = true;
+                state.cache.dirty = true;
+            }
         }
         state.fcns_to_type_visit.clear();
         // TODO: Similarly restrict revisiting of statics.
@@ -1286,6 +1713,13 @@ void Trans_Enumerate_FillFrom_Path(EnumState& state, const ::HIR::Path& path, co
     Span    sp;
     auto path_mono = pp.monomorph(state.crate, path);
     DEBUG("- " << path_mono);
+    // Record the items used directly by a cached function (anything used by those is found again on replay)
+    auto* recording = state.recording;
+    if( recording )
+    {
+        recording->paths.push_back( state.cache.intern(path_mono) );
+        state.recording = nullptr;
+    }
     Trans_Params  sub_pp(sp);
     TU_MATCHA( (path_mono.m_data), (pe),
     (Generic,
@@ -1356,6 +1790,7 @@ void Trans_Enumerate_FillFrom_Path(EnumState& state, const ::HIR::Path& path, co
         Trans_Enumerate_FillFrom_Literal(state, e->m_value_res, sub_pp);
         )
     )
+    state.recording = recording;
 }
 void Trans_Enumerate_FillFrom_MIR_LValue(EnumState& state, const ::MIR::LValue& lv, const Trans_Params& pp)
 {
@@ -1514,7 +1949,10 @@ void Trans_Enumerate_FillFrom_MIR(EnumState& state, const ::MIR::Function& code,
             (Intrinsic,
                 if( e2.name == "type_id" ) {
                     // Add <T>::#type_id to the enumerate list
-                    state.rv.m_typeids.insert( pp.monomorph(state.crate, e2.params.m_types.at(0)) );
+                    auto ty = pp.monomorph(state.crate, e2.params.m_types.at(0));
+                    if( state.recording )
+                        state.recording->typeids.push_back( state.cache.intern(ty) );
+                    state.rv.m_typeids.insert( mv$(ty) );
                 }
                 )
             )
@@ -1552,6 +1990,8 @@ void Trans_Enumerate_FillFrom_Literal(EnumState& state, const ::HIR::Literal& li
         for(const auto& v : e)
             Trans_Enumerate_FillFrom_Literal(state, v, pp);
         ),
+    (Packed,
+        ),
     (Variant,
         for(const auto& v : e.vals)
             Trans_Enumerate_FillFrom_Literal(state, v, pp);
@@ -17,14 +17,21 @@ struct TransOptions
 {
     unsigned int opt_level = 0;
     bool emit_debug_info = false;
+    /// Compile/link with the C compiler's LTO, so code can be inlined across crates
+    bool enable_lto = false;
+    /// Mark `&mut` and `&` (to types without an `UnsafeCell`) arguments as `restrict`
+    bool emit_restrict = false;
+    /// Emit C with loops/ifs/switches recovered from the MIR (instead of a label and `goto` per block)
+    bool structured_c = true;
 
     ::std::vector< ::std::string>   library_search_dirs;
     ::std::vector< ::std::string>   libraries;
 };
 
-extern TransList Trans_Enumerate_Main(const ::HIR::Crate& crate);
+// `cache_file` keeps the enumeration of upstream generics between runs (empty to disable)
+extern TransList Trans_Enumerate_Main(const ::HIR::Crate& crate, const ::std::string& cache_file);
 extern TransList Trans_Enumerate_Test(const ::HIR::Crate& crate);
 // NOTE: This also sets the saveout flags
-extern TransList Trans_Enumerate_Public(::HIR::Crate& crate);
+extern TransList Trans_Enumerate_Public(::HIR::Crate& crate, const ::std::string& cache_file);
 
 extern void Trans_Codegen(const ::std::string& outfile, const TransOptions& opt, const ::HIR::Crate& crate, const TransList& list, bool is_executable);
@@ -9,18 +9,23 @@
 #include <algorithm>
 #include "../expand/cfg.hpp"
 #include <fstream>
+#include <hir/hir.hpp>
+#include <hir_typeck/static.hpp>
 
 TargetArch ARCH_X86_64 = {
     "x86_64",
     64, false,
-    { /*atomic(u8)=*/true, false, true, true,  true }
+    { /*atomic(u8)=*/true, false, true, true,  true },
+    /*int128=*/true
     };
 TargetArch ARCH_X86 = {
     "x86",
     32, false,
-    { /*atomic(u8)=*/true, false, true, false,  true }
+    { /*atomic(u8)=*/true, false, true, false,  true },
+    /*int128=*/false
 };
 TargetSpec  g_target;
+static bool g_target_force_emulated_i128 = false;
 
 namespace
 {
@@ -75,6 +80,19 @@ const TargetSpec& Target_GetCurSpec()
 {
     return g_target;
 }
+bool Target_EmulatesI128()
+{
+    if( g_target_force_emulated_i128 )
+        return true;
+    // MSVC has no 128-bit integer type
+    if( g_target.m_codegen_mode == CodegenMode::Msvc )
+        return true;
+    return !g_target.m_arch.m_has_int128;
+}
+void Target_ForceEmulatedI128()
+{
+    g_target_force_emulated_i128 = true;
+}
 void Target_SetCfg(const ::std::string& target_name)
 {
     g_target = init_from_spec_name(target_name);
@@ -107,7 +125,431 @@ void Target_SetCfg(const ::std::string& target_name)
         });
 }
 
-bool Target_GetSizeAndAlignOf(const Span& sp, const ::HIR::TypeRef& ty, size_t& out_size, size_t& out_align)
+// --------------------------------------------------------------------
+// Enum representation
+// --------------------------------------------------------------------
+const unsigned TargetEnumRepr::PATH_PTR = ~0u;
+const unsigned TargetEnumRepr::PATH_TAG = ~1u;
+
+static bool Target_GetSizeAndAlignOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_size, size_t& out_align);
+
+/// Layouts already computed using a `StaticTraitResolve`
+/// - Kept on the resolve (like its other caches), so it isn't shared between threads or crates
+struct TargetLayoutCache
+{
+    ::std::map< ::HIR::GenericPath, TargetEnumRepr> enums;
+    ::std::map< ::HIR::TypeRef, TargetStructRepr>   structs;
+};
+
+namespace {
+    TargetLayoutCache& get_layout_cache(const StaticTraitResolve& resolve)
+    {
+        if( !resolve.m_target_layout_cache )
+            resolve.m_target_layout_cache = ::std::make_shared<TargetLayoutCache>();
+        return *resolve.m_target_layout_cache;
+    }
+
+    /// A field with invalid values that can be used to encode enum variants
+    struct NicheSlot
+    {
+        ::std::vector<unsigned> path;   // NOTE: Built in reverse order (innermost first)
+        bool    is_byte;
+        uint64_t    start;
+        uint64_t    end;
+    };
+
+    /// Determine if a pointer to `ty` carries metadata (i.e. `ty` is unsized)
+    /// - Returns false if that isn't known, e.g. for generics and unresolved associated types (which may be `?Sized`)
+    bool get_pointer_is_fat(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, bool& out_is_fat)
+    {
+        out_is_fat = false;
+        if( ty == ::HIR::CoreType::Str || ty.m_data.is_Slice() || ty.m_data.is_TraitObject() ) {
+            out_is_fat = true;
+            return true;
+        }
+        if( ty.m_data.is_Generic() || ty.m_data.is_Infer() || ty.m_data.is_ErasedType() )
+            return false;
+        const auto* te = ty.m_data.opt_Path();
+        if( !te )
+            return true;
+        if( te->binding.is_Unbound() || te->binding.is_Opaque() )
+            return false;
+        if( !te->binding.is_Struct() )
+            return true;
+        const auto& str = *te->binding.as_Struct();
+        switch( str.m_struct_markings.dst_type )
+        {
+        case ::HIR::StructMarkings::DstType::None:
+            return true;
+        case ::HIR::StructMarkings::DstType::Slice:
+        case ::HIR::StructMarkings::DstType::TraitObject:
+            out_is_fat = true;
+            return true;
+        case ::HIR::StructMarkings::DstType::Possible:
+            break;
+        }
+        const auto& gp = te->path.m_data.as_Generic();
+        const ::HIR::TypeRef* last = nullptr;
+        TU_MATCHA( (str.m_data), (se),
+        (Unit, ),
+        (Tuple, if( se.size() > 0 ) last = &se.back().ent; ),
+        (Named, if( se.size() > 0 ) last = &se.back().second.ent; )
+        )
+        if( !last )
+            return true;
+        auto inner = monomorphise_type(sp, str.m_params, gp.m_params, *last);
+        resolve.expand_associated_types(sp, inner);
+        return get_pointer_is_fat(sp, resolve, inner, out_is_fat);
+    }
+    /// Check if `ty` is known to be unsized
+    bool type_is_unsized(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty)
+    {
+        bool    is_fat;
+        return get_pointer_is_fat(sp, resolve, ty, is_fat) && is_fat;
+    }
+
+    bool find_niche(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, uint64_t count, NicheSlot& out);
+
+    size_t round_up(size_t v, size_t align)
+    {
+        return align <= 1 ? v : (v + align - 1) / align * align;
+    }
+
+    /// Lay out a list of fields
+    /// - `reorder`: Sort by decreasing alignment (keeping a possibly-unsized tail last)
+    /// - `packed`: Fields are unaligned (no padding, and the result has an alignment of 1)
+    TargetStructRepr layout_fields(const Span& sp, const StaticTraitResolve& resolve, const ::std::vector<::HIR::TypeRef>& fields, bool reorder, bool has_tail, bool packed=false)
+    {
+        TargetStructRepr    rv;
+        ::std::vector<size_t>   sizes, aligns;
+        bool    align_known = true;
+        rv.size_known = true;
+        for(unsigned int i = 0; i < fields.size(); i ++)
+        {
+            rv.fields.push_back(i);
+
+            size_t  size = 0, align = 0;
+            if( has_tail && i == fields.size() - 1 && type_is_unsized(sp, resolve, fields[i]) )
+            {
+                rv.size_known = false;
+            }
+            else if( !Target_GetSizeAndAlignOf(sp, resolve, fields[i], size, align) )
+            {
+                rv.size_known = false;
+                align_known = false;
+            }
+            sizes.push_back(size);
+            aligns.push_back(packed ? 1 : ::std::max<size_t>(align, 1));
+        }
+
+        if( reorder && align_known )
+        {
+            auto end = rv.fields.end();
+            if( has_tail && end != rv.fields.begin() )
+                -- end;
+            ::std::stable_sort(rv.fields.begin(), end, [&](unsigned a, unsigned b){ return aligns[a] > aligns[b]; });
+        }
+
+        if( rv.size_known )
+        {
+            size_t  ofs = 0;
+            rv.align = 1;
+            for(auto idx : rv.fields)
+            {
+                ofs = round_up(ofs, aligns[idx]) + sizes[idx];
+                rv.align = ::std::max(rv.align, aligns[idx]);
+            }
+            // NOTE: MSVC can't have empty structs, a `char` is inserted instead
+            if( fields.empty() && g_target.m_codegen_mode == CodegenMode::Msvc )
+                ofs = 1;
+            rv.size = round_up(ofs, rv.align);
+        }
+        return rv;
+    }
+
+    bool find_niche_fields(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::GenericParams& params_def, const ::HIR::PathParams& params, const ::std::vector<::HIR::TypeRef>& fields, uint64_t count, NicheSlot& out)
+    {
+        for(unsigned int i = 0; i < fields.size(); i ++)
+        {
+            auto ty = monomorphise_type(sp, params_def, params, fields[i]);
+            resolve.expand_associated_types(sp, ty);
+            if( find_niche(sp, resolve, ty, count, out) )
+            {
+                out.path.push_back(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ::std::vector<::HIR::TypeRef> get_field_types(const ::HIR::Struct::Data& data)
+    {
+        ::std::vector<::HIR::TypeRef>   rv;
+        TU_MATCHA( (data), (se),
+        (Unit, ),
+        (Tuple,
+            for(const auto& f : se)
+                rv.push_back( f.ent.clone() );
+            ),
+        (Named,
+            for(const auto& f : se)
+                rv.push_back( f.second.ent.clone() );
+            )
+        )
+        return rv;
+    }
+    ::std::vector<::HIR::TypeRef> get_field_types(const ::HIR::Enum::Variant& var)
+    {
+        ::std::vector<::HIR::TypeRef>   rv;
+        TU_MATCHA( (var), (ve),
+        (Unit, ),
+        (Value, ),
+        (Tuple,
+            for(const auto& f : ve)
+                rv.push_back( f.ent.clone() );
+            ),
+        (Struct,
+            for(const auto& f : ve)
+                rv.push_back( f.second.ent.clone() );
+            )
+        )
+        return rv;
+    }
+
+    /// Locate a slot within `ty` with at least `count` unused values
+    bool find_niche(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, uint64_t count, NicheSlot& out)
+    {
+        TU_MATCH_DEF( ::HIR::TypeRef::Data, (ty.m_data), (te),
+        (
+            return false;
+            ),
+        (Primitive,
+            switch(te)
+            {
+            case ::HIR::CoreType::Bool:
+                out = NicheSlot { {}, true, 2, 0x100 };
+                break;
+            case ::HIR::CoreType::Char:
+                out = NicheSlot { {}, false, 0x110000, UINT64_C(0x100000000) };
+                break;
+            default:
+                return false;
+            }
+            ),
+        (Borrow,
+            bool    is_fat;
+            if( !get_pointer_is_fat(sp, resolve, *te.inner, is_fat) )
+                return false;
+            out = NicheSlot { {}, false, 0, 1 };
+            if( is_fat )
+                out.path.push_back(TargetEnumRepr::PATH_PTR);
+            ),
+        (Function,
+            out = NicheSlot { {}, false, 0, 1 };
+            ),
+        (Tuple,
+            for(unsigned int i = 0; i < te.size(); i ++)
+            {
+                if( find_niche(sp, resolve, te[i], count, out) )
+                {
+                    out.path.push_back(i);
+                    return true;
+                }
+            }
+            return false;
+            ),
+        (Path,
+            if( !te.path.m_data.is_Generic() )
+                return false;
+            const auto& gp = te.path.m_data.as_Generic();
+            TU_MATCH_DEF( ::HIR::TypeRef::TypePathBinding, (te.binding), (tpb),
+            (
+                return false;
+                ),
+            (Struct,
+                if( gp.m_path == resolve.m_crate.get_lang_item_path_opt("non_zero") )
+                {
+                    // `NonZero<T>` - Zero is never valid for the inner value
+                    auto inner = monomorphise_type(sp, tpb->m_params, gp.m_params, tpb->m_data.as_Tuple().at(0).ent);
+                    resolve.expand_associated_types(sp, inner);
+                    const ::HIR::TypeRef* pointee = nullptr;
+                    if( const auto* ie = inner.m_data.opt_Pointer() )
+                        pointee = &*ie->inner;
+                    if( const auto* ie = inner.m_data.opt_Borrow() )
+                        pointee = &*ie->inner;
+                    bool    is_fat = false;
+                    if( pointee && !get_pointer_is_fat(sp, resolve, *pointee, is_fat) )
+                        return false;
+                    out = NicheSlot { {}, false, 0, 1 };
+                    if( is_fat )
+                        out.path.push_back(TargetEnumRepr::PATH_PTR);
+                    out.path.push_back(0);
+                    break;
+                }
+                if( !find_niche_fields(sp, resolve, tpb->m_params, gp.m_params, get_field_types(tpb->m_data), count, out) )
+                    return false;
+                ),
+            (Enum,
+                const auto& repr = Target_GetEnumRepr(sp, resolve, gp, *tpb);
+                if( repr.free_end <= repr.free_start )
+                    return false;
+                out = NicheSlot { repr.niche_path, repr.niche_is_byte, repr.free_start, repr.free_end };
+                ::std::reverse(out.path.begin(), out.path.end());
+                )
+            )
+            )
+        )
+        return out.end - out.start >= count;
+    }
+}
+
+const TargetEnumRepr& Target_GetEnumRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::GenericPath& path, const ::HIR::Enum& enm)
+{
+    auto& cache = get_layout_cache(resolve).enums;
+    auto it = cache.find(path);
+    if( it != cache.end() )
+        return it->second;
+    TRACE_FUNCTION_F(path);
+
+    TargetEnumRepr  rv;
+    for(const auto& var : enm.m_variants)
+    {
+        auto fields = get_field_types(var.second);
+        for(auto& ty : fields)
+        {
+            ty = monomorphise_type(sp, enm.m_params, path.m_params, ty);
+            resolve.expand_associated_types(sp, ty);
+        }
+        rv.variants.push_back( layout_fields(sp, resolve, fields, enm.m_repr == ::HIR::Enum::Repr::Rust, false) );
+    }
+
+    if( enm.m_repr == ::HIR::Enum::Repr::Rust && enm.m_variants.size() > 0 )
+    {
+        // Look for a single variant with data (all others having no fields)
+        unsigned data_variant = ~0u;
+        for(unsigned int i = 0; i < enm.m_variants.size(); i ++)
+        {
+            if( get_field_types(enm.m_variants[i].second).empty() )
+                continue ;
+            data_variant = (data_variant == ~0u ? i : ~1u);
+        }
+
+        NicheSlot   slot;
+        uint64_t    count = enm.m_variants.size() - 1;
+        if( data_variant < enm.m_variants.size() && count > 0
+            && find_niche_fields(sp, resolve, enm.m_params, path.m_params, get_field_types(enm.m_variants[data_variant].second), count, slot) )
+        {
+            ::std::reverse(slot.path.begin(), slot.path.end());
+            rv.kind = TargetEnumRepr::Kind::Niche;
+            rv.data_variant = data_variant;
+            rv.niche_path = mv$(slot.path);
+            rv.niche_is_byte = slot.is_byte;
+            rv.niche_start = slot.start;
+            rv.niche_count = count;
+            rv.free_start = slot.start + count;
+            rv.free_end = slot.end;
+            DEBUG("Niche: variant " << data_variant << " data, path [" << rv.niche_path << "] from " << rv.niche_start);
+        }
+        else
+        {
+            // Tagged - `TAG` is an `unsigned int`, the largest run of unused values is free
+            // - Negative discriminants wrap to the top of the range (e.g. `Less = -1` in `Ordering`), so the run can be between used values
+            ::std::vector<uint64_t> tags;
+            for(unsigned int i = 0; i < enm.m_variants.size(); i ++)
+                tags.push_back( enm.is_value() ? enm.get_value(i) : i );
+            ::std::sort(tags.begin(), tags.end());
+            tags.push_back( UINT64_C(0x100000000) );
+            uint64_t    next_free = 0;
+            for(auto v : tags)
+            {
+                if( v > next_free && v - next_free > rv.free_end - rv.free_start ) {
+                    rv.free_start = next_free;
+                    rv.free_end = v;
+                }
+                next_free = ::std::max(next_free, v + 1);
+            }
+            rv.niche_path.push_back(TargetEnumRepr::PATH_TAG);
+        }
+    }
+
+    return cache.insert( ::std::make_pair(path.clone(), mv$(rv)) ).first->second;
+}
+
+// --------------------------------------------------------------------
+// Size and alignment
+// --------------------------------------------------------------------
+const TargetStructRepr* Target_GetStructRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty)
+{
+    auto& cache = get_layout_cache(resolve).structs;
+    auto it = cache.find(ty);
+    if( it != cache.end() )
+        return &it->second;
+
+    TargetStructRepr    rv;
+    if( const auto* te = ty.m_data.opt_Tuple() )
+    {
+        rv = layout_fields(sp, resolve, *te, true, false);
+    }
+    else if( ty.m_data.is_Path() && ty.m_data.as_Path().binding.is_Struct() )
+    {
+        const auto& gp = ty.m_data.as_Path().path.m_data.as_Generic();
+        const auto& str = *ty.m_data.as_Path().binding.as_Struct();
+        auto fields = get_field_types(str.m_data);
+        for(auto& fty : fields)
+        {
+            fty = monomorphise_type(sp, str.m_params, gp.m_params, fty);
+            resolve.expand_associated_types(sp, fty);
+        }
+
+        // Vtables are initialised positionally, and have a header inserted by codegen
+        bool is_vtable = str.m_struct_markings.is_vtable;
+
+        // `repr(packed)` keeps declaration order, and codegen emits it as a packed C struct
+        bool has_tail = str.m_struct_markings.dst_type != ::HIR::StructMarkings::DstType::None;
+        bool is_packed = str.m_repr == ::HIR::Struct::Repr::Packed;
+        rv = layout_fields(sp, resolve, fields, str.m_repr == ::HIR::Struct::Repr::Rust && !is_vtable, has_tail, is_packed);
+        if( is_vtable )
+            rv.size_known = false;
+
+        // `repr(simd)` uses a gcc vector type if all lanes are the same (non-128bit) number, with a power of two total size
+        if( str.m_repr == ::HIR::Struct::Repr::Simd && g_target.m_codegen_mode == CodegenMode::Gnu11 && rv.size_known && !fields.empty() )
+        {
+            bool is_vector = (rv.size & (rv.size - 1)) == 0;
+            for(const auto& fty : fields)
+            {
+                if( fty != fields.front() || !fty.m_data.is_Primitive() )
+                {
+                    is_vector = false;
+                    break;
+                }
+                switch(fty.m_data.as_Primitive())
+                {
+                case ::HIR::CoreType::Bool:
+                case ::HIR::CoreType::Char:
+                case ::HIR::CoreType::Str:
+                case ::HIR::CoreType::U128:
+                case ::HIR::CoreType::I128:
+                    is_vector = false;
+                    break;
+                default:
+                    break;
+                }
+            }
+            if( is_vector )
+            {
+                rv.simd_vector = true;
+                rv.align = rv.size;
+            }
+        }
+    }
+    else
+    {
+        return nullptr;
+    }
+    return &cache.insert( ::std::make_pair(ty.clone(), mv$(rv)) ).first->second;
+}
+
+static bool Target_GetSizeAndAlignOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_size, size_t& out_align)
 {
     TU_MATCHA( (ty.m_data), (te),
     (Infer,
@@ -140,14 +582,19 @@ bool Target_GetSizeAndAlignOf(const Span& sp, const ::HIR::TypeRef& ty, size_t&
             return true;
         case ::HIR::CoreType::U64:
         case ::HIR::CoreType::I64:
+        case ::HIR::CoreType::F64:
             out_size = 8;
-            out_align = 8;
+            // NOTE: The i386 SysV ABI only 4-byte aligns 64-bit values
+            out_align = (g_target.m_arch.m_name == "x86" && g_target.m_codegen_mode == CodegenMode::Gnu11 ? 4 : 8);
             return true;
         case ::HIR::CoreType::U128:
         case ::HIR::CoreType::I128:
             out_size = 16;
-            // TODO: If i128 is emulated, this can be 8
-            out_align = 16;
+            // Emulated i128 is a pair of u64s
+            if( Target_EmulatesI128() )
+                out_align = (g_target.m_arch.m_name == "x86" && g_target.m_codegen_mode == CodegenMode::Gnu11 ? 4 : 8);
+            else
+                out_align = 16;
             return true;
         case ::HIR::CoreType::Usize:
         case ::HIR::CoreType::Isize:
@@ -158,17 +605,67 @@ bool Target_GetSizeAndAlignOf(const Span& sp, const ::HIR::TypeRef& ty, size_t&
             out_size = 4;
             out_align = 4;
             return true;
-        case ::HIR::CoreType::F64:
-            out_size = 8;
-            out_align = 8;
-            return true;
         case ::HIR::CoreType::Str:
             BUG(sp, "sizeof on a `str` - unsized");
         }
         ),
     (Path,
-        // TODO:
-        return false;
+        TU_MATCH_DEF( ::HIR::TypeRef::TypePathBinding, (te.binding), (tpb),
+        (
+            return false;
+            ),
+        (Struct,
+            const auto* repr = Target_GetStructRepr(sp, resolve, ty);
+            if( !repr->size_known )
+                return false;
+            out_size = repr->size;
+            out_align = repr->align;
+            return true;
+            ),
+        (Enum,
+            const auto& enm = *tpb;
+            const auto& repr = Target_GetEnumRepr(sp, resolve, te.path.m_data.as_Generic(), enm);
+            if( repr.kind == TargetEnumRepr::Kind::Niche )
+            {
+                const auto& var = repr.variants.at(repr.data_variant);
+                if( !var.size_known )
+                    return false;
+                out_size = var.size;
+                out_align = var.align;
+                return true;
+            }
+            size_t  tag_size = 4;
+            switch(enm.m_repr)
+            {
+            case ::HIR::Enum::Repr::Rust:
+            case ::HIR::Enum::Repr::C:  tag_size = 4;   break;
+            case ::HIR::Enum::Repr::U8: tag_size = 1;   break;
+            case ::HIR::Enum::Repr::U16:    tag_size = 2;   break;
+            case ::HIR::Enum::Repr::U32:    tag_size = 4;   break;
+            }
+            if( enm.is_value() )
+            {
+                out_size = tag_size;
+                out_align = tag_size;
+                return true;
+            }
+            // `TAG` followed by a union of variant structs
+            size_t  data_size = 0, data_align = 1;
+            for(unsigned int i = 0; i < enm.m_variants.size(); i ++)
+            {
+                if( enm.m_variants[i].second.is_Unit() || enm.m_variants[i].second.is_Value() )
+                    continue ;
+                const auto& var = repr.variants[i];
+                if( !var.size_known )
+                    return false;
+                data_size = ::std::max(data_size, var.size);
+                data_align = ::std::max(data_align, var.align);
+            }
+            out_align = ::std::max(tag_size, data_align);
+            out_size = round_up(round_up(tag_size, data_align) + round_up(data_size, data_align), out_align);
+            return true;
+            )
+        )
         ),
     (Generic,
         // Unknown - return false
@@ -181,39 +678,37 @@ bool Target_GetSizeAndAlignOf(const Span& sp, const ::HIR::TypeRef& ty, size_t&
         BUG(sp, "sizeof on an erased type - shouldn't exist");
         ),
     (Array,
-        // TODO: 
-        size_t  size;
-        if( !Target_GetSizeAndAlignOf(sp, *te.inner, size,out_align) )
+        if( !Target_GetSizeAndAlignOf(sp, resolve, *te.inner, out_size,out_align) )
             return false;
-        size *= te.size_val;
+        out_size *= te.size_val;
+        return true;
         ),
     (Slice,
         BUG(sp, "sizeof on a slice - unsized");
         ),
     (Tuple,
-        out_size = 0;
-        out_align = 0;
-
-        // TODO: Struct reordering
-        for(const auto& t : te)
-        {
-            size_t  size, align;
-            if( !Target_GetSizeAndAlignOf(sp, t, size,align) )
-                return false;
-            if( out_size % align != 0 )
-            {
-                out_size += align;
-                out_size %= align;
-            }
-            out_size += size;
-            out_align = ::std::max(out_align, align);
-        }
+        const auto* repr = Target_GetStructRepr(sp, resolve, ty);
+        if( !repr->size_known )
+            return false;
+        out_size = repr->size;
+        out_align = repr->align;
+        return true;
         ),
     (Borrow,
-        // TODO
+        bool    is_fat;
+        if( !get_pointer_is_fat(sp, resolve, *te.inner, is_fat) )
+            return false;
+        out_size = g_target.m_arch.m_pointer_bits / 8 * (is_fat ? 2 : 1);
+        out_align = g_target.m_arch.m_pointer_bits / 8;
+        return true;
         ),
     (Pointer,
-        // TODO
+        bool    is_fat;
+        if( !get_pointer_is_fat(sp, resolve, *te.inner, is_fat) )
+            return false;
+        out_size = g_target.m_arch.m_pointer_bits / 8 * (is_fat ? 2 : 1);
+        out_align = g_target.m_arch.m_pointer_bits / 8;
+        return true;
         ),
     (Function,
         // Pointer size
@@ -227,13 +722,13 @@ bool Target_GetSizeAndAlignOf(const Span& sp, const ::HIR::TypeRef& ty, size_t&
     )
     return false;
 }
-bool Target_GetSizeOf(const Span& sp, const ::HIR::TypeRef& ty, size_t& out_size)
+bool Target_GetSizeOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_size)
 {
     size_t  ignore_align;
-    return Target_GetSizeAndAlignOf(sp, ty, out_size, ignore_align);
+    return Target_GetSizeAndAlignOf(sp, resolve, ty, out_size, ignore_align);
 }
-bool Target_GetAlignOf(const Span& sp, const ::HIR::TypeRef& ty, size_t& out_align)
+bool Target_GetAlignOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_align)
 {
     size_t  ignore_size;
-    return Target_GetSizeAndAlignOf(sp, ty, ignore_size, out_align);
+    return Target_GetSizeAndAlignOf(sp, resolve, ty, ignore_size, out_align);
 }
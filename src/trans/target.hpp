@@ -10,6 +10,11 @@
 #include <cstddef>
 #include <hir/type.hpp>
 
+class StaticTraitResolve;
+namespace HIR {
+    class Enum;
+}
+
 enum class CodegenMode
 {
     Gnu11,
@@ -29,6 +34,8 @@ struct TargetArch
         bool u64;
         bool ptr;
     } m_atomics;
+    /// The C compiler provides a native `__int128` on this architecture
+    bool    m_has_int128;
 };
 struct TargetSpec
 {
@@ -40,9 +47,67 @@ struct TargetSpec
     TargetArch  m_arch;
 };
 
+/// Field layout of a struct, tuple, or enum variant
+struct TargetStructRepr
+{
+    /// Declaration indexes of the fields, in the order they are laid out
+    ::std::vector<unsigned> fields;
+    /// Size and alignment (only valid if `size_known`)
+    bool    size_known = false;
+    size_t  size = 0;
+    size_t  align = 0;
+    /// `repr(simd)` struct emitted as a C vector type (aligned to its size)
+    bool    simd_vector = false;
+};
+
+/// Representation of an enum in generated code
+struct TargetEnumRepr
+{
+    enum class Kind
+    {
+        /// `TAG` field, plus a `DATA` union if any variant has fields
+        Tagged,
+        /// Fields of `data_variant` are stored directly, other variants are invalid values of the niche slot
+        Niche,
+    };
+    static const unsigned PATH_PTR; // Selects the `PTR` of a fat pointer
+    static const unsigned PATH_TAG; // Selects the `TAG` of a tagged enum
+
+    Kind    kind = Kind::Tagged;
+    unsigned    data_variant = 0;
+
+    /// Field path (from the enum root) to the niche slot
+    /// - For a tagged enum, this is `TAG` (if the tag has unused values)
+    ::std::vector<unsigned> niche_path;
+    /// The slot is a `bool`, and must be accessed as a raw byte
+    bool    niche_is_byte = false;
+    /// Value stored in the slot for the first non-data variant (subsequent variants count up)
+    uint64_t    niche_start = 0;
+    /// Number of values used by this enum
+    uint64_t    niche_count = 0;
+    /// Slot values not used by this enum (available to enclosing enums)
+    uint64_t    free_start = 0;
+    uint64_t    free_end = 0;
+
+    /// Field layout of each variant
+    ::std::vector<TargetStructRepr> variants;
+
+    uint64_t niche_value(unsigned var_idx) const {
+        assert(var_idx != data_variant);
+        return niche_start + (var_idx < data_variant ? var_idx : var_idx - 1);
+    }
+};
+
 
 extern const TargetSpec& Target_GetCurSpec();
 extern void Target_SetCfg(const ::std::string& target_name);
-extern bool Target_GetSizeOf(const Span& sp, const ::HIR::TypeRef& ty, size_t& out_size);
-extern bool Target_GetAlignOf(const Span& sp, const ::HIR::TypeRef& ty, size_t& out_align);
+/// Returns true if `u128`/`i128` are emitted as a pair of 64-bit words (instead of using the native `__int128`)
+extern bool Target_EmulatesI128();
+/// Use the emulated 128-bit integers even if the target has a native type (for testing the fallback)
+extern void Target_ForceEmulatedI128();
+extern bool Target_GetSizeOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_size);
+extern bool Target_GetAlignOf(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty, size_t& out_align);
+/// Field layout of a struct or tuple type (fields are reordered to minimise padding unless `repr(C)`/`repr(packed)`)
+extern const TargetStructRepr* Target_GetStructRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::TypeRef& ty);
+extern const TargetEnumRepr& Target_GetEnumRepr(const Span& sp, const StaticTraitResolve& resolve, const ::HIR::GenericPath& path, const ::HIR::Enum& enm);
 
@@ -45,6 +45,8 @@ struct TransList_Function
 {
     const ::HIR::Function*  ptr;
     Trans_Params    pp;
+    /// Already defined by an upstream crate's object (see `HIR::Crate::m_exported_instances`), only needs a prototype
+    bool    upstream = false;
 };
 struct TransList_Static
 {
@@ -428,6 +428,9 @@ bool Builder::build_target(const PackageManifest& manifest, const PackageTarget&
     if( true /*this->enable_optimise*/ ) {
         args.push_back("-O");
     }
+    if( m_opts.enable_lto ) {
+        args.push_back("--lto");
+    }
     args.push_back("-o"); args.push_back(outfile);
     args.push_back("-L"); args.push_back(m_opts.output_dir.str().c_str());
     for(const auto& dir : manifest.build_script_output().rustc_link_search) {
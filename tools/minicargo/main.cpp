@@ -30,6 +30,9 @@ struct ProgramOptions
     // Library search directories
     ::std::vector<const char*>  lib_search_dirs;
 
+    // Build all crates for link-time optimisation
+    bool enable_lto = false;
+
     bool pause_before_quit = false;
 
     int parse(int argc, const char* argv[]);
@@ -69,6 +72,7 @@ int main(int argc, const char* argv[])
         build_opts.lib_search_dirs.reserve(opts.lib_search_dirs.size());
         for(const auto* d : opts.lib_search_dirs)
             build_opts.lib_search_dirs.push_back( ::helpers::path(d) );
+        build_opts.enable_lto = opts.enable_lto;
         if( !MiniCargo_Build(m, ::std::move(build_opts)) )
         {
             ::std::cerr << "BUILD FAILED" << ::std::endl;
@@ -165,6 +169,9 @@ int ProgramOptions::parse(int argc, const char* argv[])
                 }
                 this->output_directory = argv[++i];
             }
+            else if( ::std::strcmp(arg, "--lto") == 0 ) {
+                this->enable_lto = true;
+            }
             else {
                 ::std::cerr << "Unknown flag " << arg << ::std::endl;
                 return 1;
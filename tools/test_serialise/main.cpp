@@ -0,0 +1,136 @@
+/*
+ * MRustC - Rust Compiler
+ * - By John Hodge (Mutabah/thePowersGang)
+ *
+ * tools/test_serialise/main.cpp
+ * - Round-trip tests for the metadata stream (hir/serialise_lowlevel) in each `-Z hir-compression` mode
+ */
+#include <hir/serialise_lowlevel.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <stdint.h>
+#include <stdio.h>  // remove
+
+using ::HIR::serialise::Writer;
+using ::HIR::serialise::Reader;
+
+namespace {
+    // Payload spanning several 512KiB chunks: compressible runs interleaved with noise, so some chunks are stored raw
+    ::std::vector<uint8_t> make_payload(size_t len)
+    {
+        ::std::vector<uint8_t>  rv(len);
+        uint32_t    state = 0x12345678;
+        for(size_t i = 0; i < len; i ++)
+        {
+            if( (i / (300*1024)) % 2 == 0 ) {
+                rv[i] = static_cast<uint8_t>(i % 61);
+            }
+            else {
+                state = state * 1103515245 + 12345;
+                rv[i] = static_cast<uint8_t>(state >> 16);
+            }
+        }
+        return rv;
+    }
+
+    void check(bool cond, const ::std::string& mode, const char* what)
+    {
+        if( !cond )
+            throw ::std::runtime_error(mode + ": " + what);
+    }
+
+    /// Nothing written, and reading anything fails
+    void test_empty(const ::std::string& mode, const ::std::string& path)
+    {
+        {
+            Writer  w(path);
+        }
+        Reader  r(path);
+        bool failed = false;
+        try {
+            r.read_u8();
+        }
+        catch(const ::std::runtime_error& ) {
+            failed = true;
+        }
+        check(failed, mode, "read past the end of an empty stream");
+    }
+
+    /// Scalars on either side of a bulk payload (so values straddle chunk boundaries)
+    void test_values(const ::std::string& mode, const ::std::string& path, const ::std::vector<uint8_t>& payload)
+    {
+        {
+            Writer  w(path);
+            w.write_u8(0xA5);
+            w.write_u16(0xBEEF);
+            w.write_u32(0xDEADBEEF);
+            w.write_u64(UINT64_C(0x0123456789ABCDEF));
+            w.write_u64c(5);
+            w.write_u64c(0x12345);
+            w.write_u64c(UINT64_C(0x1234567890));
+            w.write_i64c(-77);
+            w.write_string("hello");
+            w.write_string(::std::string(300, 'x'));
+            w.write(payload.data(), payload.size());
+            for(unsigned i = 0; i < 200000; i ++)
+                w.write_u64c(i * 37);
+            w.write_bool(true);
+        }
+        Reader  r(path);
+        check(r.read_u8() == 0xA5, mode, "u8");
+        check(r.read_u16() == 0xBEEF, mode, "u16");
+        check(r.read_u32() == 0xDEADBEEF, mode, "u32");
+        check(r.read_u64() == UINT64_C(0x0123456789ABCDEF), mode, "u64");
+        check(r.read_u64c() == 5, mode, "u64c (short)");
+        check(r.read_u64c() == 0x12345, mode, "u64c (medium)");
+        check(r.read_u64c() == UINT64_C(0x1234567890), mode, "u64c (long)");
+        check(r.read_i64c() == -77, mode, "i64c");
+        check(r.read_string() == "hello", mode, "string");
+        check(r.read_string() == ::std::string(300, 'x'), mode, "long string");
+        ::std::vector<uint8_t>  data(payload.size());
+        r.read(data.data(), data.size());
+        check(data == payload, mode, "bulk payload");
+        for(unsigned i = 0; i < 200000; i ++)
+            check(r.read_u64c() == i * 37, mode, "u64c sequence");
+        check(r.read_bool(), mode, "bool");
+    }
+}
+
+int main(int argc, const char* argv[])
+{
+    ::std::string   path = (argc > 1 ? argv[1] : "test_serialise.bin");
+
+    const auto payload = make_payload(3*512*1024 + 1234);
+    const char* modes[] = { "none", "fast", "best", "deflate", "deflate:1", "deflate:9" };
+    unsigned    n_fail = 0;
+    for(const char* mode : modes)
+    {
+        ::HIR::serialise::CompressionOptions    opts;
+        try
+        {
+            check(::HIR::serialise::parse_compression(mode, opts), mode, "parse_compression");
+            ::HIR::serialise::set_compression(opts);
+            test_empty(mode, path);
+            test_values(mode, path, payload);
+            ::std::cout << "PASS " << mode << ::std::endl;
+        }
+        catch(const ::std::exception& e)
+        {
+            ::std::cout << "FAIL " << e.what() << ::std::endl;
+            n_fail ++;
+        }
+    }
+
+    ::HIR::serialise::CompressionOptions    opts;
+    for(const char* bad : { "", "deflate:0", "deflate:10", "zstd" })
+    {
+        if( ::HIR::serialise::parse_compression(bad, opts) ) {
+            ::std::cout << "FAIL accepted bad mode '" << bad << "'" << ::std::endl;
+            n_fail ++;
+        }
+    }
+
+    remove(path.c_str());
+    return n_fail == 0 ? 0 : 1;
+}